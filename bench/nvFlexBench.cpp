@@ -0,0 +1,262 @@
+// standalone benchmark for host side parts of the nvflex solver step
+// build with houdini environment sourced: cd bench && make
+// usage: nvflexbench [pointcount] [repeats]
+//        nvflexbench step [options] - per phase cost of a whole solver step, see nvFlexStepBench.cpp
+//        nvflexbench stress [options] - independent containers solved concurrently, see nvFlexStressBench.cpp
+//        nvflexbench reset [options] - sim reset latency with and without the container pool, see nvFlexResetBench.cpp
+
+#include <GU/GU_Detail.h>
+#include <GA/GA_Handle.h>
+#include <GA/GA_Iterator.h>
+#include <UT/UT_Thread.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "NvFlexHParticleTransfer.h"
+
+int stepBench(int argc, char *argv[]); //nvFlexStepBench.cpp
+int stressBench(int argc, char *argv[]); //nvFlexStressBench.cpp
+int resetBench(int argc, char *argv[]); //nvFlexResetBench.cpp
+
+struct ParticleBuffers {
+	std::vector<float> particles;
+	std::vector<float> restParticles;
+	std::vector<float> velocities;
+	std::vector<int> phases;
+
+	explicit ParticleBuffers(GA_Size n) :particles(n * 4, 0.0f), restParticles(n * 4, 0.0f), velocities(n * 3, 0.0f), phases(n, 0) {}
+
+	NvFlexExtParticleData data() {
+		NvFlexExtParticleData pdat;
+		memset(&pdat, 0, sizeof(pdat));
+		pdat.particles = particles.data();
+		pdat.restParticles = restParticles.data();
+		pdat.velocities = velocities.data();
+		pdat.phases = phases.data();
+		return pdat;
+	}
+
+	bool operator==(const ParticleBuffers &o) const {
+		return memcmp(particles.data(), o.particles.data(), particles.size() * sizeof(float)) == 0 &&
+			memcmp(restParticles.data(), o.restParticles.data(), restParticles.size() * sizeof(float)) == 0 &&
+			memcmp(velocities.data(), o.velocities.data(), velocities.size() * sizeof(float)) == 0 &&
+			memcmp(phases.data(), o.phases.data(), phases.size() * sizeof(int)) == 0;
+	}
+};
+
+static void buildFluidBlock(GU_Detail &gdp, GA_Size npts) {
+	GA_Offset start = gdp.appendPointBlock(npts);
+	GA_RWHandleV3 vhnd(gdp.addFloatTuple(GA_ATTRIB_POINT, "v", 3));
+	GA_RWHandleV3 rhnd(gdp.addFloatTuple(GA_ATTRIB_POINT, "restP", 3));
+	GA_RWHandleF mhnd(gdp.addFloatTuple(GA_ATTRIB_POINT, "imass", 1));
+	GA_RWHandleI phshnd(gdp.addIntTuple(GA_ATTRIB_POINT, "phs", 1));
+	GA_RWHandleI ihnd(gdp.addIntTuple(GA_ATTRIB_POINT, "iid", 1));
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	for (GA_Size i = 0; i < npts; ++i) {
+		GA_Offset off = start + i;
+		UT_Vector3F p(dist(rng), dist(rng), dist(rng));
+		gdp.setPos3(off, p);
+		rhnd.set(off, p);
+		vhnd.set(off, UT_Vector3F(dist(rng), dist(rng), dist(rng)));
+		mhnd.set(off, 1.0f);
+		phshnd.set(off, (1 << 20) | (1 << 22));
+		ihnd.set(off, int(i));
+	}
+}
+
+//the single threaded loops the solver had before ingest and writeback were threaded, kept as they were,
+//so "identical" and "speedup" are measured against the original code and not against a 1 thread run of the new one
+static void serialIngest(const GU_Detail *gdp, NvFlexExtParticleData &pdat, const int *indices, int nactives) {
+	GA_ROHandleV3 phnd(gdp->getP());
+	GA_ROHandleV3 vhnd(gdp->findPointAttribute("v"));
+	GA_ROHandleI phshnd(gdp->findPointAttribute("phs"));
+	GA_ROHandleF mhnd(gdp->findPointAttribute("imass"));
+	GA_ROHandleV3 rhnd(gdp->findPointAttribute("restP"));
+	const bool hasRest = rhnd.isValid();
+
+	GA_Offset bst, bed;
+	bool stoploop = false;
+	for (GA_Iterator it(gdp->getPointRange()); it.blockAdvance(bst, bed);) {
+		for (GA_Offset off = bst; off < bed; ++off) {
+			UT_Vector3F p = phnd.get(off);
+			UT_Vector3F v = vhnd.get(off);
+
+			GA_Index idx = gdp->pointIndex(off);
+			if (idx >= nactives) {
+				stoploop = true;
+				break;
+			}
+			int iid = indices[idx];
+			int iid4 = iid * 4;
+			int iid3 = iid * 3;
+			pdat.particles[iid4 + 0] = p.x();
+			pdat.particles[iid4 + 1] = p.y();
+			pdat.particles[iid4 + 2] = p.z();
+			pdat.particles[iid4 + 3] = mhnd.get(off);
+			if (hasRest) {
+				UT_Vector3F rst = rhnd.get(off);
+				pdat.restParticles[iid4 + 0] = rst.x();
+				pdat.restParticles[iid4 + 1] = rst.y();
+				pdat.restParticles[iid4 + 2] = rst.z();
+				pdat.restParticles[iid4 + 3] = 1.0f;
+			}
+
+			pdat.velocities[iid3 + 0] = v.x();
+			pdat.velocities[iid3 + 1] = v.y();
+			pdat.velocities[iid3 + 2] = v.z();
+
+			pdat.phases[iid] = phshnd.get(off);
+		}
+		if (stoploop)break;
+	}
+}
+
+static void serialWriteback(GU_Detail *gdp, const NvFlexExtParticleData &pdat, const int *iindex, GA_Attribute *vatt, GA_Attribute *iidatt, GA_Attribute *phsatt) {
+	GA_RWHandleV3 vhd(vatt);
+	GA_RWHandleI iidhd(iidatt);
+	GA_RWHandleI phshd(phsatt);
+
+	GA_Offset ostt, oend;
+	for (GA_Iterator oit(gdp->getPointRange()); oit.blockAdvance(ostt, oend);) {
+		for (GA_Offset curroff = ostt; curroff < oend; ++curroff) {
+			UT_Vector3 pp;
+			int ii = iindex[gdp->pointIndex(curroff)];
+			pp.assign(pdat.particles[ii * 4 + 0], pdat.particles[ii * 4 + 1], pdat.particles[ii * 4 + 2]);
+			gdp->setPos3(curroff, pp);
+			pp.assign(pdat.velocities[ii * 3 + 0], pdat.velocities[ii * 3 + 1], pdat.velocities[ii * 3 + 2]);
+			vhd.set(curroff, pp);
+			iidhd.set(curroff, ii);
+			phshd.set(curroff, pdat.phases[ii]);
+		}
+	}
+}
+
+static double timeSerialIngest(const GU_Detail &gdp, ParticleBuffers &buffers, const std::vector<int> &indices, int repeats) {
+	double best = 1e30;
+	NvFlexExtParticleData pdat = buffers.data();
+	for (int r = 0; r < repeats; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		serialIngest(&gdp, pdat, indices.data(), int(indices.size()));
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+static double timeSerialWriteback(GU_Detail &gdp, ParticleBuffers &buffers, const std::vector<int> &indices, int repeats) {
+	double best = 1e30;
+	NvFlexExtParticleData pdat = buffers.data();
+	GA_Attribute *vattr = gdp.findPointAttribute("v");
+	GA_Attribute *iidattr = gdp.findPointAttribute("iid");
+	GA_Attribute *phsattr = gdp.findPointAttribute("phs");
+	for (int r = 0; r < repeats; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		serialWriteback(&gdp, pdat, indices.data(), vattr, iidattr, phsattr);
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+static double timeIngest(const GU_Detail &gdp, ParticleBuffers &buffers, const std::vector<int> &indices, int repeats) {
+	double best = 1e30;
+	NvFlexExtParticleData pdat = buffers.data();
+	for (int r = 0; r < repeats; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		pushGeoToParticles(&gdp, pdat, indices.data(), int(indices.size()));
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+static double timeWriteback(GU_Detail &gdp, ParticleBuffers &buffers, const std::vector<int> &indices, int repeats) {
+	double best = 1e30;
+	NvFlexExtParticleData pdat = buffers.data();
+	GA_Attribute *vattr = gdp.findPointAttribute("v");
+	GA_Attribute *iidattr = gdp.findPointAttribute("iid");
+	GA_Attribute *phsattr = gdp.findPointAttribute("phs");
+	for (int r = 0; r < repeats; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		pullParticlesToGeo(&gdp, pdat, indices.data(), vattr, iidattr, phsattr);
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+//reads back what writeback produced, in the same layout as flex buffers, to compare runs
+static ParticleBuffers readGeo(const GU_Detail &gdp) {
+	ParticleBuffers out(gdp.getNumPoints());
+	GA_ROHandleV3 vhnd(gdp.findPointAttribute("v"));
+	GA_ROHandleI iidhnd(gdp.findPointAttribute("iid"));
+	GA_ROHandleI phshnd(gdp.findPointAttribute("phs"));
+	for (GA_Index i = 0; i < gdp.getNumPoints(); ++i) {
+		GA_Offset off = gdp.pointOffset(i);
+		UT_Vector3F p = gdp.getPos3(off);
+		UT_Vector3F v = vhnd.get(off);
+		out.particles[i * 4 + 0] = p.x();
+		out.particles[i * 4 + 1] = p.y();
+		out.particles[i * 4 + 2] = p.z();
+		out.velocities[i * 3 + 0] = v.x();
+		out.velocities[i * 3 + 1] = v.y();
+		out.velocities[i * 3 + 2] = v.z();
+		out.phases[i] = phshnd.get(off);
+		out.restParticles[i * 4] = float(iidhnd.get(off)); //rest is not written back, so keep iid there for comparison
+	}
+	return out;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && strcmp(argv[1], "step") == 0)return stepBench(argc - 1, argv + 1);
+	if (argc > 1 && strcmp(argv[1], "stress") == 0)return stressBench(argc - 1, argv + 1);
+	if (argc > 1 && strcmp(argv[1], "reset") == 0)return resetBench(argc - 1, argv + 1);
+
+	const GA_Size npts = argc > 1 ? atoll(argv[1]) : 1000000;
+	const int repeats = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+	const int maxthreads = UT_Thread::getNumProcessors();
+
+	GU_Detail gdp;
+	buildFluidBlock(gdp, npts);
+
+	//active list after some alloc/free is not in order, so shuffle it
+	std::vector<int> indices(npts);
+	for (GA_Size i = 0; i < npts; ++i)indices[i] = int(i);
+	std::shuffle(indices.begin(), indices.end(), std::mt19937(4321));
+
+	ParticleBuffers reference(npts);
+	const double serialms = timeSerialIngest(gdp, reference, indices, repeats);
+
+	printf("particle ingest, %lld points, best of %d, original serial loop %.3f ms\n", (long long)npts, repeats, serialms);
+	printf("%8s %12s %14s %10s %10s\n", "threads", "ms", "Mpts/s", "speedup", "identical");
+	for (int threads = 1;; threads = std::min(threads * 2, maxthreads)) {
+		UT_Thread::configureMaxThreads(threads);
+		ParticleBuffers buffers(npts);
+		const double ms = timeIngest(gdp, buffers, indices, repeats);
+		printf("%8d %12.3f %14.2f %10.2f %10s\n", threads, ms, npts / ms / 1000.0, serialms / ms, buffers == reference ? "yes" : "NO");
+		if (threads == maxthreads)break;
+	}
+
+	//writeback: pretend the solver moved everything by reversing the particle order
+	std::vector<int> writebackIndices(indices.rbegin(), indices.rend());
+	const double serialwbms = timeSerialWriteback(gdp, reference, writebackIndices, repeats);
+	const ParticleBuffers wbreference = readGeo(gdp);
+
+	printf("\nparticle writeback, %lld points, best of %d, original serial loop %.3f ms\n", (long long)npts, repeats, serialwbms);
+	printf("%8s %12s %14s %10s %10s\n", "threads", "ms", "Mpts/s", "speedup", "identical");
+	for (int threads = 1;; threads = std::min(threads * 2, maxthreads)) {
+		UT_Thread::configureMaxThreads(threads);
+		GU_Detail wbgdp;
+		buildFluidBlock(wbgdp, npts);
+		const double ms = timeWriteback(wbgdp, reference, writebackIndices, repeats);
+		printf("%8d %12.3f %14.2f %10.2f %10s\n", threads, ms, npts / ms / 1000.0, serialwbms / ms, readGeo(wbgdp) == wbreference ? "yes" : "NO");
+		if (threads == maxthreads)break;
+	}
+	UT_Thread::configureMaxThreads(maxthreads);
+
+	return 0;
+}
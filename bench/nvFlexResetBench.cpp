@@ -0,0 +1,116 @@
+// latency of a sim reset: data of the old sim goes away, a new one gets a container for the same maxpts and pushes its first particles
+// runs the same resets with the container pool switched off and on. between resets nothing holds the library,
+// as in a scene where the reset dropped every flex object, so without the pool the library and cuda context are made again too
+// usage: nvflexbench reset [-particles N] [-maxpts N] [-resets N] [-pool N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "utils.h"
+#include "NvFlexHContainer.h"
+#include "NvFlexHContainerPool.h"
+#include "NvFlexHContext.h"
+
+namespace {
+	struct ResetOptions {
+		int particles = 100000; //pushed after every reset
+		int maxpts = 1000000;
+		int resets = 20;
+		int pool = 2; //pool capacity for the pooled run
+	};
+
+	void flexErrorPrint(NvFlexErrorSeverity type, const char *msg, const char *file, int line) {
+		fprintf(stderr, "flex: %s (%s:%d)\n", msg != NULL ? msg : "", file != NULL ? file : "", line);
+	}
+
+	struct ResetStats {
+		double totalms = 0;
+		double minms = 1e30;
+		double maxms = 0;
+	};
+
+	//one reset after another, returns per reset time. first reset of the pooled run is a cold one as well
+	ResetStats runResets(const ResetOptions &opts, int capacity) {
+		NvFlexHContainerPool::instance().setCapacity(capacity);
+		ResetStats stats;
+		for (int r = 0; r < opts.resets; ++r) {
+			const auto start = std::chrono::steady_clock::now();
+			NvFlexLibrary *lib = NvFlexHContext::instance().addRef(flexErrorPrint);
+			NvFlexHContainer *container = NvFlexHContainerPool::instance().acquire(lib, opts.maxpts, 0, 96);
+			{
+				NvFlexHContextAutoGetter context;
+				container->allocParticles(opts.particles, NULL);
+				NvFlexExtParticleData pdat = container->mapParticleData(NVFLEXH_CHANNEL_ALL);
+				for (int i = 0; i < opts.particles; ++i) {
+					pdat.particles[i * 4 + 0] = float(i % 100) * 0.1f;
+					pdat.particles[i * 4 + 1] = float(i / 100 % 100) * 0.1f;
+					pdat.particles[i * 4 + 2] = float(i / 10000) * 0.1f;
+					pdat.particles[i * 4 + 3] = 1.0f;
+				}
+				container->unmapParticleData();
+				container->pushParticlesToDevice(NVFLEXH_CHANNEL_ALL);
+				NvFlexUpdateSolver(container->solver(), 1.0f / 24.0f, 1, false);
+				container->pullParticlesFromDevice(NVFLEXH_CHANNEL_PARTICLES);
+			}
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			stats.totalms += ms;
+			stats.minms = std::min(stats.minms, ms);
+			stats.maxms = std::max(stats.maxms, ms);
+			//the sim is thrown away
+			NvFlexHContainerPool::instance().recycle(container);
+			NvFlexHContext::instance().release();
+		}
+		NvFlexHContainerPool::instance().clear();
+		return stats;
+	}
+
+	bool parseArgs(int argc, char *argv[], ResetOptions &opts) {
+		for (int i = 1; i < argc; ++i) {
+			const char *arg = argv[i];
+			const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+			if (val == NULL) {
+				fprintf(stderr, "missing value for %s\n", arg);
+				return false;
+			}
+			++i;
+			if (strcmp(arg, "-particles") == 0)opts.particles = std::max(0, atoi(val));
+			else if (strcmp(arg, "-maxpts") == 0)opts.maxpts = std::max(1, atoi(val));
+			else if (strcmp(arg, "-resets") == 0)opts.resets = std::max(1, atoi(val));
+			else if (strcmp(arg, "-pool") == 0)opts.pool = std::max(1, atoi(val));
+			else {
+				fprintf(stderr, "unknown option %s\n", arg);
+				return false;
+			}
+		}
+		opts.particles = std::min(opts.particles, opts.maxpts);
+		return true;
+	}
+}
+
+
+int resetBench(int argc, char *argv[]) {
+	ResetOptions opts;
+	if (!parseArgs(argc, argv, opts))return 1;
+
+	ResetStats unpooled, pooled;
+	try {
+		unpooled = runResets(opts, 0);
+		pooled = runResets(opts, opts.pool);
+	}
+	catch (std::runtime_error &e) {
+		fprintf(stderr, "failed to initialize flex: %s\n", e.what());
+		return 1;
+	}
+
+	printf("%d resets of a %d particle container, %d particles pushed and stepped after each\n", opts.resets, opts.maxpts, opts.particles);
+	printf("%-10s %10s %10s %10s\n", "pool", "mean ms", "min ms", "max ms");
+	printf("%-10s %10.3f %10.3f %10.3f\n", "off", unpooled.totalms / opts.resets, unpooled.minms, unpooled.maxms);
+	printf("%-10s %10.3f %10.3f %10.3f\n", "on", pooled.totalms / opts.resets, pooled.minms, pooled.maxms);
+	printf("containers reused: %lld, created: %lld\n", (long long)NvFlexHContainerPool::instance().getReuseCount(), (long long)NvFlexHContainerPool::instance().getCreateCount());
+	return 0;
+}
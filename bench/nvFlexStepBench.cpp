@@ -0,0 +1,571 @@
+// per phase host cost of one nvflex solver step on a synthetic scene
+// drives the same container, ingest, topology, collider and writeback code SIM_NvFlexSolver::solveObjectsSubclass uses,
+// but every phase is forced to do its full work each frame, as if everything upstream changed
+// usage: nvflexbench step [-particles N] [-cloth RES] [-rigids N] [-rigidsize N] [-colliders N] [-colliderres RES]
+//                         [-frames N] [-substeps N] [-threads N] [-analytic 0|1] [-sdfthreshold N] [-readback LIST] [-label STR] [-json FILE]
+// -readback is a comma separated list of output channels, like the solver toggles: P,v,phs,iid,rest
+
+#include <GU/GU_Detail.h>
+#include <GU/GU_PrimPoly.h>
+#include <GA/GA_Handle.h>
+#include <UT/UT_Thread.h>
+#include <UT/UT_ParallelUtil.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "NvFlexHContainer.h"
+#include "NvFlexHContext.h"
+#include "NvFlexHTopology.h"
+#include "NvFlexHColliderUpdate.h"
+#include "NvFlexHTriangleMesh.h"
+#include "NvFlexHDistanceField.h"
+#ifdef NVFLEXH_HOST_BACKEND
+#include "NvFlexHostStats.h"
+#endif
+
+namespace {
+	struct StepBenchOptions {
+		GA_Size particles = 200000; //fluid block
+		int cloth = 256; //cloth grid resolution, 0 - no cloth
+		int rigids = 1000;
+		int rigidSize = 64; //particles per rigid
+		int colliders = 4;
+		int colliderRes = 128; //collider grid resolution
+		int frames = 20;
+		int substeps = 2;
+		int threads = 0; //0 - all
+		int analytic = 1;
+		int sdfThreshold = 50000;
+		std::string readback = "P,v,phs,iid";
+		std::string label;
+		std::string json;
+	};
+
+	enum Phase { PHASE_INGEST, PHASE_TOPOLOGY, PHASE_COLLISION, PHASE_SOLVE, PHASE_READBACK, PHASE_WRITEBACK, PHASE_COUNT };
+	const char *phaseNames[PHASE_COUNT] = { "ingest", "topology", "collision", "solve", "readback", "writeback" };
+	const char *phaseUnits[PHASE_COUNT] = { "points", "prims", "points", "particles", "particles", "points" };
+
+	struct PhaseStats {
+		double totalms = 0;
+		double minms = 1e30;
+		GA_Size items = 0; //per frame
+		int64 bytes = 0; //per frame, host side data copied between geometry and flex buffers
+		int64 flexCalls = 0; //total, host backend only
+		int64 flexBytes = 0; //total, host backend only
+	};
+
+	//scoped timer adding to a phase
+	class PhaseTimer {
+	public:
+		explicit PhaseTimer(PhaseStats &stats) :_stats(stats), _start(std::chrono::steady_clock::now()) {
+#ifdef NVFLEXH_HOST_BACKEND
+			NvFlexHostGetStats(_flexStart);
+#endif
+		}
+		~PhaseTimer() {
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+			_stats.totalms += ms;
+			_stats.minms = std::min(_stats.minms, ms);
+#ifdef NVFLEXH_HOST_BACKEND
+			NvFlexHostCallStats flexEnd[eNvFlexHostCallCount];
+			NvFlexHostGetStats(flexEnd);
+			for (int i = 0; i < eNvFlexHostCallCount; ++i) {
+				_stats.flexCalls += flexEnd[i].calls - _flexStart[i].calls;
+				_stats.flexBytes += flexEnd[i].bytes - _flexStart[i].bytes;
+			}
+#endif
+		}
+	private:
+		PhaseStats &_stats;
+		std::chrono::steady_clock::time_point _start;
+#ifdef NVFLEXH_HOST_BACKEND
+		NvFlexHostCallStats _flexStart[eNvFlexHostCallCount];
+#endif
+	};
+
+	int64 attribDataId(const GA_Attribute *attr) {
+		return attr == NULL ? -1 : attr->getDataId();
+	}
+
+	void flexErrorPrint(NvFlexErrorSeverity type, const char *msg, const char *file, int line) {
+		fprintf(stderr, "flex: %s (%s:%d)\n", msg != NULL ? msg : "", file != NULL ? file : "", line);
+	}
+
+
+	//scene
+	struct SceneCounts {
+		GA_Size fluid = 0, clothPoints = 0, springs = 0, triangles = 0, rigids = 0, rigidPoints = 0, colliderPoints = 0, colliderPrims = 0;
+	};
+
+	//particle attributes every point needs for ingest, plus constraint attributes so all primitive kinds are there
+	struct SceneAttribs {
+		GA_RWHandleV3 v, restP;
+		GA_RWHandleF imass;
+		GA_RWHandleI phs, iid;
+		GA_RWHandleF restlength, strength;
+		GA_RWHandleV3 rgdTranslation, rgdRestP, rgdRestN;
+		GA_RWHandleV4 rgdRotation;
+		GA_RWHandleF rgdStiffness, rgdSdf;
+		GA_RWHandleI rgdIsRigid;
+
+		explicit SceneAttribs(GU_Detail &gdp) {
+			v = gdp.addFloatTuple(GA_ATTRIB_POINT, "v", 3);
+			restP = gdp.addFloatTuple(GA_ATTRIB_POINT, "restP", 3);
+			imass = gdp.addFloatTuple(GA_ATTRIB_POINT, "imass", 1, GA_Defaults(1));
+			phs = gdp.addIntTuple(GA_ATTRIB_POINT, "phs", 1);
+			iid = gdp.addIntTuple(GA_ATTRIB_POINT, "iid", 1, GA_Defaults(-1));
+			restlength = gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "restlength", 1);
+			strength = gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "strength", 1);
+			rgdTranslation = gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_translation", 3);
+			rgdRotation = gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_rotation", 4);
+			rgdStiffness = gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_stiffness", 1);
+			rgdIsRigid = gdp.addIntTuple(GA_ATTRIB_PRIMITIVE, "rgd_isrigid", 1);
+			rgdRestP = gdp.addFloatTuple(GA_ATTRIB_VERTEX, "rgd_restP", 3);
+			rgdRestN = gdp.addFloatTuple(GA_ATTRIB_VERTEX, "rgd_restN", 3);
+			rgdSdf = gdp.addFloatTuple(GA_ATTRIB_VERTEX, "rgd_sdf", 1);
+		}
+
+		void setParticle(GU_Detail &gdp, GA_Offset off, const UT_Vector3F &p, int phase) {
+			gdp.setPos3(off, p);
+			restP.set(off, p);
+			v.set(off, UT_Vector3F(0, 0, 0));
+			imass.set(off, 1.0f);
+			phs.set(off, phase);
+		}
+	};
+
+	void addFluidBlock(GU_Detail &gdp, SceneAttribs &attrs, GA_Size npts, SceneCounts &counts) {
+		if (npts <= 0)return;
+		const GA_Offset start = gdp.appendPointBlock(npts);
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		for (GA_Size i = 0; i < npts; ++i) {
+			attrs.setParticle(gdp, start + i, UT_Vector3F(dist(rng), dist(rng) + 2.0f, dist(rng)), eNvFlexPhaseSelfCollide | eNvFlexPhaseFluid);
+		}
+		counts.fluid = npts;
+	}
+
+	//res x res grid, springs along grid edges, two triangles per cell
+	void addCloth(GU_Detail &gdp, SceneAttribs &attrs, int res, SceneCounts &counts) {
+		if (res < 2)return;
+		const float step = 2.0f / (res - 1);
+		const GA_Offset start = gdp.appendPointBlock(GA_Size(res)*res);
+		auto pt = [&](int i, int j) { return start + GA_Offset(j*res + i); };
+		for (int j = 0; j < res; ++j) {
+			for (int i = 0; i < res; ++i) {
+				attrs.setParticle(gdp, pt(i, j), UT_Vector3F(-1.0f + i*step, 4.0f, -1.0f + j*step), 1 | eNvFlexPhaseSelfCollide);
+			}
+		}
+		auto spring = [&](GA_Offset a, GA_Offset b) {
+			GU_PrimPoly *poly = GU_PrimPoly::build(&gdp, 2, 1, 0);
+			poly->setVertexPoint(0, a);
+			poly->setVertexPoint(1, b);
+			attrs.restlength.set(poly->getMapOffset(), step);
+			attrs.strength.set(poly->getMapOffset(), 1.0f);
+			++counts.springs;
+		};
+		auto triangle = [&](GA_Offset a, GA_Offset b, GA_Offset c) {
+			GU_PrimPoly *poly = GU_PrimPoly::build(&gdp, 3, 0, 0);
+			poly->setVertexPoint(0, a);
+			poly->setVertexPoint(1, b);
+			poly->setVertexPoint(2, c);
+			++counts.triangles;
+		};
+		for (int j = 0; j < res; ++j) {
+			for (int i = 0; i < res; ++i) {
+				if (i + 1 < res)spring(pt(i, j), pt(i + 1, j));
+				if (j + 1 < res)spring(pt(i, j), pt(i, j + 1));
+				if (i + 1 < res && j + 1 < res) {
+					triangle(pt(i, j), pt(i + 1, j), pt(i + 1, j + 1));
+					triangle(pt(i, j), pt(i + 1, j + 1), pt(i, j + 1));
+				}
+			}
+		}
+		counts.clothPoints = GA_Size(res)*res;
+	}
+
+	//clusters of particles on a line, one rigid primitive with a vertex per particle
+	void addRigids(GU_Detail &gdp, SceneAttribs &attrs, int nrigids, int size, SceneCounts &counts) {
+		if (nrigids <= 0 || size <= 0)return;
+		const GA_Offset start = gdp.appendPointBlock(GA_Size(nrigids)*size);
+		for (int r = 0; r < nrigids; ++r) {
+			const UT_Vector3F center(float(r % 32) * 0.5f - 8.0f, 6.0f + float(r / 32) * 0.5f, 0.0f);
+			GU_PrimPoly *poly = GU_PrimPoly::build(&gdp, size, 1, 0);
+			const GA_Offset primoff = poly->getMapOffset();
+			for (int i = 0; i < size; ++i) {
+				const GA_Offset off = start + GA_Offset(r*size + i);
+				const UT_Vector3F local(0.05f*i - 0.025f*size, 0, 0);
+				attrs.setParticle(gdp, off, center + local, (2 + r) | eNvFlexPhaseSelfCollide);
+				poly->setVertexPoint(i, off);
+				const GA_Offset vtx = poly->getVertexOffset(i);
+				attrs.rgdRestP.set(vtx, local);
+				attrs.rgdRestN.set(vtx, UT_Vector3F(0, 1, 0));
+				attrs.rgdSdf.set(vtx, -0.05f);
+			}
+			attrs.rgdIsRigid.set(primoff, 1);
+			attrs.rgdStiffness.set(primoff, 1.0f);
+			attrs.rgdTranslation.set(primoff, center);
+			attrs.rgdRotation.set(primoff, UT_Vector4F(0, 0, 0, 1));
+		}
+		counts.rigids = nrigids;
+		counts.rigidPoints = GA_Size(nrigids)*size;
+	}
+
+	//res x res quad grid, deformed every frame
+	void buildCollider(GU_Detail &gdp, int res, float offset) {
+		const float step = 4.0f / (res - 1);
+		const GA_Offset start = gdp.appendPointBlock(GA_Size(res)*res);
+		for (int j = 0; j < res; ++j) {
+			for (int i = 0; i < res; ++i) {
+				gdp.setPos3(start + GA_Offset(j*res + i), UT_Vector3F(-2.0f + i*step, offset, -2.0f + j*step));
+			}
+		}
+		for (int j = 0; j + 1 < res; ++j) {
+			for (int i = 0; i + 1 < res; ++i) {
+				GU_PrimPoly *poly = GU_PrimPoly::build(&gdp, 4, 0, 0);
+				poly->setVertexPoint(0, start + GA_Offset(j*res + i));
+				poly->setVertexPoint(1, start + GA_Offset(j*res + i + 1));
+				poly->setVertexPoint(2, start + GA_Offset((j + 1)*res + i + 1));
+				poly->setVertexPoint(3, start + GA_Offset((j + 1)*res + i));
+			}
+		}
+	}
+
+	void deformCollider(GU_Detail &gdp, float offset, float time) {
+		UTparallelForLightItems(UT_BlockedRange<GA_Index>(0, gdp.getNumPoints()), [&](const UT_BlockedRange<GA_Index> &r) {
+			for (GA_Index i = r.begin(); i != r.end(); ++i) {
+				const GA_Offset off = gdp.pointOffset(i);
+				UT_Vector3F p = gdp.getPos3(off);
+				p.y() = offset + 0.2f*std::sin(p.x()*3.0f + time)*std::cos(p.z()*2.0f + time);
+				gdp.setPos3(off, p);
+			}
+		});
+		gdp.getP()->bumpDataId();
+	}
+
+	bool parseArgs(int argc, char *argv[], StepBenchOptions &opts) {
+		for (int i = 1; i < argc; ++i) {
+			const char *arg = argv[i];
+			const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+			if (val == NULL) {
+				fprintf(stderr, "missing value for %s\n", arg);
+				return false;
+			}
+			++i;
+			if (strcmp(arg, "-particles") == 0)opts.particles = atoll(val);
+			else if (strcmp(arg, "-cloth") == 0)opts.cloth = atoi(val);
+			else if (strcmp(arg, "-rigids") == 0)opts.rigids = atoi(val);
+			else if (strcmp(arg, "-rigidsize") == 0)opts.rigidSize = atoi(val);
+			else if (strcmp(arg, "-colliders") == 0)opts.colliders = atoi(val);
+			else if (strcmp(arg, "-colliderres") == 0)opts.colliderRes = std::max(2, atoi(val));
+			else if (strcmp(arg, "-frames") == 0)opts.frames = std::max(1, atoi(val));
+			else if (strcmp(arg, "-substeps") == 0)opts.substeps = std::max(1, atoi(val));
+			else if (strcmp(arg, "-threads") == 0)opts.threads = atoi(val);
+			else if (strcmp(arg, "-analytic") == 0)opts.analytic = atoi(val);
+			else if (strcmp(arg, "-sdfthreshold") == 0)opts.sdfThreshold = atoi(val);
+			else if (strcmp(arg, "-readback") == 0)opts.readback = val;
+			else if (strcmp(arg, "-label") == 0)opts.label = val;
+			else if (strcmp(arg, "-json") == 0)opts.json = val;
+			else {
+				fprintf(stderr, "unknown option %s\n", arg);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//device channels and iid flag out of -readback list. returns false on unknown names
+	bool parseReadback(const std::string &list, int &channels, bool &iid) {
+		channels = NVFLEXH_CHANNEL_NONE;
+		iid = false;
+		size_t pos = 0;
+		while (pos <= list.size()) {
+			size_t end = list.find(',', pos);
+			if (end == std::string::npos)end = list.size();
+			const std::string name = list.substr(pos, end - pos);
+			if (name == "P")channels |= NVFLEXH_CHANNEL_PARTICLES;
+			else if (name == "v")channels |= NVFLEXH_CHANNEL_VELOCITIES;
+			else if (name == "phs")channels |= NVFLEXH_CHANNEL_PHASES;
+			else if (name == "rest")channels |= NVFLEXH_CHANNEL_REST;
+			else if (name == "iid")iid = true;
+			else if (!name.empty()) {
+				fprintf(stderr, "unknown readback channel %s\n", name.c_str());
+				return false;
+			}
+			pos = end + 1;
+		}
+		return true;
+	}
+
+	//minimal escaping, labels are expected to be commit ids and such
+	std::string jsonString(const std::string &s) {
+		std::string out = "\"";
+		for (char c : s) {
+			if (c == '"' || c == '\\')out += '\\';
+			out += c;
+		}
+		return out + "\"";
+	}
+
+	bool writeJson(const std::string &path, const StepBenchOptions &opts, const SceneCounts &counts, GA_Size nprims, const PhaseStats *stats, exint firstFrameAllocs, exint laterAllocs) {
+		FILE *f = fopen(path.c_str(), "w");
+		if (f == NULL)return false;
+		fprintf(f, "{\n");
+		fprintf(f, "\t\"bench\": \"step\",\n");
+		fprintf(f, "\t\"label\": %s,\n", jsonString(opts.label).c_str());
+#ifdef NVFLEXH_HOST_BACKEND
+		fprintf(f, "\t\"backend\": \"host\",\n");
+#else
+		fprintf(f, "\t\"backend\": \"flex\",\n");
+#endif
+		fprintf(f, "\t\"threads\": %d,\n", UT_Thread::getNumProcessors());
+		fprintf(f, "\t\"frames\": %d,\n", opts.frames);
+		fprintf(f, "\t\"substeps\": %d,\n", opts.substeps);
+		fprintf(f, "\t\"readback\": %s,\n", jsonString(opts.readback).c_str());
+		fprintf(f, "\t\"scene\": {\"fluid\": %lld, \"clothPoints\": %lld, \"springs\": %lld, \"triangles\": %lld, \"rigids\": %lld, \"rigidPoints\": %lld, \"prims\": %lld, \"colliders\": %d, \"colliderPoints\": %lld, \"colliderPrims\": %lld},\n",
+			(long long)counts.fluid, (long long)counts.clothPoints, (long long)counts.springs, (long long)counts.triangles, (long long)counts.rigids, (long long)counts.rigidPoints,
+			(long long)nprims, opts.colliders, (long long)counts.colliderPoints, (long long)counts.colliderPrims);
+		fprintf(f, "\t\"bufferAllocs\": {\"firstFrame\": %lld, \"laterFrames\": %lld},\n", (long long)firstFrameAllocs, (long long)laterAllocs);
+		fprintf(f, "\t\"phases\": {\n");
+		for (int p = 0; p < PHASE_COUNT; ++p) {
+			const PhaseStats &s = stats[p];
+			const double meanms = s.totalms / opts.frames;
+			fprintf(f, "\t\t\"%s\": {\"meanMs\": %.6f, \"minMs\": %.6f, \"unit\": \"%s\", \"items\": %lld, \"itemsPerSec\": %.1f, \"bytes\": %lld, \"mbPerSec\": %.3f, \"flexCallsPerFrame\": %.2f, \"flexBytesPerFrame\": %.1f}%s\n",
+				phaseNames[p], meanms, s.minms, phaseUnits[p], (long long)s.items, meanms > 0 ? s.items / meanms * 1000.0 : 0.0, (long long)s.bytes,
+				meanms > 0 ? s.bytes / meanms / 1000.0 : 0.0, double(s.flexCalls) / opts.frames, double(s.flexBytes) / opts.frames, p + 1 < PHASE_COUNT ? "," : "");
+		}
+		fprintf(f, "\t}\n}\n");
+		fclose(f);
+		return true;
+	}
+}
+
+
+int stepBench(int argc, char *argv[]) {
+	StepBenchOptions opts;
+	if (!parseArgs(argc, argv, opts))return 1;
+	int readbackChannels;
+	bool readbackIid;
+	if (!parseReadback(opts.readback, readbackChannels, readbackIid))return 1;
+	if (opts.threads > 0)UT_Thread::configureMaxThreads(opts.threads);
+
+	//scene
+	GU_Detail gdp;
+	SceneCounts counts;
+	{
+		SceneAttribs attrs(gdp);
+		addFluidBlock(gdp, attrs, opts.particles, counts);
+		addCloth(gdp, attrs, opts.cloth, counts);
+		addRigids(gdp, attrs, opts.rigids, opts.rigidSize, counts);
+		GA_RWHandleI iidhnd(gdp.findPointAttribute("iid"));
+		for (GA_Index i = 0; i < gdp.getNumPoints(); ++i)iidhnd.set(gdp.pointOffset(i), int(i));
+	}
+	std::vector<std::unique_ptr<GU_Detail>> colliders;
+	for (int c = 0; c < opts.colliders; ++c) {
+		colliders.emplace_back(new GU_Detail());
+		buildCollider(*colliders.back(), opts.colliderRes, -0.5f - c*0.1f);
+		counts.colliderPoints += colliders.back()->getNumPoints();
+		counts.colliderPrims += colliders.back()->getNumPrimitives();
+	}
+	const GA_Size npts = gdp.getNumPoints();
+	const GA_Size nprims = gdp.getNumPrimitives();
+	printf("scene: %lld fluid, %lld cloth points (%lld springs, %lld triangles), %lld rigids of %d, %d colliders of %lld points\n",
+		(long long)counts.fluid, (long long)counts.clothPoints, (long long)counts.springs, (long long)counts.triangles, (long long)counts.rigids, opts.rigidSize,
+		opts.colliders, opts.colliders > 0 ? (long long)(counts.colliderPoints / opts.colliders) : 0LL);
+	if (npts == 0) {
+		fprintf(stderr, "empty scene\n");
+		return 1;
+	}
+
+	NvFlexLibrary *lib = NULL;
+	try {
+		lib = NvFlexHContext::instance().addRef(flexErrorPrint);
+	}
+	catch (std::runtime_error &e) {
+		fprintf(stderr, "failed to initialize flex: %s\n", e.what());
+		return 1;
+	}
+
+	PhaseStats stats[PHASE_COUNT];
+	exint firstFrameAllocs = 0, laterAllocs = 0; //buffers the container had to reallocate
+	{
+		NvFlexHContextAutoGetter context;
+		NvFlexHContainer container(lib, int(npts), 0);
+		NvFlexHTopologyPlan topo;
+		std::vector<int> indices(npts);
+		int64 indicesVersion = -1;
+		int nactives = 0;
+
+		NvFlexParams params;
+		NvFlexGetParams(container.solver(), &params);
+		params.numIterations = 3;
+		params.radius = 0.1f;
+		params.numPlanes = 1;
+		params.planes[0][0] = 0;
+		params.planes[0][1] = 1;
+		params.planes[0][2] = 0;
+		params.planes[0][3] = 2;
+		NvFlexSetParams(container.solver(), &params);
+
+		NvFlexHColliderOptions colliderOptions;
+		colliderOptions.analytic = opts.analytic != 0;
+		colliderOptions.sdfTriangleThreshold = opts.sdfThreshold;
+
+		GA_Attribute *vattr = gdp.findPointAttribute("v");
+		GA_Attribute *iidattr = gdp.findPointAttribute("iid");
+		GA_Attribute *phsattr = gdp.findPointAttribute("phs");
+		GA_Attribute *restattr = NULL;
+		if (readbackChannels & NVFLEXH_CHANNEL_REST) {
+			restattr = gdp.findPointAttribute("restP");
+			if (restattr == NULL)restattr = gdp.addFloatTuple(GA_ATTRIB_POINT, "restP", 3).getAttribute();
+		}
+		const short triNormalType = NvFlexHTopologyPlan::triangleNormalType(&gdp);
+		const int64 particleBytes = ((readbackChannels & NVFLEXH_CHANNEL_PARTICLES) ? sizeof(Vec4) : 0) + ((readbackChannels & NVFLEXH_CHANNEL_REST) ? sizeof(Vec4) : 0) +
+			((readbackChannels & NVFLEXH_CHANNEL_VELOCITIES) ? sizeof(Vec3) : 0) + ((readbackChannels & NVFLEXH_CHANNEL_PHASES) ? sizeof(int) : 0);
+
+		for (int frame = 0; frame < opts.frames; ++frame) {
+			//ingest: geometry points into particle buffers, all channels as on topology change
+			{
+				PhaseTimer timer(stats[PHASE_INGEST]);
+				if (container.getActiveCount() < npts)container.allocParticles(int(npts) - container.getActiveCount(), NULL);
+				if (indicesVersion != container.getActiveVersion()) {
+					nactives = container.getActiveList(indices.data());
+					indicesVersion = container.getActiveVersion();
+				}
+				NvFlexExtParticleData pdat = container.mapParticleData(NVFLEXH_CHANNEL_ALL);
+				pushGeoToParticles(&gdp, pdat, indices.data(), nactives, NVFLEXH_CHANNEL_ALL);
+				container.unmapParticleData();
+				container.pushParticlesToDevice(NVFLEXH_CHANNEL_ALL);
+			}
+			stats[PHASE_INGEST].items = nactives;
+			stats[PHASE_INGEST].bytes = int64(nactives) * (sizeof(Vec4) * 2 + sizeof(Vec3) + sizeof(int));
+
+			//topology: plan rebuild, springs, triangles and rigids into flex buffers
+			{
+				PhaseTimer timer(stats[PHASE_TOPOLOGY]);
+				topo.build(&gdp, indices.data(), gdp.getTopology().getDataId(), attribDataId(gdp.findPrimitiveAttribute("rgd_isrigid")), indicesVersion);
+				container.resizeSpringData(int(topo.springCount()));
+				container.resizeTriangleData(int(topo.triangleCount()));
+				container.resizeRigidData(int(topo.rigidCount()), topo.rigidSizes());
+				auto sprdat = container.mapSpringData();
+				auto tridat = container.mapTriangleData();
+				auto rgddat = container.mapRigidData();
+				if (topo.springCount() > 0)topo.writeSprings(&gdp, sprdat.springIds, sprdat.springRls, sprdat.springSts);
+				topo.writeTriangles(&gdp, tridat.triangleIds, triNormalType > 0 ? tridat.triangleNms : NULL);
+				if (topo.rigidCount() > 0)topo.writeRigids(&gdp, rgddat.offsets, rgddat.indices, rgddat.restPositions, rgddat.restNormals, rgddat.stiffness, rgddat.rotations, rgddat.translations);
+				container.unmapSpringData();
+				container.unmapTriangleData();
+				container.unmapRigidData();
+				container.pushSpringsToDevice();
+				container.pushTrianglesToDevice(triNormalType > 0);
+				container.pushRigidsToDevice();
+			}
+			stats[PHASE_TOPOLOGY].items = nprims;
+			stats[PHASE_TOPOLOGY].bytes = int64(topo.springCount()) * (2 * sizeof(int) + 2 * sizeof(float)) + int64(topo.triangleCount()) * 3 * sizeof(int) +
+				int64(topo.rigidIndicesCount()) * (sizeof(int) + 7 * sizeof(float)) + int64(topo.rigidCount()) * (sizeof(int) + 8 * sizeof(float));
+
+			//collision: deforming colliders refresh their shapes
+			for (int c = 0; c < opts.colliders; ++c)deformCollider(*colliders[c], -0.5f - c*0.1f, frame*0.1f);
+			{
+				PhaseTimer timer(stats[PHASE_COLLISION]);
+				NvFlexHCollisionData *colldata = container.collisionData();
+				colldata->mapall();
+				colldata->beginStep();
+				for (int c = 0; c < opts.colliders; ++c) {
+					const NvFlexHShapeHandle shape = updateColliderShape(colldata, c, colliders[c].get(), colliderOptions);
+					colldata->setTransform(shape, Vec4(0, 0, 0, 1), Quat());
+					colldata->touch(shape);
+				}
+				colldata->collectStale(1);
+				colldata->unmapall();
+				colldata->setCollisionData(container.solver());
+			}
+			stats[PHASE_COLLISION].items = counts.colliderPoints;
+			stats[PHASE_COLLISION].bytes = counts.colliderPoints * sizeof(Vec3);
+
+			{
+				PhaseTimer timer(stats[PHASE_SOLVE]);
+				NvFlexUpdateSolver(container.solver(), 1.0f / 24.0f, opts.substeps, false);
+			}
+			stats[PHASE_SOLVE].items = nactives;
+
+			{
+				PhaseTimer timer(stats[PHASE_READBACK]);
+				container.pullParticlesFromDevice(readbackChannels);
+				if (container.getRigidCount() > 0)container.pullRigidsFromDevice();
+			}
+			stats[PHASE_READBACK].items = nactives;
+			stats[PHASE_READBACK].bytes = int64(nactives) * particleBytes + int64(container.getRigidCount()) * 7 * sizeof(float);
+
+			//writeback: particles and rigid transforms into geometry
+			{
+				PhaseTimer timer(stats[PHASE_WRITEBACK]);
+				NvFlexExtParticleData pdat = container.mapParticleData(readbackChannels);
+				pullParticlesToGeo(&gdp, pdat, indices.data(), vattr, readbackIid ? iidattr : NULL, phsattr, restattr);
+				container.unmapParticleData();
+				if (container.getRigidCount() > 0) {
+					GA_RWHandleV3 ptrshnd(gdp.findPrimitiveAttribute("rgd_translation"));
+					GA_RWHandleV4 prothnd(gdp.findPrimitiveAttribute("rgd_rotation"));
+					auto rgdtransdata = container.mapRigidTransData();
+					UTparallelForLightItems(UT_BlockedRange<GA_Size>(0, topo.rigidCount()), [&](const UT_BlockedRange<GA_Size> &r) {
+						for (GA_Size rigidNum = r.begin(); rigidNum != r.end(); ++rigidNum) {
+							const GA_Offset off = topo.rigidPrims[rigidNum];
+							const float *trs = rgdtransdata.translations + rigidNum * 3;
+							const float *rot = rgdtransdata.rotations + rigidNum * 4;
+							ptrshnd.set(off, UT_Vector3F(trs[0], trs[1], trs[2]));
+							prothnd.set(off, UT_Vector4F(rot[0], rot[1], rot[2], rot[3]));
+						}
+					});
+					container.unmapRigidTransData();
+					ptrshnd.bumpDataId();
+					prothnd.bumpDataId();
+				}
+				//same as the solver: only what was written
+				if (readbackChannels & NVFLEXH_CHANNEL_PARTICLES)gdp.getP()->bumpDataId();
+				if (readbackChannels & NVFLEXH_CHANNEL_VELOCITIES)vattr->bumpDataId();
+				if (readbackChannels & NVFLEXH_CHANNEL_PHASES)phsattr->bumpDataId();
+				if (readbackChannels & NVFLEXH_CHANNEL_REST)restattr->bumpDataId();
+				if (readbackIid)iidattr->bumpDataId();
+			}
+			stats[PHASE_WRITEBACK].items = nactives;
+			stats[PHASE_WRITEBACK].bytes = int64(nactives) * (particleBytes + (readbackIid ? sizeof(int) : 0)) + int64(container.getRigidCount()) * 7 * sizeof(float);
+			if (frame == 0)firstFrameAllocs = container.getBufferAllocCount();
+		}
+		laterAllocs = container.getBufferAllocCount() - firstFrameAllocs;
+	}
+	NvFlexHContext::instance().release(); //takes cached collision meshes with it
+
+	printf("%d frames, %d substeps, %d threads, mean per frame\n", opts.frames, opts.substeps, UT_Thread::getNumProcessors());
+	printf("%-10s %10s %10s %12s %-10s %10s %10s\n", "phase", "ms", "min ms", "items/s", "unit", "MB", "MB/s");
+	for (int p = 0; p < PHASE_COUNT; ++p) {
+		const PhaseStats &s = stats[p];
+		const double meanms = s.totalms / opts.frames;
+		printf("%-10s %10.3f %10.3f %12.0f %-10s %10.2f %10.1f\n", phaseNames[p], meanms, s.minms, meanms > 0 ? s.items / meanms * 1000.0 : 0.0, phaseUnits[p],
+			s.bytes / 1e6, meanms > 0 ? s.bytes / meanms / 1000.0 : 0.0);
+	}
+	printf("buffer reallocations: %lld in first frame, %lld in later ones\n", (long long)firstFrameAllocs, (long long)laterAllocs);
+#ifdef NVFLEXH_HOST_BACKEND
+	printf("\nflex calls per frame (host backend)\n");
+	for (int p = 0; p < PHASE_COUNT; ++p)printf("%-10s %10.1f calls %14.0f bytes\n", phaseNames[p], double(stats[p].flexCalls) / opts.frames, double(stats[p].flexBytes) / opts.frames);
+#endif
+
+	if (!opts.json.empty()) {
+		if (!writeJson(opts.json, opts, counts, nprims, stats, firstFrameAllocs, laterAllocs)) {
+			fprintf(stderr, "could not write %s\n", opts.json.c_str());
+			return 1;
+		}
+		printf("written %s\n", opts.json.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,274 @@
+// concurrent solves of independent containers, the way several dop networks cooking in one process
+// (pdg in process work items) step their solvers. every worker thread takes its own library reference,
+// makes its own container, and runs ingest, constraints, collision, solve and writeback with nested context acquires.
+// acquired flex sections are serialized by NvFlexHContext, host side work between them still overlaps.
+// workers start and stop rounds at different times, so the library is also made and destroyed while others run.
+// all workers simulate the same scene, so every one has to end up with the same result as a serial run.
+// meant for FLEX_BACKEND=host: it reports flex calls made without context and overlapping calls on one solver.
+// usage: nvflexbench stress [-workers N] [-rounds N] [-frames N] [-particles N] [-cloth RES] [-colliderres RES]
+
+#include <GU/GU_Detail.h>
+#include <GU/GU_PrimPoly.h>
+#include <GA/GA_Handle.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+#include "NvFlexHContainer.h"
+#include "NvFlexHContext.h"
+#include "NvFlexHTopology.h"
+#include "NvFlexHColliderUpdate.h"
+#include "NvFlexHParticleTransfer.h"
+
+namespace {
+	struct StressOptions {
+		int workers = 8;
+		int rounds = 4; //library reference, container, frames, then all of it is released
+		int frames = 10;
+		GA_Size particles = 20000;
+		int cloth = 32;
+		int colliderRes = 32;
+	};
+
+	std::atomic<int> flexErrors(0);
+
+	void flexErrorCount(NvFlexErrorSeverity type, const char *msg, const char *file, int line) {
+		if (type == eNvFlexLogError)++flexErrors;
+		fprintf(stderr, "flex: %s (%s:%d)\n", msg != NULL ? msg : "", file != NULL ? file : "", line);
+	}
+
+	//fluid block and a cloth grid, same for every worker
+	void buildScene(GU_Detail &gdp, const StressOptions &opts) {
+		GA_RWHandleV3 v(gdp.addFloatTuple(GA_ATTRIB_POINT, "v", 3));
+		GA_RWHandleF imass(gdp.addFloatTuple(GA_ATTRIB_POINT, "imass", 1, GA_Defaults(1)));
+		GA_RWHandleI phs(gdp.addIntTuple(GA_ATTRIB_POINT, "phs", 1));
+		GA_RWHandleI iid(gdp.addIntTuple(GA_ATTRIB_POINT, "iid", 1, GA_Defaults(-1)));
+		GA_RWHandleF restlength(gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "restlength", 1));
+		GA_RWHandleF strength(gdp.addFloatTuple(GA_ATTRIB_PRIMITIVE, "strength", 1));
+
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		if (opts.particles > 0) {
+			const GA_Offset start = gdp.appendPointBlock(opts.particles);
+			for (GA_Size i = 0; i < opts.particles; ++i) {
+				gdp.setPos3(start + i, UT_Vector3F(dist(rng), dist(rng) + 2.0f, dist(rng)));
+				phs.set(start + i, eNvFlexPhaseSelfCollide | eNvFlexPhaseFluid);
+			}
+		}
+		const int res = opts.cloth;
+		if (res >= 2) {
+			const float step = 2.0f / (res - 1);
+			const GA_Offset start = gdp.appendPointBlock(GA_Size(res)*res);
+			for (GA_Size i = 0; i < GA_Size(res)*res; ++i) {
+				gdp.setPos3(start + i, UT_Vector3F(-1.0f + (i % res)*step, 4.0f, -1.0f + (i / res)*step));
+				phs.set(start + i, 1 | eNvFlexPhaseSelfCollide);
+			}
+			for (int j = 0; j < res; ++j) {
+				for (int i = 0; i + 1 < res; ++i) {
+					for (int dir = 0; dir < 2; ++dir) {
+						const GA_Offset a = start + (dir == 0 ? GA_Offset(j*res + i) : GA_Offset(i*res + j));
+						const GA_Offset b = start + (dir == 0 ? GA_Offset(j*res + i + 1) : GA_Offset((i + 1)*res + j));
+						GU_PrimPoly *poly = GU_PrimPoly::build(&gdp, 2, 1, 0);
+						poly->setVertexPoint(0, a);
+						poly->setVertexPoint(1, b);
+						restlength.set(poly->getMapOffset(), step);
+						strength.set(poly->getMapOffset(), 1.0f);
+					}
+				}
+			}
+		}
+		for (GA_Index i = 0; i < gdp.getNumPoints(); ++i) {
+			v.set(gdp.pointOffset(i), UT_Vector3F(0, 0, 0));
+			imass.set(gdp.pointOffset(i), 1.0f);
+			iid.set(gdp.pointOffset(i), int(i));
+		}
+	}
+
+	//res x res grid under the scene. same content everywhere, so workers share one cached mesh
+	void buildCollider(GU_Detail &gdp, int res) {
+		const float step = 4.0f / (res - 1);
+		const GA_Offset start = gdp.appendPointBlock(GA_Size(res)*res);
+		for (GA_Size i = 0; i < GA_Size(res)*res; ++i) {
+			gdp.setPos3(start + i, UT_Vector3F(-2.0f + (i % res)*step, -0.5f + 0.1f*std::sin(float(i)), -2.0f + (i / res)*step));
+		}
+		for (int j = 0; j + 1 < res; ++j) {
+			for (int i = 0; i + 1 < res; ++i) {
+				GU_PrimPoly *poly = GU_PrimPoly::build(&gdp, 3, 0, 0);
+				poly->setVertexPoint(0, start + GA_Offset(j*res + i));
+				poly->setVertexPoint(1, start + GA_Offset(j*res + i + 1));
+				poly->setVertexPoint(2, start + GA_Offset((j + 1)*res + i + 1));
+			}
+		}
+	}
+
+	uint64 positionsHash(const GU_Detail &gdp) {
+		uint64 h = 0xcbf29ce484222325ULL;
+		for (GA_Index i = 0; i < gdp.getNumPoints(); ++i) {
+			const UT_Vector3F p = gdp.getPos3(gdp.pointOffset(i));
+			h = hashBytes(h, p.data(), sizeof(float) * 3);
+		}
+		return h;
+	}
+
+	//one round of one worker: library reference, own container, frames of the solver step. returns hash of resulting positions
+	uint64 runRound(const StressOptions &opts, const GU_Detail &collider) {
+		NvFlexLibrary *lib = NvFlexHContext::instance().addRef(flexErrorCount);
+		GU_Detail gdp;
+		buildScene(gdp, opts);
+		const GA_Size npts = gdp.getNumPoints();
+		{
+			std::unique_ptr<NvFlexHContainer> container;
+			{
+				NvFlexHContextAutoGetter context;
+				container.reset(new NvFlexHContainer(lib, int(npts), 0));
+				NvFlexParams params;
+				NvFlexGetParams(container->solver(), &params);
+				params.radius = 0.1f;
+				params.numPlanes = 1;
+				params.planes[0][1] = 1;
+				params.planes[0][3] = 2;
+				NvFlexSetParams(container->solver(), &params);
+			}
+			NvFlexHTopologyPlan topo;
+			std::vector<int> indices(npts);
+			NvFlexHColliderOptions colliderOptions;
+			GA_Attribute *vattr = gdp.findPointAttribute("v");
+			GA_Attribute *phsattr = gdp.findPointAttribute("phs");
+
+			for (int frame = 0; frame < opts.frames; ++frame) {
+				NvFlexHContextAutoGetter context;
+				if (container->getActiveCount() < npts)container->allocParticles(int(npts) - container->getActiveCount(), NULL);
+				const int nactives = container->getActiveList(indices.data());
+				{
+					NvFlexHContextAutoGetter nested; //as a solver step inside another one holding the context
+					NvFlexExtParticleData pdat = container->mapParticleData(NVFLEXH_CHANNEL_ALL);
+					pushGeoToParticles(&gdp, pdat, indices.data(), nactives, NVFLEXH_CHANNEL_ALL);
+					container->unmapParticleData();
+					container->pushParticlesToDevice(NVFLEXH_CHANNEL_ALL);
+				}
+				if (frame == 0) {
+					topo.build(&gdp, indices.data(), gdp.getTopology().getDataId(), -1, container->getActiveVersion());
+					container->resizeSpringData(int(topo.springCount()));
+					container->resizeTriangleData(int(topo.triangleCount()));
+					auto sprdat = container->mapSpringData();
+					auto tridat = container->mapTriangleData();
+					if (topo.springCount() > 0)topo.writeSprings(&gdp, sprdat.springIds, sprdat.springRls, sprdat.springSts);
+					topo.writeTriangles(&gdp, tridat.triangleIds, NULL);
+					container->unmapSpringData();
+					container->unmapTriangleData();
+					container->pushSpringsToDevice();
+					container->pushTrianglesToDevice(false);
+				}
+				NvFlexHCollisionData *colldata = container->collisionData();
+				colldata->mapall();
+				colldata->beginStep();
+				const NvFlexHShapeHandle shape = updateColliderShape(colldata, 0, &collider, colliderOptions);
+				colldata->setTransform(shape, Vec4(0, 0, 0, 1), Quat());
+				colldata->touch(shape);
+				colldata->collectStale(1);
+				colldata->unmapall();
+				colldata->setCollisionData(container->solver());
+
+				NvFlexUpdateSolver(container->solver(), 1.0f / 24.0f, 2, false);
+				container->pullParticlesFromDevice(NVFLEXH_CHANNEL_PARTICLES | NVFLEXH_CHANNEL_VELOCITIES | NVFLEXH_CHANNEL_PHASES);
+
+				NvFlexExtParticleData pdat = container->mapParticleData(NVFLEXH_CHANNEL_PARTICLES | NVFLEXH_CHANNEL_VELOCITIES | NVFLEXH_CHANNEL_PHASES);
+				pullParticlesToGeo(&gdp, pdat, indices.data(), vattr, NULL, phsattr);
+				container->unmapParticleData();
+				gdp.getP()->bumpDataId();
+			}
+
+			NvFlexHContextAutoGetter context;
+			container.reset();
+		}
+		NvFlexHContext::instance().release();
+		return positionsHash(gdp);
+	}
+
+	bool parseArgs(int argc, char *argv[], StressOptions &opts) {
+		for (int i = 1; i < argc; ++i) {
+			const char *arg = argv[i];
+			const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+			if (val == NULL) {
+				fprintf(stderr, "missing value for %s\n", arg);
+				return false;
+			}
+			++i;
+			if (strcmp(arg, "-workers") == 0)opts.workers = std::max(1, atoi(val));
+			else if (strcmp(arg, "-rounds") == 0)opts.rounds = std::max(1, atoi(val));
+			else if (strcmp(arg, "-frames") == 0)opts.frames = std::max(1, atoi(val));
+			else if (strcmp(arg, "-particles") == 0)opts.particles = std::max(0LL, atoll(val));
+			else if (strcmp(arg, "-cloth") == 0)opts.cloth = atoi(val);
+			else if (strcmp(arg, "-colliderres") == 0)opts.colliderRes = std::max(2, atoi(val));
+			else {
+				fprintf(stderr, "unknown option %s\n", arg);
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+
+int stressBench(int argc, char *argv[]) {
+	StressOptions opts;
+	if (!parseArgs(argc, argv, opts))return 1;
+
+	GU_Detail collider;
+	buildCollider(collider, opts.colliderRes);
+
+	uint64 reference = 0;
+	auto start = std::chrono::steady_clock::now();
+	try {
+		reference = runRound(opts, collider);
+	}
+	catch (std::runtime_error &e) {
+		fprintf(stderr, "failed to initialize flex: %s\n", e.what());
+		return 1;
+	}
+	const double serialms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<uint64> results(size_t(opts.workers) * opts.rounds, 0);
+	std::atomic<int> failures(0);
+	start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int w = 0; w < opts.workers; ++w) {
+		workers.emplace_back([&, w]() {
+			//staggered, so library references come and go while other workers are in the middle of a round
+			std::this_thread::sleep_for(std::chrono::milliseconds(w * 3));
+			for (int r = 0; r < opts.rounds; ++r) {
+				try {
+					results[size_t(w) * opts.rounds + r] = runRound(opts, collider);
+				}
+				catch (...) {
+					++failures;
+				}
+				if (NvFlexHContext::threadDepth() != 0)++failures;
+			}
+		});
+	}
+	for (std::thread &t : workers)t.join();
+	const double concurrentms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	int mismatches = 0;
+	for (uint64 h : results)if (h != reference)++mismatches;
+	const int refs = NvFlexHContext::instance().refCount();
+
+	printf("%d workers x %d rounds of %d frames, %lld points each\n", opts.workers, opts.rounds, opts.frames, (long long)(opts.particles + GA_Size(opts.cloth)*opts.cloth));
+	printf("serial round %.1f ms, all concurrent rounds %.1f ms\n", serialms, concurrentms);
+	printf("results differing from serial run: %d, failed rounds: %d, flex errors: %d, library references left: %d\n", mismatches, failures.load(), flexErrors.load(), refs);
+	const bool ok = mismatches == 0 && failures == 0 && flexErrors == 0 && refs == 0;
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,702 @@
+// host only stand-in for the part of flex 1.1 api the plugin uses, so everything around the solver
+// (ingest, constraint building, collision, writeback) can be built, run and measured without cuda or a gpu.
+// build the plugin or the bench with FLEX_BACKEND=host. solver here is a small reference one:
+// gravity, damping, max speed, springs, collision planes and sphere/capsule/box shapes. meshes, convexes and
+// sdfs are accepted and counted, but not collided with. no fluids, no rigid shape matching.
+// context acquires are tracked per thread like cuda does, calls that would need one without it and calls
+// overlapping on one solver are reported through the error callback.
+
+#include <NvFlex.h>
+#include <NvFlexExt.h>
+#include <NvFlexDevice.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "NvFlexHostStats.h"
+
+//stats
+static std::atomic<long long> hostCalls[eNvFlexHostCallCount];
+static std::atomic<long long> hostBytes[eNvFlexHostCallCount];
+
+static inline void count(NvFlexHostCall call, long long bytes = 0) {
+	hostCalls[call].fetch_add(1, std::memory_order_relaxed);
+	if (bytes != 0)hostBytes[call].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void NvFlexHostGetStats(NvFlexHostCallStats* stats) {
+	for (int i = 0; i < eNvFlexHostCallCount; ++i) {
+		stats[i].calls = hostCalls[i].load();
+		stats[i].bytes = hostBytes[i].load();
+	}
+}
+
+const char* NvFlexHostCallName(int call) {
+	static const char* names[] = {
+#define NVFLEXHOST_NAME(name) #name,
+		NVFLEXHOST_CALLS(NVFLEXHOST_NAME)
+#undef NVFLEXHOST_NAME
+	};
+	return call >= 0 && call < eNvFlexHostCallCount ? names[call] : "unknown";
+}
+
+void NvFlexHostResetStats() {
+	for (int i = 0; i < eNvFlexHostCallCount; ++i) {
+		hostCalls[i] = 0;
+		hostBytes[i] = 0;
+	}
+}
+
+void NvFlexHostPrintStats(FILE* out) {
+	NvFlexHostCallStats stats[eNvFlexHostCallCount];
+	NvFlexHostGetStats(stats);
+	fprintf(out, "%-22s %12s %16s\n", "call", "count", "bytes");
+	for (int i = 0; i < eNvFlexHostCallCount; ++i) {
+		if (stats[i].calls == 0)continue;
+		fprintf(out, "%-22s %12lld %16lld\n", NvFlexHostCallName(i), stats[i].calls, stats[i].bytes);
+	}
+}
+
+
+//objects
+struct NvFlexBuffer {
+	NvFlexLibrary* lib;
+	std::vector<unsigned char> data;
+	int count;
+	int stride;
+	bool mapped;
+};
+
+struct HostTriangleMesh {
+	std::vector<float> vertices;
+	std::vector<int> indices;
+	float lower[3], upper[3];
+};
+
+struct HostConvexMesh {
+	std::vector<float> planes;
+	float lower[3], upper[3];
+};
+
+struct HostDistanceField {
+	std::vector<float> field;
+	int dim[3];
+};
+
+struct NvFlexLibrary {
+	NvFlexErrorCallback errorFunc;
+	std::mutex mutex; //assets can be created from several threads, solvers are single threaded as in flex
+	unsigned int nextId;
+	std::unordered_map<unsigned int, HostTriangleMesh> meshes;
+	std::unordered_map<unsigned int, HostConvexMesh> convexes;
+	std::unordered_map<unsigned int, HostDistanceField> fields;
+};
+
+struct NvFlexSolver {
+	NvFlexLibrary* lib;
+	std::atomic<int> users; //flex solvers are not thread safe, calls on one of them must not overlap
+	int maxParticles;
+	NvFlexParams params;
+
+	std::vector<float> particles; //4 per particle
+	std::vector<float> restParticles; //4
+	std::vector<float> velocities; //3
+	std::vector<float> normals; //4
+	std::vector<int> phases;
+	std::vector<int> active;
+
+	std::vector<int> springIndices;
+	std::vector<float> springRestLengths;
+	std::vector<float> springStiffness;
+
+	std::vector<int> triangleIndices;
+	std::vector<float> triangleNormals;
+
+	std::vector<int> rigidOffsets;
+	std::vector<int> rigidIndices;
+	std::vector<float> rigidRestPositions;
+	std::vector<float> rigidRestNormals;
+	std::vector<float> rigidStiffness;
+	std::vector<float> rigidRotations;
+	std::vector<float> rigidTranslations;
+
+	std::vector<NvFlexCollisionGeometry> shapeGeometry;
+	std::vector<float> shapePositions; //4
+	std::vector<float> shapeRotations; //4
+	std::vector<int> shapeFlags;
+};
+
+static void reportError(NvFlexLibrary* lib, const char* msg) {
+	if (lib != NULL && lib->errorFunc != NULL)lib->errorFunc(eNvFlexLogError, msg, __FILE__, __LINE__);
+}
+
+//cuda context is per thread, real flex calls made without it fail or go to whatever context is current
+static thread_local int contextDepth = 0;
+
+static void requireContext(NvFlexLibrary* lib) {
+	if (contextDepth == 0)reportError(lib, "flex is called on a thread without library context acquired");
+}
+
+//reports calls on one solver overlapping from several threads
+class SolverUse {
+public:
+	explicit SolverUse(NvFlexSolver* solver) :_solver(solver) {
+		if (_solver->users.fetch_add(1) != 0)reportError(_solver->lib, "solver is used from several threads at once");
+	}
+	~SolverUse() { _solver->users.fetch_sub(1); }
+private:
+	NvFlexSolver* _solver;
+};
+
+//copies n elements of T from buffer into dst, buffers given to flex must not be mapped
+template<typename T>
+static long long readBuffer(NvFlexSolver* solver, NvFlexBuffer* buf, int n, int components, std::vector<T> &dst) {
+	SolverUse use(solver);
+	if (buf == NULL) {
+		dst.clear();
+		return 0;
+	}
+	if (buf->mapped)reportError(solver->lib, "buffer is passed to flex while mapped");
+	const size_t size = size_t(n)*components;
+	dst.resize(size);
+	const size_t bytes = std::min(size * sizeof(T), buf->data.size());
+	memcpy(dst.data(), buf->data.data(), bytes);
+	return (long long)bytes;
+}
+
+template<typename T>
+static long long writeBuffer(NvFlexSolver* solver, NvFlexBuffer* buf, int n, int components, const std::vector<T> &src) {
+	SolverUse use(solver);
+	if (buf == NULL)return 0;
+	if (buf->mapped)reportError(solver->lib, "buffer is passed to flex while mapped");
+	const size_t bytes = std::min(std::min(size_t(n)*components, src.size()) * sizeof(T), buf->data.size());
+	memcpy(buf->data.data(), src.data(), bytes);
+	return (long long)bytes;
+}
+
+
+//library
+NvFlexLibrary* NvFlexInit(int version, NvFlexErrorCallback errorFunc, NvFlexInitDesc* desc) {
+	NvFlexLibrary* lib = new NvFlexLibrary();
+	lib->errorFunc = errorFunc;
+	lib->nextId = 1;
+	return lib;
+}
+
+void NvFlexShutdown(NvFlexLibrary* lib) {
+	delete lib;
+}
+
+int NvFlexGetVersion() {
+	return 110;
+}
+
+void NvFlexAcquireContext(NvFlexLibrary* lib) {
+	++contextDepth;
+}
+
+void NvFlexRestoreContext(NvFlexLibrary* lib) {
+	if (contextDepth == 0) {
+		reportError(lib, "context is restored more times than it was acquired on this thread");
+		return;
+	}
+	--contextDepth;
+}
+
+int NvFlexDeviceGetSuggestedOrdinal() { return 0; }
+bool NvFlexDeviceCreateCudaContext(int ordinal) { return true; }
+void NvFlexDeviceDestroyCudaContext() {}
+
+
+//buffers
+NvFlexBuffer* NvFlexAllocBuffer(NvFlexLibrary* lib, int elementCount, int elementByteStride, NvFlexBufferType type) {
+	count(eNvFlexHostAllocBuffer, (long long)elementCount*elementByteStride);
+	requireContext(lib);
+	NvFlexBuffer* buf = new NvFlexBuffer();
+	buf->lib = lib;
+	buf->data.assign(size_t(elementCount)*elementByteStride, 0);
+	buf->count = elementCount;
+	buf->stride = elementByteStride;
+	buf->mapped = false;
+	return buf;
+}
+
+void NvFlexFreeBuffer(NvFlexBuffer* buf) {
+	count(eNvFlexHostFreeBuffer);
+	if (buf != NULL)requireContext(buf->lib);
+	delete buf;
+}
+
+void* NvFlexMap(NvFlexBuffer* buffer, int flags) {
+	count(eNvFlexHostMap);
+	requireContext(buffer->lib);
+	buffer->mapped = true;
+	return buffer->data.data();
+}
+
+void NvFlexUnmap(NvFlexBuffer* buffer) {
+	count(eNvFlexHostUnmap);
+	buffer->mapped = false;
+}
+
+
+//solver
+NvFlexSolver* NvFlexCreateSolver(NvFlexLibrary* lib, int maxParticles, int maxDiffuseParticles, int maxNeighborsPerParticle) {
+	requireContext(lib);
+	NvFlexSolver* solver = new NvFlexSolver();
+	solver->lib = lib;
+	solver->users = 0;
+	solver->maxParticles = maxParticles;
+	memset(&solver->params, 0, sizeof(NvFlexParams));
+	solver->params.numIterations = 3;
+	solver->params.gravity[1] = -9.8f;
+	solver->params.radius = 0.15f;
+	solver->params.maxSpeed = 1e30f;
+	solver->particles.assign(size_t(maxParticles) * 4, 0.0f);
+	solver->restParticles.assign(size_t(maxParticles) * 4, 0.0f);
+	solver->velocities.assign(size_t(maxParticles) * 3, 0.0f);
+	solver->normals.assign(size_t(maxParticles) * 4, 0.0f);
+	solver->phases.assign(maxParticles, 0);
+	return solver;
+}
+
+void NvFlexDestroySolver(NvFlexSolver* solver) {
+	requireContext(solver->lib);
+	delete solver;
+}
+
+NvFlexLibrary* NvFlexGetSolverLibrary(NvFlexSolver* solver) {
+	return solver->lib;
+}
+
+void NvFlexSetParams(NvFlexSolver* solver, const NvFlexParams* params) {
+	count(eNvFlexHostSetParams, sizeof(NvFlexParams));
+	solver->params = *params;
+}
+
+void NvFlexGetParams(NvFlexSolver* solver, NvFlexParams* params) {
+	count(eNvFlexHostGetParams, sizeof(NvFlexParams));
+	*params = solver->params;
+}
+
+void NvFlexSetActive(NvFlexSolver* solver, NvFlexBuffer* indices, int n) {
+	count(eNvFlexHostSetActive, readBuffer(solver, indices, n, 1, solver->active));
+}
+
+void NvFlexGetActive(NvFlexSolver* solver, NvFlexBuffer* indices) {
+	count(eNvFlexHostGetActive, writeBuffer(solver, indices, int(solver->active.size()), 1, solver->active));
+}
+
+int NvFlexGetActiveCount(NvFlexSolver* solver) {
+	return int(solver->active.size());
+}
+
+//particle channels keep their full size, partial sets only overwrite the head
+template<typename T>
+static long long setChannel(NvFlexSolver* solver, NvFlexBuffer* buf, int n, int components, std::vector<T> &channel) {
+	std::vector<T> tmp;
+	const long long bytes = readBuffer(solver, buf, n, components, tmp);
+	std::copy(tmp.begin(), tmp.begin() + std::min(tmp.size(), channel.size()), channel.begin());
+	return bytes;
+}
+
+void NvFlexSetParticles(NvFlexSolver* solver, NvFlexBuffer* p, int n) { count(eNvFlexHostSetParticles, setChannel(solver, p, n, 4, solver->particles)); }
+void NvFlexGetParticles(NvFlexSolver* solver, NvFlexBuffer* p, int n) { count(eNvFlexHostGetParticles, writeBuffer(solver, p, n, 4, solver->particles)); }
+void NvFlexSetRestParticles(NvFlexSolver* solver, NvFlexBuffer* p, int n) { count(eNvFlexHostSetRestParticles, setChannel(solver, p, n, 4, solver->restParticles)); }
+void NvFlexGetRestParticles(NvFlexSolver* solver, NvFlexBuffer* p, int n) { count(eNvFlexHostGetRestParticles, writeBuffer(solver, p, n, 4, solver->restParticles)); }
+void NvFlexGetSmoothParticles(NvFlexSolver* solver, NvFlexBuffer* p, int n) { writeBuffer(solver, p, n, 4, solver->particles); }
+void NvFlexSetVelocities(NvFlexSolver* solver, NvFlexBuffer* v, int n) { count(eNvFlexHostSetVelocities, setChannel(solver, v, n, 3, solver->velocities)); }
+void NvFlexGetVelocities(NvFlexSolver* solver, NvFlexBuffer* v, int n) { count(eNvFlexHostGetVelocities, writeBuffer(solver, v, n, 3, solver->velocities)); }
+void NvFlexSetPhases(NvFlexSolver* solver, NvFlexBuffer* phases, int n) { count(eNvFlexHostSetPhases, setChannel(solver, phases, n, 1, solver->phases)); }
+void NvFlexGetPhases(NvFlexSolver* solver, NvFlexBuffer* phases, int n) { count(eNvFlexHostGetPhases, writeBuffer(solver, phases, n, 1, solver->phases)); }
+void NvFlexSetNormals(NvFlexSolver* solver, NvFlexBuffer* normals, int n) { setChannel(solver, normals, n, 4, solver->normals); }
+void NvFlexGetNormals(NvFlexSolver* solver, NvFlexBuffer* normals, int n) { writeBuffer(solver, normals, n, 4, solver->normals); }
+
+void NvFlexSetSprings(NvFlexSolver* solver, NvFlexBuffer* indices, NvFlexBuffer* restLengths, NvFlexBuffer* stiffness, int numSprings) {
+	long long bytes = readBuffer(solver, indices, numSprings, 2, solver->springIndices);
+	bytes += readBuffer(solver, restLengths, numSprings, 1, solver->springRestLengths);
+	bytes += readBuffer(solver, stiffness, numSprings, 1, solver->springStiffness);
+	count(eNvFlexHostSetSprings, bytes);
+}
+
+void NvFlexSetDynamicTriangles(NvFlexSolver* solver, NvFlexBuffer* indices, NvFlexBuffer* normals, int numTris) {
+	long long bytes = readBuffer(solver, indices, numTris, 3, solver->triangleIndices);
+	bytes += readBuffer(solver, normals, numTris, 3, solver->triangleNormals);
+	count(eNvFlexHostSetDynamicTriangles, bytes);
+}
+
+void NvFlexSetRigids(NvFlexSolver* solver, NvFlexBuffer* offsets, NvFlexBuffer* indices, NvFlexBuffer* restPositions, NvFlexBuffer* restNormals, NvFlexBuffer* stiffness, NvFlexBuffer* rotations, NvFlexBuffer* translations, int numRigids, int numIndices) {
+	long long bytes = readBuffer(solver, offsets, numRigids + 1, 1, solver->rigidOffsets);
+	bytes += readBuffer(solver, indices, numIndices, 1, solver->rigidIndices);
+	bytes += readBuffer(solver, restPositions, numIndices, 3, solver->rigidRestPositions);
+	bytes += readBuffer(solver, restNormals, numIndices, 4, solver->rigidRestNormals);
+	bytes += readBuffer(solver, stiffness, numRigids, 1, solver->rigidStiffness);
+	bytes += readBuffer(solver, rotations, numRigids, 4, solver->rigidRotations);
+	bytes += readBuffer(solver, translations, numRigids, 3, solver->rigidTranslations);
+	count(eNvFlexHostSetRigids, bytes);
+}
+
+void NvFlexGetRigidTransforms(NvFlexSolver* solver, NvFlexBuffer* rotations, NvFlexBuffer* translations) {
+	const int numRigids = int(solver->rigidStiffness.size());
+	long long bytes = writeBuffer(solver, rotations, numRigids, 4, solver->rigidRotations);
+	bytes += writeBuffer(solver, translations, numRigids, 3, solver->rigidTranslations);
+	count(eNvFlexHostGetRigidTransforms, bytes);
+}
+
+void NvFlexSetShapes(NvFlexSolver* solver, NvFlexBuffer* geometry, NvFlexBuffer* shapePositions, NvFlexBuffer* shapeRotations, NvFlexBuffer* shapePrevPositions, NvFlexBuffer* shapePrevRotations, NvFlexBuffer* shapeFlags, int numShapes) {
+	std::vector<float> prev;
+	long long bytes = readBuffer(solver, geometry, numShapes, 1, solver->shapeGeometry);
+	bytes += readBuffer(solver, shapePositions, numShapes, 4, solver->shapePositions);
+	bytes += readBuffer(solver, shapeRotations, numShapes, 4, solver->shapeRotations);
+	bytes += readBuffer(solver, shapePrevPositions, numShapes, 4, prev); //no swept contacts here, just counted
+	bytes += readBuffer(solver, shapePrevRotations, numShapes, 4, prev);
+	bytes += readBuffer(solver, shapeFlags, numShapes, 1, solver->shapeFlags);
+	count(eNvFlexHostSetShapes, bytes);
+}
+
+
+//collision assets
+template<typename MAP>
+static unsigned int createAsset(NvFlexLibrary* lib, MAP &assets) {
+	std::lock_guard<std::mutex> lock(lib->mutex);
+	const unsigned int id = lib->nextId++;
+	assets[id];
+	return id;
+}
+
+template<typename MAP>
+static void destroyAsset(NvFlexLibrary* lib, MAP &assets, unsigned int id) {
+	std::lock_guard<std::mutex> lock(lib->mutex);
+	assets.erase(id);
+}
+
+NvFlexTriangleMeshId NvFlexCreateTriangleMesh(NvFlexLibrary* lib) { return createAsset(lib, lib->meshes); }
+void NvFlexDestroyTriangleMesh(NvFlexLibrary* lib, NvFlexTriangleMeshId mesh) { destroyAsset(lib, lib->meshes, mesh); }
+
+void NvFlexUpdateTriangleMesh(NvFlexLibrary* lib, NvFlexTriangleMeshId mesh, NvFlexBuffer* vertices, NvFlexBuffer* indices, int numVertices, int numTriangles, const float* lower, const float* upper) {
+	std::vector<float> verts;
+	std::vector<int> tris;
+	NvFlexSolver dummy;
+	dummy.lib = lib;
+	//vertices are Vec3 on plugin side, but flex takes them with any stride its buffer was made with
+	const int vcomponents = vertices != NULL ? vertices->stride / int(sizeof(float)) : 3;
+	long long bytes = readBuffer(&dummy, vertices, numVertices, vcomponents, verts);
+	bytes += readBuffer(&dummy, indices, numTriangles, 3, tris);
+	count(eNvFlexHostUpdateTriangleMesh, bytes);
+
+	std::lock_guard<std::mutex> lock(lib->mutex);
+	auto it = lib->meshes.find(mesh);
+	if (it == lib->meshes.end())return;
+	it->second.vertices.swap(verts);
+	it->second.indices.swap(tris);
+	memcpy(it->second.lower, lower, 3 * sizeof(float));
+	memcpy(it->second.upper, upper, 3 * sizeof(float));
+}
+
+void NvFlexGetTriangleMeshBounds(NvFlexLibrary* lib, const NvFlexTriangleMeshId mesh, float* lower, float* upper) {
+	std::lock_guard<std::mutex> lock(lib->mutex);
+	auto it = lib->meshes.find(mesh);
+	if (it == lib->meshes.end())return;
+	memcpy(lower, it->second.lower, 3 * sizeof(float));
+	memcpy(upper, it->second.upper, 3 * sizeof(float));
+}
+
+NvFlexDistanceFieldId NvFlexCreateDistanceField(NvFlexLibrary* lib) { return createAsset(lib, lib->fields); }
+void NvFlexDestroyDistanceField(NvFlexLibrary* lib, NvFlexDistanceFieldId sdf) { destroyAsset(lib, lib->fields, sdf); }
+
+void NvFlexUpdateDistanceField(NvFlexLibrary* lib, NvFlexDistanceFieldId sdf, int dimx, int dimy, int dimz, NvFlexBuffer* field) {
+	std::vector<float> values;
+	NvFlexSolver dummy;
+	dummy.lib = lib;
+	count(eNvFlexHostUpdateDistanceField, readBuffer(&dummy, field, dimx*dimy*dimz, 1, values));
+
+	std::lock_guard<std::mutex> lock(lib->mutex);
+	auto it = lib->fields.find(sdf);
+	if (it == lib->fields.end())return;
+	it->second.field.swap(values);
+	it->second.dim[0] = dimx;
+	it->second.dim[1] = dimy;
+	it->second.dim[2] = dimz;
+}
+
+NvFlexConvexMeshId NvFlexCreateConvexMesh(NvFlexLibrary* lib) { return createAsset(lib, lib->convexes); }
+void NvFlexDestroyConvexMesh(NvFlexLibrary* lib, NvFlexConvexMeshId convex) { destroyAsset(lib, lib->convexes, convex); }
+
+void NvFlexUpdateConvexMesh(NvFlexLibrary* lib, NvFlexConvexMeshId convex, NvFlexBuffer* planes, int numPlanes, const float* lower, const float* upper) {
+	std::vector<float> values;
+	NvFlexSolver dummy;
+	dummy.lib = lib;
+	count(eNvFlexHostUpdateConvexMesh, readBuffer(&dummy, planes, numPlanes, 4, values));
+
+	std::lock_guard<std::mutex> lock(lib->mutex);
+	auto it = lib->convexes.find(convex);
+	if (it == lib->convexes.end())return;
+	it->second.planes.swap(values);
+	memcpy(it->second.lower, lower, 3 * sizeof(float));
+	memcpy(it->second.upper, upper, 3 * sizeof(float));
+}
+
+
+//reference solver
+namespace {
+	struct V3 {
+		float x, y, z;
+		V3() :x(0), y(0), z(0) {}
+		V3(float a, float b, float c) :x(a), y(b), z(c) {}
+		V3 operator+(const V3 &o) const { return V3(x + o.x, y + o.y, z + o.z); }
+		V3 operator-(const V3 &o) const { return V3(x - o.x, y - o.y, z - o.z); }
+		V3 operator*(float s) const { return V3(x*s, y*s, z*s); }
+	};
+	inline float dot(const V3 &a, const V3 &b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+	inline V3 cross(const V3 &a, const V3 &b) { return V3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x); }
+	inline float length(const V3 &a) { return std::sqrt(dot(a, a)); }
+
+	//q is x,y,z,w
+	inline V3 rotate(const float *q, const V3 &v) {
+		const V3 u(q[0], q[1], q[2]);
+		const V3 t = cross(u, v)*2.0f;
+		return v + t*q[3] + cross(u, t);
+	}
+	inline V3 rotateInv(const float *q, const V3 &v) {
+		const float qi[4] = { -q[0], -q[1], -q[2], q[3] };
+		return rotate(qi, v);
+	}
+
+	//pushes local point p out of the shape to at least distance r from its surface
+	bool collideLocal(const NvFlexCollisionGeometry &geo, int type, float r, V3 &p) {
+		if (type == eNvFlexShapeSphere) {
+			const float d = length(p);
+			const float target = geo.sphere.radius + r;
+			if (d >= target || d <= 0)return false;
+			p = p*(target / d);
+			return true;
+		}
+		if (type == eNvFlexShapeCapsule) {
+			const float h = geo.capsule.halfHeight;
+			const V3 axis(std::max(-h, std::min(h, p.x)), 0, 0);
+			const V3 off = p - axis;
+			const float d = length(off);
+			const float target = geo.capsule.radius + r;
+			if (d >= target || d <= 0)return false;
+			p = axis + off*(target / d);
+			return true;
+		}
+		if (type == eNvFlexShapeBox) {
+			const float e[3] = { geo.box.halfExtents[0] + r, geo.box.halfExtents[1] + r, geo.box.halfExtents[2] + r };
+			float *c[3] = { &p.x, &p.y, &p.z };
+			int axis = -1;
+			float best = 1e30f;
+			for (int k = 0; k < 3; ++k) {
+				const float pen = e[k] - std::fabs(*c[k]);
+				if (pen <= 0)return false;
+				if (pen < best) {
+					best = pen;
+					axis = k;
+				}
+			}
+			*c[axis] = *c[axis] < 0 ? -e[axis] : e[axis];
+			return true;
+		}
+		return false;
+	}
+}
+
+void NvFlexUpdateSolver(NvFlexSolver* solver, float dt, int substeps, bool enableTimers) {
+	count(eNvFlexHostUpdateSolver);
+	requireContext(solver->lib);
+	SolverUse use(solver);
+	if (substeps < 1 || dt <= 0)return;
+	const NvFlexParams &prm = solver->params;
+	const float sdt = dt / substeps;
+	const float r = prm.collisionDistance > 0 ? prm.collisionDistance : prm.radius*0.5f;
+	const V3 gravity(prm.gravity[0], prm.gravity[1], prm.gravity[2]);
+	float *x = solver->particles.data();
+	float *v = solver->velocities.data();
+	std::vector<float> pred(solver->particles.size());
+
+	for (int step = 0; step < substeps; ++step) {
+		//predict
+		for (int idx : solver->active) {
+			if (idx < 0 || idx >= solver->maxParticles)continue;
+			float *pv = v + idx * 3;
+			const float w = x[idx * 4 + 3];
+			if (w > 0) {
+				for (int k = 0; k < 3; ++k)pv[k] = (pv[k] + (&gravity.x)[k] * sdt)*std::max(0.0f, 1.0f - prm.damping*sdt);
+				const float speed = length(V3(pv[0], pv[1], pv[2]));
+				if (speed > prm.maxSpeed && speed > 0)for (int k = 0; k < 3; ++k)pv[k] *= prm.maxSpeed / speed;
+			}
+			for (int k = 0; k < 3; ++k)pred[idx * 4 + k] = x[idx * 4 + k] + (w > 0 ? pv[k] * sdt : 0.0f);
+			pred[idx * 4 + 3] = w;
+		}
+
+		for (int it = 0; it < std::max(1, prm.numIterations); ++it) {
+			//springs, gauss-seidel in given order
+			for (size_t s = 0; s < solver->springRestLengths.size(); ++s) {
+				const int a = solver->springIndices[s * 2], b = solver->springIndices[s * 2 + 1];
+				const float wa = pred[a * 4 + 3], wb = pred[b * 4 + 3];
+				if (wa + wb <= 0)continue;
+				const V3 pa(pred[a * 4], pred[a * 4 + 1], pred[a * 4 + 2]), pb(pred[b * 4], pred[b * 4 + 1], pred[b * 4 + 2]);
+				const V3 d = pb - pa;
+				const float len = length(d);
+				if (len <= 0)continue;
+				const float stiffness = s < solver->springStiffness.size() ? solver->springStiffness[s] : 1.0f;
+				const V3 corr = d*((len - solver->springRestLengths[s]) / (len*(wa + wb))*stiffness);
+				for (int k = 0; k < 3; ++k) {
+					pred[a * 4 + k] += (&corr.x)[k] * wa;
+					pred[b * 4 + k] -= (&corr.x)[k] * wb;
+				}
+			}
+
+			//planes and analytic shapes
+			for (int idx : solver->active) {
+				if (idx < 0 || idx >= solver->maxParticles || pred[idx * 4 + 3] <= 0)continue;
+				V3 p(pred[idx * 4], pred[idx * 4 + 1], pred[idx * 4 + 2]);
+				for (int pl = 0; pl < prm.numPlanes; ++pl) {
+					const V3 n(prm.planes[pl][0], prm.planes[pl][1], prm.planes[pl][2]);
+					const float d = dot(n, p) + prm.planes[pl][3] - r;
+					if (d < 0)p = p - n*d;
+				}
+				for (size_t sh = 0; sh < solver->shapeGeometry.size(); ++sh) {
+					const float *spos = solver->shapePositions.data() + sh * 4;
+					const float *srot = solver->shapeRotations.data() + sh * 4;
+					V3 lp = rotateInv(srot, p - V3(spos[0], spos[1], spos[2]));
+					if (collideLocal(solver->shapeGeometry[sh], solver->shapeFlags[sh] & eNvFlexShapeFlagTypeMask, r, lp))p = rotate(srot, lp) + V3(spos[0], spos[1], spos[2]);
+				}
+				pred[idx * 4] = p.x;
+				pred[idx * 4 + 1] = p.y;
+				pred[idx * 4 + 2] = p.z;
+			}
+		}
+
+		//velocities from positions
+		for (int idx : solver->active) {
+			if (idx < 0 || idx >= solver->maxParticles || x[idx * 4 + 3] <= 0)continue;
+			for (int k = 0; k < 3; ++k) {
+				v[idx * 3 + k] = (pred[idx * 4 + k] - x[idx * 4 + k]) / sdt;
+				x[idx * 4 + k] = pred[idx * 4 + k];
+			}
+		}
+	}
+}
+
+
+//extensions: container with its own free list and host side particle buffers
+struct NvFlexExtContainer {
+	NvFlexLibrary* lib;
+	NvFlexSolver* solver;
+	int maxParticles;
+	std::vector<int> freeList;
+	std::vector<int> activeList;
+	NvFlexBuffer* particles;
+	NvFlexBuffer* restParticles;
+	NvFlexBuffer* velocities;
+	NvFlexBuffer* phases;
+	NvFlexBuffer* normals;
+	NvFlexBuffer* active;
+	float lower[3], upper[3];
+};
+
+NvFlexExtContainer* NvFlexExtCreateContainer(NvFlexLibrary* lib, NvFlexSolver* solver, int maxParticles) {
+	NvFlexExtContainer* c = new NvFlexExtContainer();
+	c->lib = lib;
+	c->solver = solver;
+	c->maxParticles = maxParticles;
+	for (int i = maxParticles - 1; i >= 0; --i)c->freeList.push_back(i);
+	c->particles = NvFlexAllocBuffer(lib, maxParticles, sizeof(float) * 4, eNvFlexBufferHost);
+	c->restParticles = NvFlexAllocBuffer(lib, maxParticles, sizeof(float) * 4, eNvFlexBufferHost);
+	c->velocities = NvFlexAllocBuffer(lib, maxParticles, sizeof(float) * 3, eNvFlexBufferHost);
+	c->phases = NvFlexAllocBuffer(lib, maxParticles, sizeof(int), eNvFlexBufferHost);
+	c->normals = NvFlexAllocBuffer(lib, maxParticles, sizeof(float) * 4, eNvFlexBufferHost);
+	c->active = NvFlexAllocBuffer(lib, maxParticles, sizeof(int), eNvFlexBufferHost);
+	memset(c->lower, 0, sizeof(c->lower));
+	memset(c->upper, 0, sizeof(c->upper));
+	return c;
+}
+
+void NvFlexExtDestroyContainer(NvFlexExtContainer* c) {
+	NvFlexFreeBuffer(c->particles);
+	NvFlexFreeBuffer(c->restParticles);
+	NvFlexFreeBuffer(c->velocities);
+	NvFlexFreeBuffer(c->phases);
+	NvFlexFreeBuffer(c->normals);
+	NvFlexFreeBuffer(c->active);
+	delete c;
+}
+
+int NvFlexExtAllocParticles(NvFlexExtContainer* c, int n, int* indices) {
+	count(eNvFlexHostExtAllocParticles, (long long)n * sizeof(int));
+	const int m = std::min(n, int(c->freeList.size()));
+	for (int i = 0; i < m; ++i) {
+		indices[i] = c->freeList.back();
+		c->freeList.pop_back();
+		c->activeList.push_back(indices[i]);
+	}
+	return m;
+}
+
+void NvFlexExtFreeParticles(NvFlexExtContainer* c, int n, const int* indices) {
+	count(eNvFlexHostExtFreeParticles, (long long)n * sizeof(int));
+	for (int i = 0; i < n; ++i) {
+		auto it = std::find(c->activeList.begin(), c->activeList.end(), indices[i]);
+		if (it == c->activeList.end())continue;
+		*it = c->activeList.back();
+		c->activeList.pop_back();
+		c->freeList.push_back(indices[i]);
+	}
+}
+
+int NvFlexExtGetActiveList(NvFlexExtContainer* c, int* indices) {
+	count(eNvFlexHostExtGetActiveList, (long long)c->activeList.size() * sizeof(int));
+	std::copy(c->activeList.begin(), c->activeList.end(), indices);
+	return int(c->activeList.size());
+}
+
+NvFlexExtParticleData NvFlexExtMapParticleData(NvFlexExtContainer* c) {
+	count(eNvFlexHostExtMapParticleData);
+	NvFlexExtParticleData pdat;
+	pdat.particles = (float*)NvFlexMap(c->particles, eNvFlexMapWait);
+	pdat.restParticles = (float*)NvFlexMap(c->restParticles, eNvFlexMapWait);
+	pdat.velocities = (float*)NvFlexMap(c->velocities, eNvFlexMapWait);
+	pdat.phases = (int*)NvFlexMap(c->phases, eNvFlexMapWait);
+	pdat.normals = (float*)NvFlexMap(c->normals, eNvFlexMapWait);
+	pdat.lower = c->lower;
+	pdat.upper = c->upper;
+	return pdat;
+}
+
+void NvFlexExtUnmapParticleData(NvFlexExtContainer* c) {
+	NvFlexUnmap(c->particles);
+	NvFlexUnmap(c->restParticles);
+	NvFlexUnmap(c->velocities);
+	NvFlexUnmap(c->phases);
+	NvFlexUnmap(c->normals);
+}
+
+void NvFlexExtPushToDevice(NvFlexExtContainer* c) {
+	int* active = (int*)NvFlexMap(c->active, eNvFlexMapWait);
+	std::copy(c->activeList.begin(), c->activeList.end(), active);
+	NvFlexUnmap(c->active);
+	NvFlexSetActive(c->solver, c->active, int(c->activeList.size()));
+	NvFlexSetParticles(c->solver, c->particles, c->maxParticles);
+	NvFlexSetRestParticles(c->solver, c->restParticles, c->maxParticles);
+	NvFlexSetVelocities(c->solver, c->velocities, c->maxParticles);
+	NvFlexSetPhases(c->solver, c->phases, c->maxParticles);
+}
+
+void NvFlexExtPullFromDevice(NvFlexExtContainer* c) {
+	NvFlexGetParticles(c->solver, c->particles, c->maxParticles);
+	NvFlexGetVelocities(c->solver, c->velocities, c->maxParticles);
+	NvFlexGetPhases(c->solver, c->phases, c->maxParticles);
+}
+
+void NvFlexExtTickContainer(NvFlexExtContainer* c, float dt, int numSubsteps, bool enableTimers) {
+	count(eNvFlexHostExtTickContainer);
+	NvFlexExtPushToDevice(c);
+	NvFlexUpdateSolver(c->solver, dt, numSubsteps, enableTimers);
+	NvFlexExtPullFromDevice(c);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdio.h>
+
+//counters kept by the host backend (hostflex/NvFlexHost.cpp). only there when built with FLEX_BACKEND=host
+//bytes are what would cross host-device boundary with real flex: everything passed to Set*, Get* and Update* calls
+
+#define NVFLEXHOST_CALLS(X) \
+	X(AllocBuffer) X(FreeBuffer) X(Map) X(Unmap) \
+	X(SetParams) X(GetParams) X(SetActive) X(GetActive) \
+	X(SetParticles) X(GetParticles) X(SetRestParticles) X(GetRestParticles) X(SetVelocities) X(GetVelocities) X(SetPhases) X(GetPhases) \
+	X(SetSprings) X(SetDynamicTriangles) X(SetRigids) X(GetRigidTransforms) X(SetShapes) \
+	X(UpdateTriangleMesh) X(UpdateDistanceField) X(UpdateConvexMesh) X(UpdateSolver) \
+	X(ExtAllocParticles) X(ExtFreeParticles) X(ExtGetActiveList) X(ExtMapParticleData) X(ExtTickContainer)
+
+enum NvFlexHostCall {
+#define NVFLEXHOST_ENUM(name) eNvFlexHost##name,
+	NVFLEXHOST_CALLS(NVFLEXHOST_ENUM)
+#undef NVFLEXHOST_ENUM
+	eNvFlexHostCallCount
+};
+
+struct NvFlexHostCallStats {
+	long long calls;
+	long long bytes;
+};
+
+void NvFlexHostGetStats(NvFlexHostCallStats* stats); //eNvFlexHostCallCount entries
+const char* NvFlexHostCallName(int call);
+void NvFlexHostResetStats();
+void NvFlexHostPrintStats(FILE* out); //only calls that happened
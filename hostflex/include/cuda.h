@@ -0,0 +1,7 @@
+#pragma once
+//host backend stand-in for the bits of cuda driver api the plugin touches directly
+
+typedef int CUresult;
+#define CUDA_SUCCESS 0
+
+inline CUresult cuInit(unsigned int) { return CUDA_SUCCESS; }
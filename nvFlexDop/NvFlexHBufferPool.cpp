@@ -0,0 +1,101 @@
+#include "utils.h"
+#include "NvFlexHBufferPool.h"
+
+NvFlexHBufferPool& NvFlexHBufferPool::instance() {
+	static NvFlexHBufferPool pool;
+	return pool;
+}
+
+NvFlexHBufferPool::NvFlexHBufferPool() :_pooledBytes(0), _maxBytes(int64(64) << 20), _allocs(0), _reuses(0), _frees(0) {}
+
+NvFlexHBufferPool::~NvFlexHBufferPool() {
+	//same as container pool: library is long gone by now, buffers are left to process exit
+}
+
+NvFlexBuffer* NvFlexHBufferPool::acquire(NvFlexLibrary* lib, int &capacity, int stride) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		//smallest fitting one, so big buffers stay for big requests
+		auto best = _free.end();
+		for (auto it = _free.begin(); it != _free.end(); ++it) {
+			if (it->lib != lib || it->stride != stride || it->capacity < capacity || int64(it->capacity) > int64(capacity) * 2)continue;
+			if (best == _free.end() || it->capacity < best->capacity)best = it;
+		}
+		if (best != _free.end()) {
+			NvFlexBuffer *buffer = best->buffer;
+			capacity = best->capacity;
+			_pooledBytes -= int64(best->capacity) * best->stride;
+			_free.erase(best);
+			++_reuses;
+			return buffer;
+		}
+		++_allocs;
+	}
+	return NvFlexAllocBuffer(lib, capacity, stride, eNvFlexBufferHost);
+}
+
+void NvFlexHBufferPool::recycle(NvFlexLibrary* lib, NvFlexBuffer* buffer, int capacity, int stride) {
+	if (buffer == NULL)return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	const int64 bytes = int64(capacity) * stride;
+	if (bytes > _maxBytes) {
+		NvFlexFreeBuffer(buffer);
+		++_frees;
+		return;
+	}
+	Entry entry;
+	entry.lib = lib;
+	entry.buffer = buffer;
+	entry.capacity = capacity;
+	entry.stride = stride;
+	_free.push_back(entry);
+	_pooledBytes += bytes;
+	trim(_maxBytes);
+}
+
+void NvFlexHBufferPool::trim(int64 keep) {
+	while (_pooledBytes > keep && !_free.empty()) {
+		const Entry &entry = _free.front();
+		NvFlexFreeBuffer(entry.buffer);
+		_pooledBytes -= int64(entry.capacity) * entry.stride;
+		++_frees;
+		_free.pop_front();
+	}
+}
+
+void NvFlexHBufferPool::clear() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	trim(-1);
+	messageLog(5, "buffer pool cleared: %lld allocated, %lld reused, %lld freed\n", (long long)_allocs, (long long)_reuses, (long long)_frees);
+}
+
+void NvFlexHBufferPool::setMaxBytes(int64 bytes) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_maxBytes = bytes < 0 ? 0 : bytes;
+	trim(_maxBytes);
+}
+
+int64 NvFlexHBufferPool::getMaxBytes() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _maxBytes;
+}
+
+int64 NvFlexHBufferPool::getPooledBytes() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _pooledBytes;
+}
+
+exint NvFlexHBufferPool::getAllocCount() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _allocs;
+}
+
+exint NvFlexHBufferPool::getReuseCount() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _reuses;
+}
+
+exint NvFlexHBufferPool::getFreeCount() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _frees;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <SYS/SYS_Types.h>
+#include <NvFlex.h>
+
+#include <deque>
+#include <mutex>
+
+//process wide free list of flex host buffers. vectors that grow, shrink or go away hand their buffers over to the next one asking
+//for a similar capacity, instead of freeing pinned memory and allocating it again. context must be acquired for acquire, recycle and clear
+class NvFlexHBufferPool {
+public:
+	static NvFlexHBufferPool& instance();
+
+	//pooled buffer of this library and stride holding at least capacity elements (but not more than twice that), or a new one
+	//capacity is set to what the buffer actually holds
+	NvFlexBuffer* acquire(NvFlexLibrary* lib, int &capacity, int stride);
+	//buffer must be unmapped. if the pool is over its byte limit, least recently recycled buffers are freed
+	void recycle(NvFlexLibrary* lib, NvFlexBuffer* buffer, int capacity, int stride);
+	void clear(); //for library shutdown, frees everything pooled
+
+	void setMaxBytes(int64 bytes); //0 - nothing is pooled
+	int64 getMaxBytes() const;
+	int64 getPooledBytes() const;
+
+	exint getAllocCount() const; //buffers that had to be allocated from flex
+	exint getReuseCount() const; //acquires served from the pool
+	exint getFreeCount() const; //buffers given back to flex
+
+private:
+	NvFlexHBufferPool();
+	~NvFlexHBufferPool();
+	NvFlexHBufferPool(const NvFlexHBufferPool&) = delete;
+	NvFlexHBufferPool& operator=(const NvFlexHBufferPool&) = delete;
+
+	//frees least recently recycled buffers until pooled bytes fit into keep. lock must be held
+	void trim(int64 keep);
+
+	struct Entry {
+		NvFlexLibrary* lib;
+		NvFlexBuffer* buffer;
+		int capacity;
+		int stride;
+	};
+
+	mutable std::mutex _mutex;
+	std::deque<Entry> _free; //most recently recycled at the back
+	int64 _pooledBytes;
+	int64 _maxBytes;
+	exint _allocs;
+	exint _reuses;
+	exint _frees;
+};
@@ -0,0 +1,247 @@
+#include <GA/GA_SplittableRange.h>
+#include <UT/UT_ParallelUtil.h>
+#include <UT/UT_FileUtil.h>
+
+#include <algorithm>
+
+#include "utils.h"
+#include "NvFlexHShapeFit.h"
+#include "NvFlexHSdfBake.h"
+#include "NvFlexHColliderUpdate.h"
+
+static inline NvFlexCollisionShapeType fittedShapeType(const NvFlexHShapeFit &fit) {
+	switch (fit.type) {
+	case NVFLEXH_FIT_SPHERE: return eNvFlexShapeSphere;
+	case NVFLEXH_FIT_CAPSULE: return eNvFlexShapeCapsule;
+	case NVFLEXH_FIT_BOX: return eNvFlexShapeBox;
+	default: return eNvFlexShapeTriangleMesh;
+	}
+}
+
+//fan triangulation of all primitives into point indices
+void triangulateCollider(const GU_Detail *gdp, std::vector<int> &trigeot) {
+	GA_Size tricount = 0;
+	for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+		tricount += std::max(gdp->getPrimitiveVertexCount(*it) - 2, GA_Size(0));
+	}
+	trigeot.resize(tricount * 3);
+	size_t i = 0;
+	for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+		GA_OffsetListRef pvlr=gdp->getPrimitiveVertexList(*it);
+		GA_Index sttidx = -1;
+		GA_Index prvidx = -1;
+		for (int vi = 0; vi < pvlr.entries(); ++vi) {
+			GA_Index idx = gdp->pointIndex(gdp->vertexPoint(pvlr(vi)));
+			if (vi == 0)sttidx = idx;
+			else if (vi > 1) {
+				//invert order cuz houdini goes clockwise
+				trigeot[i++] = sttidx;
+				trigeot[i++] = idx;
+				trigeot[i++] = prvidx;
+			}
+			prvidx = idx;
+		}
+	}
+}
+
+//parallel copy of P into vertices by point index, reducing bounds on the way
+class ColliderPointsCopy {
+public:
+	ColliderPointsCopy(const GU_Detail *gdp, Vec3 *verts) :_gdp(gdp), _verts(verts) { initBounds(); }
+	ColliderPointsCopy(ColliderPointsCopy &src, UT_Split) :_gdp(src._gdp), _verts(src._verts) { initBounds(); }
+
+	void operator()(const GA_SplittableRange &r) {
+		GA_Offset start, end;
+		for (GA_Iterator it(r); it.blockAdvance(start, end);) {
+			for (GA_Offset off = start; off < end; ++off) {
+				UT_Vector3 p = _gdp->getPos3(off);
+				Vec3 &v = _verts[_gdp->pointIndex(off)];
+				v.x = p.x();
+				v.y = p.y();
+				v.z = p.z();
+				for (int k = 0; k < 3; ++k) {
+					lower[k] = std::min(p[k], lower[k]);
+					upper[k] = std::max(p[k], upper[k]);
+				}
+			}
+		}
+	}
+	void join(const ColliderPointsCopy &other) {
+		for (int k = 0; k < 3; ++k) {
+			lower[k] = std::min(other.lower[k], lower[k]);
+			upper[k] = std::max(other.upper[k], upper[k]);
+		}
+	}
+
+	float lower[3];
+	float upper[3];
+
+private:
+	void initBounds() {
+		lower[0] = lower[1] = lower[2] = FLT_MAX;
+		upper[0] = upper[1] = upper[2] = -FLT_MAX;
+	}
+	const GU_Detail *_gdp;
+	Vec3 *_verts;
+};
+
+void copyColliderPoints(const GU_Detail *gdp, std::vector<Vec3> &verts, float *lower, float *upper) {
+	verts.resize(gdp->getNumPoints());
+	ColliderPointsCopy body(gdp, verts.data());
+	UTparallelReduce(GA_SplittableRange(gdp->getPointRange()), body);
+	memcpy(lower, body.lower, 3 * sizeof(float));
+	memcpy(upper, body.upper, 3 * sizeof(float));
+}
+
+NvFlexHShapeHandle updateColliderShape(NvFlexHCollisionData *colldata, int64 key, const GU_Detail *gdp, const NvFlexHColliderOptions &options) {
+	NvFlexHShapeHandle shape = colldata->findShape(key);
+	//primitive list id also covers volume voxels and quadric transforms, which never touch P
+	const int64 collDataIds[2] = { gdp->getP()->getDataId(), gdp->getPrimitiveList().getDataId() };
+	const int64 collDataId = int64(hashBytes(0, collDataIds, sizeof(collDataIds)) >> 1);
+
+	if (collDataId != colldata->getStoredHash(shape)) {
+		//simple colliders go to flex as analytic shapes, those are far cheaper to collide with than triangles
+		//fit only sees the surface, so a closed hollow collider would turn solid. for all colliders or for ones marked with nvflex_analytic detail attribute
+		GA_ROHandleI anlthnd(gdp->findGlobalAttribute("nvflex_analytic"));
+		NvFlexHShapeFit fit;
+		const bool analytic = (options.analytic || (anlthnd.isValid() && anlthnd.get(GA_Offset(0)) != 0)) && fitAnalyticShape(gdp, options.analyticTolerance, fit);
+		//sdf volumes, and meshes too dense to collide against triangle by triangle, go as distance fields
+		const GEO_Primitive *sdfvolume = analytic ? NULL : findSdfVolume(gdp);
+		//debris and props go as convex hulls, for all colliders or for ones marked with nvflex_convex detail attribute
+		GA_ROHandleI cnvxhnd(gdp->findGlobalAttribute("nvflex_convex"));
+		const bool convex = !analytic && sdfvolume == NULL && (options.convex || (cnvxhnd.isValid() && cnvxhnd.get(GA_Offset(0)) != 0));
+		const bool sdf = !analytic && !convex && (sdfvolume != NULL || (options.sdfTriangleThreshold > 0 && colliderTriangleCount(gdp) >= options.sdfTriangleThreshold));
+		NvFlexCollisionShapeType shapeType = eNvFlexShapeTriangleMesh;
+		if (analytic)shapeType = fittedShapeType(fit);
+		else if (convex)shapeType = eNvFlexShapeConvexMesh;
+		else if (sdf)shapeType = eNvFlexShapeSDF;
+		if (shape != NVFLEXH_INVALID_SHAPE && colldata->getShapeType(shape) != shapeType) {
+			colldata->removeShape(shape);
+			shape = NVFLEXH_INVALID_SHAPE;
+		}
+		if (shape == NVFLEXH_INVALID_SHAPE) {
+			if (analytic)shape = colldata->addAnalyticShape(key, shapeType);
+			else if (convex)shape = colldata->addConvexMesh(key);
+			else if (sdf)shape = colldata->addDistanceField(key);
+			else shape = colldata->addTriangleMesh(key);
+		}
+		colldata->setStoredHash(shape, collDataId);
+
+		if (analytic) {
+			messageLog(5, "updating analytic collider %lld, shape type %d\n", key, int(shapeType));
+			NvFlexCollisionGeometry geo;
+			memset(&geo, 0, sizeof(NvFlexCollisionGeometry));
+			if (fit.type == NVFLEXH_FIT_SPHERE) {
+				geo.sphere.radius = fit.radius;
+			}
+			else if (fit.type == NVFLEXH_FIT_CAPSULE) {
+				geo.capsule.radius = fit.radius;
+				geo.capsule.halfHeight = fit.halfHeight;
+			}
+			else {
+				geo.box.halfExtents[0] = fit.halfExtents.x();
+				geo.box.halfExtents[1] = fit.halfExtents.y();
+				geo.box.halfExtents[2] = fit.halfExtents.z();
+			}
+			colldata->setAnalyticGeometry(shape, geo, Vec3(fit.center.x(), fit.center.y(), fit.center.z()), Quat(fit.orientation[0], fit.orientation[1], fit.orientation[2], fit.orientation[3]));
+		}
+		else if (convex) {
+			//keyed by the same P and primitive list ids as everything else, so still pieces are never refitted
+			std::vector<UT_Vector4F> hull;
+			UT_Vector3F hulllw, hullup;
+			if (fitConvexPlanes(gdp, options.convexMaxPlanes, hull, hulllw, hullup)) {
+				std::vector<Vec4> planes(hull.size());
+				for (size_t i = 0; i < hull.size(); ++i)planes[i] = Vec4(hull[i].x(), hull[i].y(), hull[i].z(), hull[i].w());
+				colldata->setConvexMesh(shape, planes.data(), int(planes.size()), hulllw.data(), hullup.data());
+				messageLog(5, "updating convex collider %lld, %d planes\n", key, int(planes.size()));
+			}
+			else messageLog(1, "convex collider %lld has no points, skipping it\n", key);
+		}
+		else if (sdf) {
+			const int dim = options.sdfResolution;
+			UT_BoundingBox bounds;
+			if (sdfvolume != NULL)sdfvolume->getBBox(&bounds);
+			else gdp->getBBox(&bounds);
+			NvFlexHSdfFrame frame;
+			if (sdfFrame(bounds, dim, frame)) {
+				std::vector<float> field;
+				uint64 fieldHash;
+				bool deforming = false;
+				if (sdfvolume != NULL) {
+					//volumes are distance fields already and resampling is cheap, so they are keyed by the resampled field
+					sampleVolumeSdf(sdfvolume, dim, frame, field);
+					fieldHash = NvFlexHDistanceFieldCache::fieldHash(field.data(), dim);
+				}
+				else {
+					//mesh bakes are keyed by mesh content and resolution, so the bake runs only when neither memory nor disk has it
+					NvFlexHCollisionData::ColliderTriangles &tris = colldata->colliderTriangles(shape);
+					const int64 colltopdid = gdp->getTopology().getDataId();
+					if (tris.topologyId != colltopdid) {
+						triangulateCollider(gdp, tris.indices);
+						tris.hash = NvFlexHTriangleMeshCache::trianglesHash(tris.indices.data(), int(tris.indices.size() / 3));
+						tris.topologyId = colltopdid;
+						tris.bakedHash = 0;
+					}
+					std::vector<Vec3> trigeop;
+					float trigeolw[3], trigeoup[3];
+					copyColliderPoints(gdp, trigeop, trigeolw, trigeoup);
+					fieldHash = NvFlexHTriangleMeshCache::contentHash(trigeop.data(), int(trigeop.size()), tris.hash);
+					fieldHash = hashBytes(fieldHash, &dim, sizeof(dim));
+					//same triangles, new points - it deforms, and its bakes are never asked for again, so they stay off disk
+					deforming = tris.bakedHash != 0 && tris.bakedHash != fieldHash;
+					tris.bakedHash = fieldHash;
+				}
+
+				const Vec3 corner(frame.origin.x(), frame.origin.y(), frame.origin.z());
+				if (!colldata->setDistanceField(shape, fieldHash, field.empty() ? NULL : field.data(), dim, corner, frame.size)) {
+					const UT_String &cachedir = options.sdfCacheDir;
+					if (NvFlexHDistanceFieldCache::loadBake(cachedir, fieldHash, dim, field)) {
+						messageLog(5, "loaded sdf bake %s\n", NvFlexHDistanceFieldCache::bakePath(cachedir, fieldHash).c_str());
+					}
+					else {
+						messageLog(3, "baking %d^3 sdf for collider %lld...\n", dim, key);
+						bakeMeshSdf(gdp, dim, frame, field);
+						if (cachedir.isstring() && !deforming) {
+							UT_FileUtil::makeDirs(cachedir);
+							if (!NvFlexHDistanceFieldCache::saveBake(cachedir, fieldHash, dim, field))messageLog(1, "could not write sdf bake to %s\n", (const char*)cachedir);
+							const int pruned = NvFlexHDistanceFieldCache::pruneBakes(cachedir, options.sdfCacheMaxBytes);
+							if (pruned > 0)messageLog(5, "pruned %d old sdf bakes from %s\n", pruned, (const char*)cachedir);
+						}
+						else if (deforming)messageLog(5, "collider %lld deforms, its sdf bake is not written to disk\n", key);
+					}
+					colldata->setDistanceField(shape, fieldHash, field.data(), dim, corner, frame.size);
+				}
+				const NvFlexHDistanceFieldCache &fieldcache = NvFlexHDistanceFieldCache::instance();
+				messageLog(5, "sdf collider %lld: %lld fields, %lld hits, %lld misses\n", key, fieldcache.size(), fieldcache.getHitCount(), fieldcache.getMissCount());
+			}
+			else messageLog(1, "sdf collider %lld has empty bounds, skipping it\n", key);
+		}
+		else {
+			messageLog(5, "updating collision mesh %lld\n", key);
+
+			//triangles are rebuilt only when collider topology changes, deforming colliders just refresh vertices
+			NvFlexHCollisionData::ColliderTriangles &tris = colldata->colliderTriangles(shape);
+			const int64 colltopdid = gdp->getTopology().getDataId();
+			const bool sameTriangles = tris.topologyId == colltopdid;
+			if (!sameTriangles) {
+				triangulateCollider(gdp, tris.indices);
+				tris.hash = NvFlexHTriangleMeshCache::trianglesHash(tris.indices.data(), int(tris.indices.size() / 3));
+				tris.topologyId = colltopdid;
+			}
+			const int tricount = int(tris.indices.size() / 3);
+
+			std::vector<Vec3> trigeop;
+			float trigeolw[3], trigeoup[3];
+			copyColliderPoints(gdp, trigeop, trigeolw, trigeoup);
+
+			//same content anywhere in the library - same mesh, so identical colliders are uploaded once
+			const uint64 contentHash = NvFlexHTriangleMeshCache::contentHash(trigeop.data(), int(trigeop.size()), tris.hash);
+			if (colldata->setTriangleMesh(shape, contentHash, trigeop.data(), tris.indices.data(), int(trigeop.size()), tricount, trigeolw, trigeoup, sameTriangles)) {
+				const NvFlexHTriangleMeshCache &meshcache = NvFlexHTriangleMeshCache::instance();
+				messageLog(5, "collision mesh cache: %lld meshes, %lld hits, %lld misses, %lld in place updates\n", meshcache.size(), meshcache.getHitCount(), meshcache.getMissCount(), meshcache.getInPlaceUpdateCount());
+			}
+
+		}
+	}
+	return shape;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_String.h>
+
+#include <vector>
+
+#include "NvFlexHCollisionData.h"
+
+//how colliders are turned into flex shapes, solver fills it from its parameters
+struct NvFlexHColliderOptions {
+	bool analytic; //false - only colliders with nvflex_analytic detail attribute are fitted
+	float analyticTolerance;
+	bool convex;
+	int convexMaxPlanes;
+	int sdfResolution;
+	int sdfTriangleThreshold; //0 - dense meshes stay triangle meshes
+	UT_String sdfCacheDir; //empty - bakes are not written to disk
+	int64 sdfCacheMaxBytes; //oldest bakes in the cache dir are deleted past this
+
+	NvFlexHColliderOptions() :analytic(false), analyticTolerance(0.01f), convex(false), convexMaxPlanes(64), sdfResolution(64), sdfTriangleThreshold(0), sdfCacheMaxBytes(int64(512) << 20) {}
+};
+
+//fan triangulation of all primitives into point indices
+void triangulateCollider(const GU_Detail *gdp, std::vector<int> &trigeot);
+//P by point index, with bounds
+void copyColliderPoints(const GU_Detail *gdp, std::vector<Vec3> &verts, float *lower, float *upper);
+
+//brings the shape of collider key up to date with its geometry, creating it if needed. collision buffers must be mapped
+//picks analytic, convex, sdf or triangle mesh representation and replaces the shape if that choice changed
+//nothing is done while collider's P and primitive list data ids stay the same. transform is left to the caller
+NvFlexHShapeHandle updateColliderShape(NvFlexHCollisionData *colldata, int64 key, const GU_Detail *gdp, const NvFlexHColliderOptions &options);
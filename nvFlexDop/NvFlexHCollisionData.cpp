@@ -1,104 +1,340 @@
+#include <algorithm>
+
 #include "NvFlexHCollisionData.h"
 #include "NvFlexHTriangleMesh.h"
+#include "NvFlexHDistanceField.h"
+
+static inline int handleSlot(NvFlexHShapeHandle handle) {
+	return int(handle & 0xffffffff);
+}
 
+static inline uint32 handleGeneration(NvFlexHShapeHandle handle) {
+	return uint32(handle >> 32);
+}
+
+static inline NvFlexHShapeHandle makeHandle(int slot, uint32 generation) {
+	return (NvFlexHShapeHandle(generation) << 32) | NvFlexHShapeHandle(slot);
+}
+
+
+NvFlexHCollisionData::ShapeSlot* NvFlexHCollisionData::slotOf(NvFlexHShapeHandle handle) {
+	return const_cast<ShapeSlot*>(static_cast<const NvFlexHCollisionData*>(this)->slotOf(handle));
+}
+
+const NvFlexHCollisionData::ShapeSlot* NvFlexHCollisionData::slotOf(NvFlexHShapeHandle handle) const {
+	if (handle < 0)return NULL;
+	const int slot = handleSlot(handle);
+	if (slot >= int(slots.size()))return NULL;
+	const ShapeSlot &s = slots[slot];
+	if (s.dense < 0 || s.generation != handleGeneration(handle))return NULL;
+	return &s;
+}
 
-bool NvFlexHCollisionData::hasKey(const std::string &key) const {
-	return collmap.find(key) != collmap.end();
+NvFlexHShapeHandle NvFlexHCollisionData::findShape(int64 key) const {
+	auto it = keymap.find(key);
+	return it == keymap.end() ? NVFLEXH_INVALID_SHAPE : it->second;
 }
 
-bool NvFlexHCollisionData::removeItem(const std::string &key) {
+bool NvFlexHCollisionData::isValid(NvFlexHShapeHandle handle) const {
+	return slotOf(handle) != NULL;
+}
+
+void NvFlexHCollisionData::setDenseDirty(int dense) {
+	if (densedirty[dense])return;
+	densedirty[dense] = 1;
+	++_dirtyCount;
+}
+
+NvFlexHShapeHandle NvFlexHCollisionData::addShape(int64 key, int flags) {
 	// buffers must be mapped!
-	if (!hasKey(key))return false;
-	int id = collmap.at(key);
-	collmap.erase(key);
-	hashmap.erase(key);
-	for (auto it = collmap.begin(); it != collmap.end(); ++it) {
-		int cid = it->second;
-		if (cid > id) collmap[it->first] -= 1;
-	}
-	if (flagvec[id] & eNvFlexShapeFlagTypeMask == eNvFlexShapeTriangleMesh) {
-		NvFlexTriangleMeshId mid = colgeovec[id].triMesh.mesh;
-		delete meshmap[mid];
-		meshmap.erase(mid);
+	if (keymap.find(key) != keymap.end())return NVFLEXH_INVALID_SHAPE;
+	int slot;
+	if (freeslots.size() > 0) {
+		slot = freeslots.back();
+		freeslots.pop_back();
 	}
-	for (int i = id; i < colgeovec.size() - 1; ++i) {
-		//shift down all (we assume there's not that much of them, so it's okay
-		colgeovec[i] = colgeovec[i + 1];
-		positionvec[i] = positionvec[i + 1];
-		rotationvec[i] = rotationvec[i + 1];
-		prevpositionvec[i] = prevpositionvec[i + 1];
-		prevrotationvec[i] = prevrotationvec[i + 1];
-		flagvec[i] = flagvec[i + 1];
+	else {
+		slot = int(slots.size());
+		slots.push_back(ShapeSlot());
 	}
-	resizeall(colgeovec.size() - 1);
-	return true;
-}
+	const int nid = colgeovec.size();
+	resizeall(nid + 1);
+	denseslots.push_back(slot);
+	densedirty.push_back(0);
 
-bool NvFlexHCollisionData::addSphere(const std::string &key) {
-	// buffers must be mapped!
-	if (hasKey(key))return false;
-	int oldsize = colgeovec.size();
-	collmap[key] = oldsize;
-	hashmap[key] = -2;
-	resizeall(oldsize + 1);
-	int nid = colgeovec.size() - 1;
-	flagvec[nid] = NvFlexMakeShapeFlags(eNvFlexShapeSphere, true);
+	ShapeSlot &s = slots[slot];
+	s.dense = nid;
+	s.key = key;
+	s.storedHash = -2;
+	s.lastTouched = _step;
+	s.mesh = CachedMesh();
+	s.sdf = CachedField();
+	s.convex = NULL;
+	s.triangles = ColliderTriangles();
+	s.localPosition = Vec3();
+	s.localRotation = Quat();
+
+	memset(&colgeovec[nid], 0, sizeof(NvFlexCollisionGeometry));
+	flagvec[nid] = flags;
 	rotationvec[nid] = Quat();
 	prevrotationvec[nid] = Quat();
+	positionvec[nid] = Vec4(0, 0, 0, 1);
+	prevpositionvec[nid] = Vec4(0, 0, 0, 1);
+
+	const NvFlexHShapeHandle handle = makeHandle(slot, s.generation);
+	keymap[key] = handle;
+	_setChanged = true;
+	return handle;
+}
+
+void NvFlexHCollisionData::releaseCached(ShapeSlot &s) {
+	if (s.mesh.mesh != NULL)NvFlexHTriangleMeshCache::instance().release(s.mesh.hash, s.mesh.mesh);
+	if (s.sdf.field != NULL)NvFlexHDistanceFieldCache::instance().release(s.sdf.hash, s.sdf.field);
+	delete s.convex;
+	s.mesh = CachedMesh();
+	s.sdf = CachedField();
+	s.convex = NULL;
+}
+
+bool NvFlexHCollisionData::removeShape(NvFlexHShapeHandle handle) {
+	// buffers must be mapped!
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return false;
+	const int id = s->dense;
+	releaseCached(*s);
+	keymap.erase(s->key);
+	if (densedirty[id])--_dirtyCount;
+
+	//swap the last shape into the hole
+	const int last = colgeovec.size() - 1;
+	if (id != last) {
+		colgeovec[id] = colgeovec[last];
+		positionvec[id] = positionvec[last];
+		rotationvec[id] = rotationvec[last];
+		prevpositionvec[id] = prevpositionvec[last];
+		prevrotationvec[id] = prevrotationvec[last];
+		flagvec[id] = flagvec[last];
+		denseslots[id] = denseslots[last];
+		densedirty[id] = densedirty[last];
+		slots[denseslots[id]].dense = id;
+	}
+	denseslots.pop_back();
+	densedirty.pop_back();
+	resizeall(last);
+
+	s->dense = -1;
+	++s->generation;
+	s->key = -1;
+	s->triangles = ColliderTriangles();
+	freeslots.push_back(handleSlot(handle));
+	_setChanged = true;
 	return true;
 }
 
-NvfSphereGeo NvFlexHCollisionData::getSphere(const std::string &key) const {
+NvFlexHShapeHandle NvFlexHCollisionData::addSphere(int64 key) {
+	return addShape(key, NvFlexMakeShapeFlags(eNvFlexShapeSphere, true));
+}
+
+NvfSphereGeo NvFlexHCollisionData::getSphere(NvFlexHShapeHandle handle) const {
 	// buffers must be mapped!
-	if (!hasKey(key))return NvfSphereGeo();
-	const int offset = collmap.at(key);
+	const ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return NvfSphereGeo();
+	const int offset = s->dense;
 	return NvfSphereGeo((NvFlexSphereGeometry*)(colgeovec.mappedPtr + offset), positionvec.mappedPtr + offset, rotationvec.mappedPtr + offset, prevpositionvec.mappedPtr + offset, prevrotationvec.mappedPtr + offset);
 }
 
-bool NvFlexHCollisionData::addTriangleMesh(const std::string &key) {
-	// buffers must be mapped!
-	if (hasKey(key))return false;
-	int oldsize = colgeovec.size();
-	collmap[key] = oldsize;
-	hashmap[key] = -2;
-	resizeall(oldsize + 1);
-	int nid = colgeovec.size() - 1;
-	flagvec[nid] = NvFlexMakeShapeFlags(eNvFlexShapeTriangleMesh, true);
+NvFlexHShapeHandle NvFlexHCollisionData::addTriangleMesh(int64 key) {
+	NvFlexHShapeHandle handle = addShape(key, NvFlexMakeShapeFlags(eNvFlexShapeTriangleMesh, true));
+	if (handle == NVFLEXH_INVALID_SHAPE)return handle;
+	const int nid = slotOf(handle)->dense;
 	colgeovec[nid].triMesh.scale[0] = 1.0f;
 	colgeovec[nid].triMesh.scale[1] = 1.0f;
 	colgeovec[nid].triMesh.scale[2] = 1.0f;
-	rotationvec[nid] = Quat();
-	prevrotationvec[nid] = Quat();
-	positionvec[nid] = Vec4(0, 0, 0, 1);
-	prevpositionvec[nid] = Vec4(0, 0, 0, 1);
-	NvFlexHTriangleMesh* newmesh = new NvFlexHTriangleMesh(colgeovec.lib);
-	NvFlexTriangleMeshId meshid = newmesh->getId();
-	meshmap[meshid] = newmesh;
-	colgeovec[nid].triMesh.mesh = meshid;
+	colgeovec[nid].triMesh.mesh = 0; //set with setTriangleMesh
+	return handle;
+}
+
+bool NvFlexHCollisionData::setTriangleMesh(NvFlexHShapeHandle handle, uint64 contentHash, const Vec3* verts, const int* tris, int vertcount, int triscount, const float* lower, const float* upper, bool sameTriangles) {
+	// buffers must be mapped!
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return false;
+	if (s->mesh.mesh != NULL && s->mesh.hash == contentHash)return false;
+
+	NvFlexHTriangleMeshCache &cache = NvFlexHTriangleMeshCache::instance();
+	setDenseDirty(s->dense);
+	if (sameTriangles && s->mesh.mesh != NULL) {
+		NvFlexHTriangleMesh* mesh = cache.updateVertices(s->mesh.hash, s->mesh.mesh, contentHash, verts, vertcount, lower, upper);
+		if (mesh != NULL) {
+			s->mesh.hash = contentHash;
+			_bytesUp += int64(vertcount) * sizeof(Vec3);
+			return true;
+		}
+	}
+
+	bool missed = false;
+	NvFlexHTriangleMesh* mesh = cache.acquire(colgeovec.lib, contentHash, verts, tris, vertcount, triscount, lower, upper, &missed);
+	if (missed)_bytesUp += int64(vertcount) * sizeof(Vec3) + int64(triscount) * 3 * sizeof(int);
+	if (s->mesh.mesh != NULL)cache.release(s->mesh.hash, s->mesh.mesh);
+	s->mesh.hash = contentHash;
+	s->mesh.mesh = mesh;
+	colgeovec[s->dense].triMesh.mesh = mesh->getId();
+	return true;
+}
+
+NvfTrimeshGeo NvFlexHCollisionData::getTriangleMesh(NvFlexHShapeHandle handle) const {
+	// buffers must be mapped!
+	const ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return NvfTrimeshGeo();
+	const int offset = s->dense;
+	return NvfTrimeshGeo(s->mesh.mesh, positionvec.mappedPtr + offset, rotationvec.mappedPtr + offset, prevpositionvec.mappedPtr + offset, prevrotationvec.mappedPtr + offset);
+}
+
+NvFlexHCollisionData::ColliderTriangles& NvFlexHCollisionData::colliderTriangles(NvFlexHShapeHandle handle) {
+	return slotOf(handle)->triangles;
+}
+
+NvFlexHShapeHandle NvFlexHCollisionData::addAnalyticShape(int64 key, NvFlexCollisionShapeType type) {
+	if (type != eNvFlexShapeSphere && type != eNvFlexShapeCapsule && type != eNvFlexShapeBox)return NVFLEXH_INVALID_SHAPE;
+	return addShape(key, NvFlexMakeShapeFlags(type, true));
+}
+
+bool NvFlexHCollisionData::setAnalyticGeometry(NvFlexHShapeHandle handle, const NvFlexCollisionGeometry &geometry, const Vec3 &localPosition, const Quat &localRotation) {
+	// buffers must be mapped!
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return false;
+	return setLocalGeometry(s, geometry, localPosition, localRotation);
+}
+
+bool NvFlexHCollisionData::setLocalGeometry(ShapeSlot *s, const NvFlexCollisionGeometry &geometry, const Vec3 &localPosition, const Quat &localRotation) {
+	const int id = s->dense;
+	if (memcmp(&colgeovec[id], &geometry, sizeof(NvFlexCollisionGeometry)) == 0 &&
+		memcmp(&s->localPosition, &localPosition, sizeof(Vec3)) == 0 && memcmp(&s->localRotation, &localRotation, sizeof(Quat)) == 0)return false;
+	colgeovec[id] = geometry;
+	s->localPosition = localPosition;
+	s->localRotation = localRotation;
+	setDenseDirty(id);
+	return true;
+}
+
+NvFlexHShapeHandle NvFlexHCollisionData::addDistanceField(int64 key) {
+	NvFlexHShapeHandle handle = addShape(key, NvFlexMakeShapeFlags(eNvFlexShapeSDF, true));
+	if (handle == NVFLEXH_INVALID_SHAPE)return handle;
+	const int nid = slotOf(handle)->dense;
+	colgeovec[nid].sdf.scale = 1.0f;
+	colgeovec[nid].sdf.field = 0; //set with setDistanceField
+	return handle;
+}
+
+bool NvFlexHCollisionData::hasDistanceField(NvFlexHShapeHandle handle, uint64 hash) const {
+	const ShapeSlot *s = slotOf(handle);
+	return s != NULL && s->sdf.field != NULL && s->sdf.hash == hash;
+}
+
+bool NvFlexHCollisionData::setDistanceField(NvFlexHShapeHandle handle, uint64 hash, const float* field, int dim, const Vec3 &localPosition, float scale) {
+	// buffers must be mapped!
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return false;
+	if (s->sdf.field == NULL || s->sdf.hash != hash) {
+		NvFlexHDistanceFieldCache &cache = NvFlexHDistanceFieldCache::instance();
+		bool missed = false;
+		NvFlexHDistanceField* sdf = cache.acquire(colgeovec.lib, hash, field, dim, &missed);
+		if (sdf == NULL)return false;
+		if (missed)_bytesUp += int64(dim)*dim*dim * sizeof(float);
+		if (s->sdf.field != NULL)cache.release(s->sdf.hash, s->sdf.field);
+		s->sdf.hash = hash;
+		s->sdf.field = sdf;
+	}
+	NvFlexCollisionGeometry geo;
+	memset(&geo, 0, sizeof(NvFlexCollisionGeometry));
+	geo.sdf.scale = scale;
+	geo.sdf.field = s->sdf.field->getId();
+	setLocalGeometry(s, geo, localPosition, Quat());
 	return true;
 }
 
-NvfTrimeshGeo NvFlexHCollisionData::getTriangleMesh(const std::string &key) const {
+NvFlexHShapeHandle NvFlexHCollisionData::addConvexMesh(int64 key) {
+	NvFlexHShapeHandle handle = addShape(key, NvFlexMakeShapeFlags(eNvFlexShapeConvexMesh, true));
+	if (handle == NVFLEXH_INVALID_SHAPE)return handle;
+	const int nid = slotOf(handle)->dense;
+	colgeovec[nid].convexMesh.scale[0] = 1.0f;
+	colgeovec[nid].convexMesh.scale[1] = 1.0f;
+	colgeovec[nid].convexMesh.scale[2] = 1.0f;
+	colgeovec[nid].convexMesh.mesh = 0; //set with setConvexMesh
+	return handle;
+}
+
+bool NvFlexHCollisionData::setConvexMesh(NvFlexHShapeHandle handle, const Vec4* planes, int planecount, const float* lower, const float* upper) {
 	// buffers must be mapped!
-	if (!hasKey(key))return NvfTrimeshGeo();
-	const int offset = collmap.at(key);
-	NvFlexTriangleMeshId mid = colgeovec[offset].triMesh.mesh;
-	return NvfTrimeshGeo(meshmap.at(mid), positionvec.mappedPtr + offset, rotationvec.mappedPtr + offset, prevpositionvec.mappedPtr + offset, prevrotationvec.mappedPtr + offset);
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return false;
+	if (s->convex == NULL)s->convex = new NvFlexHConvexMesh(colgeovec.lib);
+	s->convex->loadData(planes, planecount, lower, upper);
+	_bytesUp += int64(planecount) * sizeof(Vec4);
+	colgeovec[s->dense].convexMesh.mesh = s->convex->getId();
+	setDenseDirty(s->dense);
+	return true;
 }
 
+int NvFlexHCollisionData::getShapeType(NvFlexHShapeHandle handle) const {
+	const ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return -1;
+	return flagvec.mappedPtr[s->dense] & eNvFlexShapeFlagTypeMask;
+}
+
+void NvFlexHCollisionData::setTransform(NvFlexHShapeHandle handle, const Vec4 &objposition, const Quat &objrotation) {
+	// buffers must be mapped!
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return;
+	const int id = s->dense;
+	const Vec3 offset = Rotate(objrotation, s->localPosition);
+	const Vec4 position(objposition.x + offset.x, objposition.y + offset.y, objposition.z + offset.z, objposition.w);
+	const Quat rotation = objrotation*s->localRotation;
+	//a shape that stopped has to be pushed once more with prev == current, or flex keeps its last velocity
+	const bool moved = memcmp(&positionvec[id], &position, sizeof(Vec4)) != 0 || memcmp(&rotationvec[id], &rotation, sizeof(Quat)) != 0 ||
+		memcmp(&prevpositionvec[id], &positionvec[id], sizeof(Vec4)) != 0 || memcmp(&prevrotationvec[id], &rotationvec[id], sizeof(Quat)) != 0;
+	if (!moved)return;
+	prevpositionvec[id] = positionvec[id];
+	prevrotationvec[id] = rotationvec[id];
+	positionvec[id] = position;
+	rotationvec[id] = rotation;
+	setDenseDirty(id);
+}
+
+void NvFlexHCollisionData::markDirty(NvFlexHShapeHandle handle) {
+	const ShapeSlot *s = slotOf(handle);
+	if (s != NULL)setDenseDirty(s->dense);
+}
+
+void NvFlexHCollisionData::touch(NvFlexHShapeHandle handle) {
+	ShapeSlot *s = slotOf(handle);
+	if (s != NULL)s->lastTouched = _step;
+}
+
+int NvFlexHCollisionData::collectStale(int gracePeriod) {
+	// buffers must be mapped!
+	std::vector<NvFlexHShapeHandle> stale;
+	for (int slot = 0; slot < int(slots.size()); ++slot) {
+		const ShapeSlot &s = slots[slot];
+		if (s.dense >= 0 && _step - s.lastTouched > gracePeriod)stale.push_back(makeHandle(slot, s.generation));
+	}
+	for (NvFlexHShapeHandle handle : stale)removeShape(handle);
+	return int(stale.size());
+}
 
 int NvFlexHCollisionData::size() const {
 	return colgeovec.size();
 }
 
-int64 NvFlexHCollisionData::getStoredHash(const std::string &key) {
-	if (!hasKey(key))return -2;
-	return hashmap.at(key);
+int64 NvFlexHCollisionData::getStoredHash(NvFlexHShapeHandle handle) const {
+	const ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return -2;
+	return s->storedHash;
 }
 
-bool NvFlexHCollisionData::setStoredHash(const std::string &key, const int64 hash) {
-	if (!hasKey(key))return false;
-	hashmap[key] = hash;
+bool NvFlexHCollisionData::setStoredHash(NvFlexHShapeHandle handle, const int64 hash) {
+	ShapeSlot *s = slotOf(handle);
+	if (s == NULL)return false;
+	s->storedHash = hash;
 	return true;
 }
 
@@ -119,8 +355,18 @@ void NvFlexHCollisionData::unmapall() {
 	flagvec.unmap();
 }
 
-void NvFlexHCollisionData::setCollisionData(NvFlexSolver * solv) {
+bool NvFlexHCollisionData::setCollisionData(NvFlexSolver * solv) {
+	if (!isDirty())return false;
 	NvFlexSetShapes(solv, colgeovec.buffer, positionvec.buffer, rotationvec.buffer, prevpositionvec.buffer, prevrotationvec.buffer, flagvec.buffer, flagvec.size());
+	_bytesUp += int64(flagvec.size()) * (sizeof(NvFlexCollisionGeometry) + 2 * sizeof(Vec4) + 2 * sizeof(Quat) + sizeof(int));
+	std::fill(densedirty.begin(), densedirty.end(), 0);
+	_dirtyCount = 0;
+	_setChanged = false;
+	return true;
+}
+
+exint NvFlexHCollisionData::getBufferAllocCount() const {
+	return colgeovec.getAllocCount() + positionvec.getAllocCount() + rotationvec.getAllocCount() + prevpositionvec.getAllocCount() + prevrotationvec.getAllocCount() + flagvec.getAllocCount();
 }
 
 void NvFlexHCollisionData::resizeall(int newsize) {
@@ -132,7 +378,7 @@ void NvFlexHCollisionData::resizeall(int newsize) {
 	flagvec.resize(newsize);
 }
 
-NvFlexHCollisionData::NvFlexHCollisionData(NvFlexLibrary *lib):colgeovec(lib), positionvec(lib), rotationvec(lib), prevpositionvec(lib), prevrotationvec(lib), flagvec(lib) {
+NvFlexHCollisionData::NvFlexHCollisionData(NvFlexLibrary *lib):_dirtyCount(0), _setChanged(false), _step(0), _bytesUp(0), colgeovec(lib), positionvec(lib), rotationvec(lib), prevpositionvec(lib), prevrotationvec(lib), flagvec(lib) {
 	colgeovec.resize(0);
 	positionvec.resize(0);
 	rotationvec.resize(0);
@@ -144,8 +390,8 @@ NvFlexHCollisionData::NvFlexHCollisionData(NvFlexLibrary *lib):colgeovec(lib), p
 
 
 NvFlexHCollisionData::~NvFlexHCollisionData() {
-	for (auto it = meshmap.begin(); it != meshmap.end(); ++it) {
-		delete it->second;
+	for (auto it = slots.begin(); it != slots.end(); ++it) {
+		if (it->dense >= 0)releaseCached(*it);
 	}
 
 	colgeovec.destroy(); //dont need to destroy them - destructor does that!
@@ -5,10 +5,13 @@
 #include <NvFlexExt.h>
 #include <../core/maths.h>
 
-#include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "NvFlexHVector.h"
 #include "NvFlexHTriangleMesh.h"
+#include "NvFlexHDistanceField.h"
+#include "NvFlexHConvexMesh.h"
 
 
 
@@ -45,6 +48,12 @@ public: //TOTHINK: do we want to keep everything exposed?
 typedef NvFlexHCollisionGeometryWrapper<NvFlexSphereGeometry> NvfSphereGeo;
 typedef NvFlexHCollisionGeometryWrapper<NvFlexHTriangleMesh> NvfTrimeshGeo;
 
+//slot index in low 32 bits, slot generation in high 32 bits, so handles of removed shapes never match reused slots
+typedef int64 NvFlexHShapeHandle;
+#define NVFLEXH_INVALID_SHAPE NvFlexHShapeHandle(-1)
+
+//collision shapes kept densely packed in flex shape buffers, addressed through stable integer handles
+//removal swaps the last shape into the hole, and buffers are sent to the solver only when something changed
 class NvFlexHCollisionData {
 public:
 	NvFlexHCollisionData(NvFlexLibrary*lib);
@@ -52,39 +61,122 @@ public:
 	NvFlexHCollisionData& operator=(const NvFlexHCollisionData&) = delete;
 	~NvFlexHCollisionData();
 
-
-	bool hasKey(const std::string &key) const;
-	int64 getStoredHash(const std::string &key);
-	bool setStoredHash(const std::string &key, const int64 hash);
-	//add-remove shit
-	bool removeItem(const std::string &key);
-
-	bool addSphere(const std::string &key);
-	NvfSphereGeo getSphere(const std::string &key) const;
-
-	bool addTriangleMesh(const std::string &key);
-	NvfTrimeshGeo getTriangleMesh(const std::string &key) const;
+	//host side triangulation of a collider, kept until collider's topology data id changes
+	struct ColliderTriangles {
+		int64 topologyId;
+		uint64 hash;
+		std::vector<int> indices;
+		uint64 bakedHash; //content hash of the last sdf bake of these triangles, 0 - never baked
+		ColliderTriangles() :topologyId(-1), hash(0), bakedHash(0) {}
+	};
+
+	NvFlexHShapeHandle findShape(int64 key) const; //key is whatever caller identifies colliders with, object id for now
+	bool isValid(NvFlexHShapeHandle handle) const;
+	int64 getStoredHash(NvFlexHShapeHandle handle) const;
+	bool setStoredHash(NvFlexHShapeHandle handle, const int64 hash);
+	//add-remove shit. buffers must be mapped
+	bool removeShape(NvFlexHShapeHandle handle);
+
+	NvFlexHShapeHandle addSphere(int64 key);
+	NvfSphereGeo getSphere(NvFlexHShapeHandle handle) const;
+
+	NvFlexHShapeHandle addTriangleMesh(int64 key);
+	//points the shape to a cached mesh with given content, mesh is built and uploaded only if no one has it yet. returns false if the shape already had this content
+	//sameTriangles tells that only vertices moved since last set, then a mesh nobody else uses is just refreshed in place
+	bool setTriangleMesh(NvFlexHShapeHandle handle, uint64 contentHash, const Vec3* verts, const int* tris, int vertcount, int triscount, const float* lower, const float* upper, bool sameTriangles = false);
+	NvfTrimeshGeo getTriangleMesh(NvFlexHShapeHandle handle) const;
+	ColliderTriangles& colliderTriangles(NvFlexHShapeHandle handle);
+
+	//sphere, capsule and box shapes fitted to collider geometry. local transform places the shape inside the collider's space
+	NvFlexHShapeHandle addAnalyticShape(int64 key, NvFlexCollisionShapeType type);
+	bool setAnalyticGeometry(NvFlexHShapeHandle handle, const NvFlexCollisionGeometry &geometry, const Vec3 &localPosition, const Quat &localRotation); //returns false if nothing changed
+	int getShapeType(NvFlexHShapeHandle handle) const; //NvFlexCollisionShapeType, -1 for invalid handles. buffers must be mapped
+
+	//signed distance field shapes, fields are shared library wide through NvFlexHDistanceFieldCache
+	NvFlexHShapeHandle addDistanceField(int64 key);
+	bool hasDistanceField(NvFlexHShapeHandle handle, uint64 hash) const;
+	//field can be NULL to take it from the cache only, then false is returned if it's not there and the caller has to bake it
+	//localPosition is the field cube's lower corner in collider space, scale is its edge length
+	bool setDistanceField(NvFlexHShapeHandle handle, uint64 hash, const float* field, int dim, const Vec3 &localPosition, float scale);
+
+	//convex shapes, each owns its planes, so moving debris just reloads them into the same flex convex
+	NvFlexHShapeHandle addConvexMesh(int64 key);
+	bool setConvexMesh(NvFlexHShapeHandle handle, const Vec4* planes, int planecount, const float* lower, const float* upper);
+
+	//moves shape, previous transform is taken from the current one. shape is marked dirty only if anything actually moves
+	//position and rotation are the collider's, shape's local transform is applied on top
+	void setTransform(NvFlexHShapeHandle handle, const Vec4 &position, const Quat &rotation);
+	void markDirty(NvFlexHShapeHandle handle); //for changes done directly through geometry wrappers
+	bool isDirty() const { return _setChanged || _dirtyCount > 0; }
+	void markAllDirty() { _setChanged = true; } //next setCollisionData pushes the whole set, e.g. to a new solver
+
+	//garbage collection by step generations: every shape still in use has to be touched each step
+	//shapes not touched for more than gracePeriod steps are removed, their meshes go away with the last reference in mesh cache
+	void beginStep() { ++_step; }
+	void touch(NvFlexHShapeHandle handle);
+	int collectStale(int gracePeriod); //buffers must be mapped. returns number of removed shapes
 	//
 	int size() const;
 
 	void mapall();
 	void unmapall();
 
-	void setCollisionData(NvFlexSolver* solv);
+	//pushes shapes only if set or any transform changed since the last push. returns true if pushed
+	bool setCollisionData(NvFlexSolver* solv);
+	int64 getUploadedBytes() const { return _bytesUp; } //shape buffers and meshes, sdfs and convexes this data had to upload
+	exint getBufferAllocCount() const; //times shape buffers had to be reallocated
 
 private:
-	std::unordered_map<std::string, int> collmap; //offset into colgeovec
-	std::unordered_map<NvFlexTriangleMeshId, NvFlexHTriangleMesh*> meshmap;
-	std::unordered_map<std::string, int64> hashmap;
+	struct CachedMesh {
+		uint64 hash;
+		NvFlexHTriangleMesh* mesh; //owned by NvFlexHTriangleMeshCache
+		CachedMesh() :hash(0), mesh(NULL) {}
+	};
+	struct CachedField {
+		uint64 hash;
+		NvFlexHDistanceField* field; //owned by NvFlexHDistanceFieldCache
+		CachedField() :hash(0), field(NULL) {}
+	};
+	struct ShapeSlot {
+		int dense; //index in flex buffers, -1 for free slots
+		uint32 generation;
+		int64 key;
+		int64 storedHash;
+		int64 lastTouched; //step generation
+		CachedMesh mesh;
+		CachedField sdf;
+		NvFlexHConvexMesh* convex; //owned
+		ColliderTriangles triangles;
+		Vec3 localPosition;
+		Quat localRotation;
+		ShapeSlot() :dense(-1), generation(0), key(-1), storedHash(-2), lastTouched(0), convex(NULL) {}
+	};
+
+	ShapeSlot* slotOf(NvFlexHShapeHandle handle);
+	const ShapeSlot* slotOf(NvFlexHShapeHandle handle) const;
+	NvFlexHShapeHandle addShape(int64 key, int flags);
+	bool setLocalGeometry(ShapeSlot *s, const NvFlexCollisionGeometry &geometry, const Vec3 &localPosition, const Quat &localRotation);
+	void releaseCached(ShapeSlot &s);
+	void setDenseDirty(int dense);
+
+	std::vector<ShapeSlot> slots;
+	std::vector<int> freeslots;
+	std::vector<int> denseslots; //dense index -> slot index
+	std::vector<char> densedirty;
+	std::unordered_map<int64, NvFlexHShapeHandle> keymap;
+	int _dirtyCount;
+	bool _setChanged;
+	int64 _step;
+	int64 _bytesUp;
 
 	void resizeall(int newsize);
 
 private:
-	NvFlexVector<NvFlexCollisionGeometry> colgeovec;
-	NvFlexVector<Vec4> positionvec;
-	NvFlexVector<Quat> rotationvec;
-	NvFlexVector<Vec4> prevpositionvec;
-	NvFlexVector<Quat> prevrotationvec;
-	NvFlexVector<int>  flagvec;
+	NvFlexHVector<NvFlexCollisionGeometry> colgeovec;
+	NvFlexHVector<Vec4> positionvec;
+	NvFlexHVector<Quat> rotationvec;
+	NvFlexHVector<Vec4> prevpositionvec;
+	NvFlexHVector<Quat> prevrotationvec;
+	NvFlexHVector<int>  flagvec;
 
 };
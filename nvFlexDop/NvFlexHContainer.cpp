@@ -0,0 +1,543 @@
+#include <algorithm>
+#include <climits>
+
+#include "NvFlexHContainer.h"
+
+
+void NvFlexHContainer::clear() {
+	setRanges(std::vector<int>(1, _maxParticles)); //frees every particle
+	pushParticlesToDevice(NVFLEXH_CHANNEL_NONE); //just the now empty active list
+	NvFlexSetParams(_slv, &_defaultParams);
+
+	resizeSpringData(0);
+	resizeTriangleData(0);
+	resizeRigidData(0, std::vector<int>());
+	pushSpringsToDevice();
+	pushTrianglesToDevice(false);
+	pushRigidsToDevice();
+
+	_colld->mapall();
+	_colld->collectStale(-1); //every shape is older than that
+	_colld->unmapall();
+	_colld->setCollisionData(_slv);
+}
+
+//state blob. bump the version on any layout change, older blobs are refused rather than misread
+#define NVFLEXH_STATE_MAGIC 0x4846564e //NVFH
+#define NVFLEXH_STATE_VERSION 1
+
+namespace {
+	struct StateWriter {
+		std::vector<char> &out;
+		explicit StateWriter(std::vector<char> &o) :out(o) {}
+		void bytes(const void *data, size_t size) {
+			if (size == 0)return;
+			const size_t at = out.size();
+			out.resize(at + size);
+			memcpy(out.data() + at, data, size);
+		}
+		void i32(int v) { bytes(&v, sizeof(v)); }
+	};
+
+	struct StateReader {
+		const char *data;
+		size_t size;
+		size_t at;
+		StateReader(const char *d, size_t s) :data(d), size(s), at(0) {}
+		void bytes(void *dst, size_t n) {
+			if (n > size - at)throw std::runtime_error("nvflex state is truncated");
+			if (n > 0)memcpy(dst, data + at, n);
+			at += n;
+		}
+		int i32() { int v; bytes(&v, sizeof(v)); return v; }
+		std::vector<char> block(size_t n) { //checked before allocating, so a bad count can't ask for gigabytes
+			if (n > size - at)throw std::runtime_error("nvflex state is truncated");
+			std::vector<char> out(n);
+			bytes(out.data(), n);
+			return out;
+		}
+		int count(int max) { //element count that must fit into [0, max]
+			const int v = i32();
+			if (v < 0 || v > max)throw std::runtime_error("nvflex state has a bad element count");
+			return v;
+		}
+	};
+
+	//header up to container sizes, shared by load and readStateSizes
+	void readStateHeader(StateReader &in, int &maxParticles, int &maxDiffuseParticles, int &maxNeighbours) {
+		if (uint32(in.i32()) != NVFLEXH_STATE_MAGIC)throw std::runtime_error("not an nvflex state");
+		if (in.i32() != NVFLEXH_STATE_VERSION)throw std::runtime_error("unsupported nvflex state version");
+		if (in.i32() != int(sizeof(NvFlexParams)))throw std::runtime_error("nvflex state was saved with different flex params");
+		maxParticles = in.i32();
+		maxDiffuseParticles = in.i32();
+		maxNeighbours = in.i32();
+	}
+}
+
+void NvFlexHContainer::saveState(std::vector<char> &out) {
+	//host copies only have channels the output reads back
+	pullParticlesFromDevice(NVFLEXH_CHANNEL_ALL);
+	if (getRigidCount() > 0)pullRigidsFromDevice();
+	NvFlexParams params;
+	NvFlexGetParams(_slv, &params);
+
+	StateWriter w(out);
+	w.i32(int(NVFLEXH_STATE_MAGIC));
+	w.i32(NVFLEXH_STATE_VERSION);
+	w.i32(int(sizeof(NvFlexParams)));
+	w.i32(_maxParticles);
+	w.i32(_maxDiffuseParticles);
+	w.i32(_maxNeighbours);
+	w.bytes(&params, sizeof(params));
+
+	//free lists as they are, so particles allocated after a restart get the same ids. runs of descending ids are stored as (first, length)
+	w.i32(int(_ranges.size()));
+	for (size_t r = 0; r < _ranges.size(); ++r) {
+		const std::vector<int> &freeList = _ranges[r].freeList;
+		std::vector<int> runs;
+		for (size_t i = 0; i < freeList.size(); ++i) {
+			if (!runs.empty() && freeList[i] == runs[runs.size() - 2] - runs.back())++runs.back();
+			else {
+				runs.push_back(freeList[i]);
+				runs.push_back(1);
+			}
+		}
+		w.i32(_ranges[r].size);
+		w.i32(int(runs.size() / 2));
+		w.bytes(runs.data(), runs.size() * sizeof(int));
+	}
+
+	const int n = getActiveRange();
+	w.i32(n);
+	_particles.map();
+	_restParticles.map();
+	_velocities.map();
+	_phases.map();
+	w.bytes(_particles.mappedPtr, n * sizeof(Vec4));
+	w.bytes(_restParticles.mappedPtr, n * sizeof(Vec4));
+	w.bytes(_velocities.mappedPtr, n * sizeof(Vec3));
+	w.bytes(_phases.mappedPtr, n * sizeof(int));
+	_particles.unmap();
+	_restParticles.unmap();
+	_velocities.unmap();
+	_phases.unmap();
+
+	const int springs = getSpringsCount();
+	w.i32(springs);
+	NvFlexHSpringData sprdat = mapSpringData();
+	w.bytes(sprdat.springIds, springs * 2 * sizeof(int));
+	w.bytes(sprdat.springRls, springs * sizeof(float));
+	w.bytes(sprdat.springSts, springs * sizeof(float));
+	unmapSpringData();
+
+	const int triangles = getTrianglesCount();
+	w.i32(triangles);
+	w.i32(_triangleNormalsPushed ? 1 : 0);
+	NvFlexHTriangleData tridat = mapTriangleData();
+	w.bytes(tridat.triangleIds, triangles * 3 * sizeof(int));
+	if (_triangleNormalsPushed)w.bytes(tridat.triangleNms, triangles * 3 * sizeof(float));
+	unmapTriangleData();
+
+	const int rigids = getRigidCount();
+	const int rigidIndices = getRigidIndicesCount();
+	w.i32(rigids);
+	w.i32(rigidIndices);
+	if (rigids > 0) {
+		NvFlexHRigidData rgddat = mapRigidData();
+		w.bytes(rgddat.offsets, (rigids + 1) * sizeof(int));
+		w.bytes(rgddat.indices, rigidIndices * sizeof(int));
+		w.bytes(rgddat.restPositions, rigidIndices * 3 * sizeof(float));
+		w.bytes(rgddat.restNormals, rigidIndices * 4 * sizeof(float));
+		w.bytes(rgddat.stiffness, rigids * sizeof(float));
+		w.bytes(rgddat.rotations, rigids * 4 * sizeof(float));
+		w.bytes(rgddat.translations, rigids * 3 * sizeof(float));
+		unmapRigidData();
+	}
+}
+
+bool NvFlexHContainer::readStateSizes(const char *data, size_t size, int &maxParticles, int &maxDiffuseParticles, int &maxNeighbours) {
+	try {
+		StateReader in(data, size);
+		readStateHeader(in, maxParticles, maxDiffuseParticles, maxNeighbours);
+	}
+	catch (std::runtime_error &) {
+		return false;
+	}
+	return true;
+}
+
+void NvFlexHContainer::loadState(const char *data, size_t size) {
+	StateReader in(data, size);
+	int maxParticles, maxDiffuseParticles, maxNeighbours;
+	readStateHeader(in, maxParticles, maxDiffuseParticles, maxNeighbours);
+	if (maxParticles != _maxParticles || maxDiffuseParticles != _maxDiffuseParticles || maxNeighbours != _maxNeighbours)throw std::runtime_error("nvflex state is of a container of different size");
+	NvFlexParams params;
+	in.bytes(&params, sizeof(params));
+
+	//everything is read and checked before the container is touched
+	const int rangeCount = in.count(_maxParticles);
+	std::vector<ParticleRange> ranges(rangeCount);
+	std::vector<char> freed(_maxParticles, 0); //runs must not overlap, or allocs would give the same id twice
+	int start = 0;
+	int freeCount = 0;
+	for (int r = 0; r < rangeCount; ++r) {
+		ParticleRange &range = ranges[r];
+		range.start = start;
+		range.size = in.count(_maxParticles - start);
+		range.version = 0;
+		const int runCount = in.count(range.size);
+		for (int i = 0; i < runCount; ++i) {
+			const int first = in.i32();
+			const int length = in.i32();
+			if (length < 0 || length > range.size - int(range.freeList.size()) || first >= range.start + range.size || first - length + 1 < range.start)throw std::runtime_error("nvflex state has a bad free list");
+			for (int id = first; id > first - length; --id) {
+				if (freed[id])throw std::runtime_error("nvflex state has a particle freed twice");
+				freed[id] = 1;
+				range.freeList.push_back(id);
+			}
+		}
+		start += range.size;
+		freeCount += int(range.freeList.size());
+	}
+	if (start != _maxParticles)throw std::runtime_error("nvflex state ranges do not cover the container");
+
+	const int n = in.count(_maxParticles);
+	const std::vector<char> channels = in.block(size_t(n) * (2 * sizeof(Vec4) + sizeof(Vec3) + sizeof(int)));
+
+	const int springs = in.count(INT_MAX / 2);
+	const std::vector<char> springData = in.block(size_t(springs) * (2 * sizeof(int) + 2 * sizeof(float)));
+
+	const int triangles = in.count(INT_MAX / 3);
+	const bool triangleNormals = in.i32() != 0;
+	const std::vector<char> triangleData = in.block(size_t(triangles) * 3 * (sizeof(int) + (triangleNormals ? sizeof(float) : 0)));
+
+	const int rigids = in.count(INT_MAX / 4);
+	const int rigidIndices = in.count(INT_MAX / 4);
+	const std::vector<char> offsetData = in.block(rigids > 0 ? size_t(rigids + 1) * sizeof(int) : 0);
+	const int *rigidOffsets = (const int*)offsetData.data();
+	const std::vector<char> rigidData = in.block(rigids > 0 ? size_t(rigidIndices) * (sizeof(int) + 7 * sizeof(float)) + size_t(rigids) * 8 * sizeof(float) : 0);
+	std::vector<int> rigidSizes(rigids);
+	for (int r = 0; r < rigids; ++r) {
+		rigidSizes[r] = rigidOffsets[r + 1] - rigidOffsets[r];
+		if (rigidSizes[r] < 0)throw std::runtime_error("nvflex state has bad rigid offsets");
+	}
+	if (rigids > 0 && (rigidOffsets[0] != 0 || rigidOffsets[rigids] != rigidIndices))throw std::runtime_error("nvflex state has bad rigid offsets");
+
+	clear(); //no shapes, and a fresh start for everything below
+	NvFlexSetParams(_slv, &params);
+
+	for (int r = 0; r < rangeCount; ++r)ranges[r].version = _activeVersion + 1; //indices of whoever used the old ranges go stale
+	_ranges.swap(ranges);
+	_freeCount = freeCount;
+	_activeDirty = true;
+	_activeRangeDirty = true;
+	++_activeVersion;
+
+	const char *src = channels.data();
+	_particles.map();
+	_restParticles.map();
+	_velocities.map();
+	_phases.map();
+	memcpy(_particles.mappedPtr, src, n * sizeof(Vec4));
+	src += n * sizeof(Vec4);
+	memcpy(_restParticles.mappedPtr, src, n * sizeof(Vec4));
+	src += n * sizeof(Vec4);
+	memcpy(_velocities.mappedPtr, src, n * sizeof(Vec3));
+	src += n * sizeof(Vec3);
+	memcpy(_phases.mappedPtr, src, n * sizeof(int));
+	_particles.unmap();
+	_restParticles.unmap();
+	_velocities.unmap();
+	_phases.unmap();
+	pushParticlesToDevice(NVFLEXH_CHANNEL_ALL);
+
+	resizeSpringData(springs);
+	NvFlexHSpringData sprdat = mapSpringData();
+	src = springData.data();
+	memcpy(sprdat.springIds, src, springs * 2 * sizeof(int));
+	src += springs * 2 * sizeof(int);
+	memcpy(sprdat.springRls, src, springs * sizeof(float));
+	src += springs * sizeof(float);
+	memcpy(sprdat.springSts, src, springs * sizeof(float));
+	unmapSpringData();
+	pushSpringsToDevice();
+
+	resizeTriangleData(triangles);
+	NvFlexHTriangleData tridat = mapTriangleData();
+	memcpy(tridat.triangleIds, triangleData.data(), triangles * 3 * sizeof(int));
+	if (triangleNormals)memcpy(tridat.triangleNms, triangleData.data() + triangles * 3 * sizeof(int), triangles * 3 * sizeof(float));
+	unmapTriangleData();
+	pushTrianglesToDevice(triangleNormals);
+
+	resizeRigidData(rigids, rigidSizes);
+	if (rigids > 0) {
+		NvFlexHRigidData rgddat = mapRigidData();
+		src = rigidData.data();
+		memcpy(rgddat.indices, src, rigidIndices * sizeof(int));
+		src += rigidIndices * sizeof(int);
+		memcpy(rgddat.restPositions, src, rigidIndices * 3 * sizeof(float));
+		src += rigidIndices * 3 * sizeof(float);
+		memcpy(rgddat.restNormals, src, rigidIndices * 4 * sizeof(float));
+		src += rigidIndices * 4 * sizeof(float);
+		memcpy(rgddat.stiffness, src, rigids * sizeof(float));
+		src += rigids * sizeof(float);
+		memcpy(rgddat.rotations, src, rigids * 4 * sizeof(float));
+		src += rigids * 4 * sizeof(float);
+		memcpy(rgddat.translations, src, rigids * 3 * sizeof(float));
+		unmapRigidData();
+	}
+	pushRigidsToDevice();
+}
+
+//particles
+void NvFlexHContainer::setRanges(const std::vector<int> &sizes) {
+	_ranges.clear();
+	_ranges.reserve(sizes.size());
+	int start = 0;
+	for (size_t r = 0; r < sizes.size(); ++r) {
+		ParticleRange range;
+		range.start = start;
+		range.size = std::min(sizes[r], _maxParticles - start);
+		range.version = 0;
+		range.freeList.reserve(range.size);
+		for (int i = range.start + range.size - 1; i >= range.start; --i)range.freeList.push_back(i); //same order as NvFlexExt uses: lowest indices are given out first
+		start += range.size;
+		_ranges.push_back(std::move(range));
+	}
+	_freeCount = start;
+	if (start < _maxParticles)throw std::runtime_error("particle ranges do not cover the container");
+	_activeDirty = true;
+	_activeRangeDirty = true;
+	++_activeVersion;
+}
+
+//moves particle data of every range up by its shift, highest range first so nothing is overwritten before it's moved
+template<typename T>
+static void moveRanges(NvFlexHVector<T> &vec, const std::vector<int> &starts, const std::vector<int> &sizes, const std::vector<int> &shifts, int newSize) {
+	vec.map();
+	vec.resize(newSize);
+	for (int r = int(starts.size()) - 1; r >= 0; --r) {
+		if (shifts[r] != 0)memmove(vec.mappedPtr + starts[r] + shifts[r], vec.mappedPtr + starts[r], sizeof(T)*sizes[r]);
+	}
+	vec.unmap();
+}
+
+void NvFlexHContainer::growRanges(const std::vector<int> &sizes) {
+	if (sizes.size() != _ranges.size())throw std::runtime_error("particle range count can't change when growing");
+	std::vector<int> starts(_ranges.size()), oldSizes(_ranges.size()), shifts(_ranges.size());
+	int newMax = 0;
+	for (size_t r = 0; r < _ranges.size(); ++r) {
+		if (sizes[r] < _ranges[r].size)throw std::runtime_error("particle ranges can only grow");
+		starts[r] = _ranges[r].start;
+		oldSizes[r] = _ranges[r].size;
+		shifts[r] = newMax - _ranges[r].start;
+		newMax += sizes[r];
+	}
+	if (newMax == _maxParticles)return;
+
+	NvFlexSolver *slv = NvFlexCreateSolver(_lib, newMax, _maxDiffuseParticles, _maxNeighbours);
+	if (slv == NULL)throw std::runtime_error("NULL NVFLEX SOLVER!");
+
+	//host copies only have channels the output reads back, so everything the old solver has is taken first
+	pullParticlesFromDevice(NVFLEXH_CHANNEL_ALL);
+	if (getRigidCount() > 0)pullRigidsFromDevice();
+	NvFlexParams params;
+	NvFlexGetParams(_slv, &params);
+	NvFlexSetParams(slv, &params);
+	NvFlexDestroySolver(_slv);
+	_slv = slv;
+
+	moveRanges(_particles, starts, oldSizes, shifts, newMax);
+	moveRanges(_restParticles, starts, oldSizes, shifts, newMax);
+	moveRanges(_velocities, starts, oldSizes, shifts, newMax);
+	moveRanges(_phases, starts, oldSizes, shifts, newMax);
+
+	//constraints keep pointing at the same particles
+	auto remap = [&](NvFlexHVector<int> &ids) {
+		ids.map();
+		for (int i = 0; i < ids.size(); ++i)ids[i] += shifts[rangeOf(ids[i])];
+		ids.unmap();
+	};
+	remap(_springIndices);
+	remap(_triangleIndices);
+	remap(_rgdIndices);
+
+	for (size_t r = 0; r < _ranges.size(); ++r) {
+		ParticleRange &range = _ranges[r];
+		//new slots are the highest ids of the range, so they go to the front of the free list
+		std::vector<int> freeList;
+		freeList.reserve(sizes[r]);
+		for (int i = starts[r] + shifts[r] + sizes[r] - 1; i >= starts[r] + shifts[r] + oldSizes[r]; --i)freeList.push_back(i);
+		for (size_t i = 0; i < range.freeList.size(); ++i)freeList.push_back(range.freeList[i] + shifts[r]);
+		range.freeList.swap(freeList);
+		range.start += shifts[r];
+		range.size = sizes[r];
+		//only ranges whose ids moved have a different active list, plans of the others stay valid
+		if (shifts[r] != 0)++range.version;
+	}
+	_freeCount += newMax - _maxParticles;
+	_maxParticles = newMax;
+	_activeDirty = true; //new solver needs the active list either way
+	_activeRangeDirty = true;
+	if (std::any_of(shifts.begin(), shifts.end(), [](int s) { return s != 0; }))++_activeVersion;
+
+	pushParticlesToDevice(NVFLEXH_CHANNEL_ALL);
+	pushSpringsToDevice();
+	pushTrianglesToDevice(_triangleNormalsPushed);
+	pushRigidsToDevice();
+	_colld->markAllDirty();
+	_colld->setCollisionData(_slv);
+}
+
+int NvFlexHContainer::rangeOf(int particle) const {
+	int lo = 0, hi = int(_ranges.size()) - 1;
+	while (lo < hi) {
+		const int mid = (lo + hi + 1) / 2;
+		if (_ranges[mid].start <= particle)lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
+
+int NvFlexHContainer::allocParticles(int n, int* indices, int range) {
+	std::vector<int> &freeList = _ranges[range].freeList;
+	const int numToAlloc = std::min(int(freeList.size()), n);
+	const int start = int(freeList.size()) - numToAlloc;
+	if (indices != NULL)memcpy(indices, freeList.data() + start, sizeof(int)*numToAlloc);
+	freeList.resize(start);
+	if (numToAlloc > 0) {
+		_freeCount -= numToAlloc;
+		_activeDirty = true;
+		_activeRangeDirty = true;
+		++_activeVersion;
+		++_ranges[range].version;
+	}
+	return numToAlloc;
+}
+
+void NvFlexHContainer::freeParticles(int n, const int* indices) {
+	for (int i = 0; i < n; ++i) {
+		ParticleRange &range = _ranges[rangeOf(indices[i])];
+		range.freeList.push_back(indices[i]);
+		++range.version;
+	}
+	if (n > 0) {
+		_freeCount += n;
+		_activeDirty = true;
+		_activeRangeDirty = true;
+		++_activeVersion;
+	}
+}
+
+int NvFlexHContainer::getActiveList(int* indices, int range) {
+	++_activeListFetches;
+	const int first = range < 0 ? 0 : _ranges[range].start;
+	const int last = range < 0 ? _maxParticles : first + _ranges[range].size;
+	std::vector<char> inactive(last - first, 0);
+	for (int r = (range < 0 ? 0 : range); r < (range < 0 ? int(_ranges.size()) : range + 1); ++r) {
+		const std::vector<int> &freeList = _ranges[r].freeList;
+		for (size_t i = 0; i < freeList.size(); ++i)inactive[freeList[i] - first] = 1;
+	}
+	int count = 0;
+	for (int i = first; i < last; ++i) {
+		if (!inactive[i - first])indices[count++] = i;
+	}
+	if (range < 0) {
+		_activeRange = count > 0 ? indices[count - 1] + 1 : 0;
+		_activeRangeDirty = false;
+	}
+	return count;
+}
+
+int NvFlexHContainer::getActiveRange() {
+	if (_activeRangeDirty) {
+		std::vector<char> inactive(_maxParticles, 0);
+		for (size_t r = 0; r < _ranges.size(); ++r) {
+			for (size_t i = 0; i < _ranges[r].freeList.size(); ++i)inactive[_ranges[r].freeList[i]] = 1;
+		}
+		_activeRange = _maxParticles;
+		while (_activeRange > 0 && inactive[_activeRange - 1])--_activeRange;
+		_activeRangeDirty = false;
+	}
+	return _activeRange;
+}
+
+NvFlexExtParticleData NvFlexHContainer::mapParticleData(int channels) {
+	if (channels & _staleChannels)pullParticlesFromDevice(channels & _staleChannels);
+	NvFlexExtParticleData pdat;
+	memset(&pdat, 0, sizeof(pdat));
+	if (channels & NVFLEXH_CHANNEL_PARTICLES) {
+		_particles.map();
+		pdat.particles = (float*)_particles.mappedPtr;
+	}
+	if (channels & NVFLEXH_CHANNEL_REST) {
+		_restParticles.map();
+		pdat.restParticles = (float*)_restParticles.mappedPtr;
+	}
+	if (channels & NVFLEXH_CHANNEL_VELOCITIES) {
+		_velocities.map();
+		pdat.velocities = (float*)_velocities.mappedPtr;
+	}
+	if (channels & NVFLEXH_CHANNEL_PHASES) {
+		_phases.map();
+		pdat.phases = _phases.mappedPtr;
+	}
+	_mappedChannels |= channels;
+	return pdat;
+}
+
+void NvFlexHContainer::unmapParticleData() {
+	if (_mappedChannels & NVFLEXH_CHANNEL_PARTICLES)_particles.unmap();
+	if (_mappedChannels & NVFLEXH_CHANNEL_REST)_restParticles.unmap();
+	if (_mappedChannels & NVFLEXH_CHANNEL_VELOCITIES)_velocities.unmap();
+	if (_mappedChannels & NVFLEXH_CHANNEL_PHASES)_phases.unmap();
+	_mappedChannels = NVFLEXH_CHANNEL_NONE;
+}
+
+void NvFlexHContainer::pushParticlesToDevice(int channels) {
+	// data must not be mapped!
+	if (channels & NVFLEXH_CHANNEL_PARTICLES)NvFlexSetParticles(_slv, _particles.buffer, _particles.size());
+	if (channels & NVFLEXH_CHANNEL_REST)NvFlexSetRestParticles(_slv, _restParticles.buffer, _restParticles.size());
+	if (channels & NVFLEXH_CHANNEL_VELOCITIES)NvFlexSetVelocities(_slv, _velocities.buffer, _velocities.size());
+	if (channels & NVFLEXH_CHANNEL_PHASES)NvFlexSetPhases(_slv, _phases.buffer, _phases.size());
+	_bytesUp += channelBytes(channels, _particles.size());
+	_staleChannels &= ~channels;
+	if (_activeDirty) {
+		_activeIndices.map();
+		_activeIndices.resize(getActiveCount());
+		getActiveList(_activeIndices.mappedPtr);
+		_activeIndices.unmap();
+		NvFlexSetActive(_slv, _activeIndices.buffer, _activeIndices.size());
+		_bytesUp += int64(_activeIndices.size()) * sizeof(int);
+		_activeDirty = false;
+	}
+}
+
+void NvFlexHContainer::pullParticlesFromDevice(int channels) {
+	//flex copies the first n elements, and particles are given out lowest ids first, so the active range is usually all there is
+	const int n = getActiveRange();
+	_staleChannels &= ~channels;
+	if (n == 0)return;
+	if (channels & NVFLEXH_CHANNEL_PARTICLES)NvFlexGetParticles(_slv, _particles.buffer, n);
+	if (channels & NVFLEXH_CHANNEL_REST)NvFlexGetRestParticles(_slv, _restParticles.buffer, n);
+	if (channels & NVFLEXH_CHANNEL_VELOCITIES)NvFlexGetVelocities(_slv, _velocities.buffer, n);
+	if (channels & NVFLEXH_CHANNEL_PHASES)NvFlexGetPhases(_slv, _phases.buffer, n);
+	_bytesDown += channelBytes(channels, n);
+}
+
+exint NvFlexHContainer::getBufferAllocCount() const {
+	return _particles.getAllocCount() + _restParticles.getAllocCount() + _velocities.getAllocCount() + _phases.getAllocCount() + _activeIndices.getAllocCount() +
+		_springIndices.getAllocCount() + _springRestLengths.getAllocCount() + _springStrenghts.getAllocCount() +
+		_triangleIndices.getAllocCount() + _triangleNormals.getAllocCount() +
+		_rgdOffsets.getAllocCount() + _rgdIndices.getAllocCount() + _rgdRestPositions.getAllocCount() + _rgdRestNormals.getAllocCount() +
+		_rgdStiffness.getAllocCount() + _rgdRotations.getAllocCount() + _rgdTranslations.getAllocCount() + _colld->getBufferAllocCount();
+}
+
+int64 NvFlexHContainer::channelBytes(int channels, int count) const {
+	int64 bytes = 0;
+	if (channels & NVFLEXH_CHANNEL_PARTICLES)bytes += int64(count) * sizeof(Vec4);
+	if (channels & NVFLEXH_CHANNEL_REST)bytes += int64(count) * sizeof(Vec4);
+	if (channels & NVFLEXH_CHANNEL_VELOCITIES)bytes += int64(count) * sizeof(Vec3);
+	if (channels & NVFLEXH_CHANNEL_PHASES)bytes += int64(count) * sizeof(int);
+	return bytes;
+}
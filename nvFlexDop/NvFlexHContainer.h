@@ -0,0 +1,349 @@
+#pragma once
+#include <string.h> //for memcpy in NvFlexExt.h
+#include <NvFlex.h>
+#include <NvFlexExt.h>
+#include <../core/maths.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "NvFlexHVector.h"
+#include "NvFlexHCollisionData.h"
+#include "NvFlexHParticleTransfer.h"
+
+//one flex solver with all its particle, constraint and collision buffers
+//knows nothing about houdini sim data, so it can be driven by the bench as well as by SIM_NvFlexData
+class NvFlexHContainer {
+public:
+	typedef struct NvFlexHSpringData {
+		int* const springIds;
+		float* const springRls;
+		float* const springSts;
+
+		NvFlexHSpringData(int*sid, float*srl, float*sts):springIds(sid),springRls(srl),springSts(sts) {}
+	} NvFlexHSpringData;
+
+	typedef struct NvFlexHTriangleData {
+		int* const triangleIds;
+		float* const triangleNms;
+
+		NvFlexHTriangleData(int*tid, float*tnm):triangleIds(tid),triangleNms(tnm) {}
+	} NvFlexHTriangleData;
+
+	typedef struct NvFlexHRigidData {
+		int* offsets; //numRigids+1
+		int* indices;
+		float* restPositions; //numRigids*3
+		float* restNormals; //numRigids*4 (normal.xyz;sdf)
+		float* stiffness; //numRigids
+		float* rotations; //numRigids*4 (quat)
+		float* translations;
+
+		NvFlexHRigidData(int*off, int*ind, float*rep, float*ren, float*stf, float*rot, float*trs) :offsets(off), indices(ind), restPositions(rep), restNormals(ren), stiffness(stf), rotations(rot), translations(trs) {};
+	} NvFlexRigidData;
+
+	typedef struct NvFlexHRigidTransData {
+		int rigidsCount;
+		float* rotations; //numRigids*4 (quat)
+		float* translations;
+		NvFlexHRigidTransData(float*trs, float*rot, int count) :translations(trs), rotations(rot), rigidsCount(count) {};
+	} NvFlexHRigidTransData;
+
+	explicit NvFlexHContainer(NvFlexLibrary*lib, int maxParticles, int MaxDiffuseParticles, int maxNeighbours = 96):_lib(lib), _maxDiffuseParticles(MaxDiffuseParticles), _maxNeighbours(maxNeighbours), _maxParticles(maxParticles), _freeCount(0), _activeDirty(true), _activeRangeDirty(true), _activeRange(0), _activeVersion(0), _activeListFetches(0), _stepCount(0), _bytesUp(0), _bytesDown(0), _triangleNormalsPushed(false), _mappedChannels(NVFLEXH_CHANNEL_NONE), _staleChannels(NVFLEXH_CHANNEL_NONE), _particles(lib), _restParticles(lib), _velocities(lib), _phases(lib), _activeIndices(lib), _springIndices(lib),_springRestLengths(lib),_springStrenghts(lib), _triangleIndices(lib),_triangleNormals(lib), _rgdOffsets(lib), _rgdIndices(lib), _rgdRestPositions(lib), _rgdRestNormals(lib), _rgdStiffness(lib), _rgdRotations(lib), _rgdTranslations(lib) {
+		_slv = NvFlexCreateSolver(lib, maxParticles, MaxDiffuseParticles, maxNeighbours);
+		if (_slv == NULL)throw std::runtime_error("NULL NVFLEX SOLVER!");
+		NvFlexGetParams(_slv, &_defaultParams);
+		//we keep particle channels ourselves instead of NvFlexExtContainer, so that each one can be pushed separately
+		_particles.resize(maxParticles);
+		_restParticles.resize(maxParticles);
+		_velocities.resize(maxParticles);
+		_phases.resize(maxParticles);
+		_activeIndices.resize(0);
+		_particles.unmap();
+		_restParticles.unmap();
+		_velocities.unmap();
+		_phases.unmap();
+		_activeIndices.unmap();
+		setRanges(std::vector<int>(1, maxParticles));
+		_colld = new NvFlexHCollisionData(lib);
+	}
+	NvFlexHContainer(NvFlexHContainer&) = delete;
+	~NvFlexHContainer() {
+		//NvFlexAcquireContext(SIM_NvFlexData::nvFlexLibrary);
+		//no aquire cuz we assume the destructor wrapper is responsible for that
+		NvFlexDestroySolver(_slv);
+		delete _colld;
+		//NvFlexRestoreContext(SIM_NvFlexData::nvFlexLibrary);
+	}
+
+	NvFlexSolver* solver() { return _slv; }
+	NvFlexHCollisionData* collisionData() { return _colld; }
+
+	//back to the state of a new container without making a new solver: no particles, constraints or shapes, default params
+	//nothing must be mapped
+	void clear();
+	int getMaxDiffuseParticles()const { return _maxDiffuseParticles; }
+
+	//checkpoints: particles of the active range, free lists, springs, triangles, rigids and params as a versioned binary blob
+	//collision shapes are not in it, they are made again from colliders on the next step. context must be acquired, nothing mapped
+	void saveState(std::vector<char> &out);
+	//container must be of the sizes the state was saved with, see readStateSizes. everything else is replaced. throws if state is malformed
+	void loadState(const char *data, size_t size);
+	static bool readStateSizes(const char *data, size_t size, int &maxParticles, int &maxDiffuseParticles, int &maxNeighbours);
+	int getMaxNeighbours()const { return _maxNeighbours; }
+
+	//particles
+	int getMaxParticles()const { return _maxParticles; }
+	int getActiveCount()const { return _maxParticles - _freeCount; }
+	//particle slots can be split into consecutive ranges that allocate independently, so several objects can share one solver
+	//a container starts with a single range over all slots. sizes must add up to max particles, everything allocated is freed
+	void setRanges(const std::vector<int> &sizes);
+	//makes ranges bigger without losing anything: a new solver is made for the new total and given every particle, constraint,
+	//shape and param of the old one. particle ids of a range move up by how much ranges below it grew, and only versions of such ranges change
+	//context must be acquired, nothing mapped
+	//throws if a range would shrink or flex can't make the new solver, the container stays as it was then
+	void growRanges(const std::vector<int> &sizes);
+	int getRangeCount()const { return int(_ranges.size()); }
+	int getRangeStart(int range)const { return _ranges[range].start; }
+	int getRangeSize(int range)const { return _ranges[range].size; }
+	int allocParticles(int n, int* indices, int range = 0); //returns number of actually allocated particles, their ids are written into indices
+	void freeParticles(int n, const int* indices); //ids may be from any range
+	int getActiveList(int* indices, int range = -1); //writes sorted active particle ids of a range (-1 - all of them), returns their count
+	int getActiveRange(); //one past the highest active particle id. everything above is free
+	int64 getActiveVersion(int range = -1)const { return range < 0 ? _activeVersion : _ranges[range].version; } //changes every time particles are allocated or freed
+	exint getActiveListFetchCount()const { return _activeListFetches; }
+	//solver calls markStepped after every NvFlexUpdateSolver, so cached copies of data sharing this container can tell if it's still their state
+	//host copies of P and v are older than the device's from then on, until they are pulled
+	void markStepped() {
+		++_stepCount;
+		_staleChannels |= NVFLEXH_CHANNEL_PARTICLES | NVFLEXH_CHANNEL_VELOCITIES;
+	}
+	int64 getStepCount()const { return _stepCount; }
+
+	//running totals of what was given to and taken from flex, collision shapes and their meshes included
+	int64 getUploadedBytes()const { return _bytesUp + _colld->getUploadedBytes(); }
+	int64 getDownloadedBytes()const { return _bytesDown; }
+	//times particle, constraint and shape buffers had to take another buffer, see NvFlexHVector
+	exint getBufferAllocCount()const;
+
+	//only requested channels are mapped, others are NULL. stale host copies of them are pulled first (so they must not be mapped already),
+	//cuz pushes send whole channels: writing a few particles must not send old values of all the others
+	NvFlexExtParticleData mapParticleData(int channels = NVFLEXH_CHANNEL_ALL);
+	void unmapParticleData(); //unmaps whatever was mapped
+	void pushParticlesToDevice(int channels = NVFLEXH_CHANNEL_ALL); //active list is pushed too if it changed
+	//only [0, getActiveRange()) is read back, slots above keep whatever they had
+	void pullParticlesFromDevice(int channels = NVFLEXH_CHANNEL_PARTICLES | NVFLEXH_CHANNEL_VELOCITIES | NVFLEXH_CHANNEL_PHASES);
+
+	//springs
+	int getSpringsCount()const { return _springRestLengths.size(); }
+	void resizeSpringData(int newSize) {
+		/// be sure data is NOT MAPPED before here
+		/// cuz all previous pointers will be invalidated
+		_springIndices.map();
+		_springRestLengths.map();
+		_springStrenghts.map();
+
+		_springIndices.resize(2*newSize);
+		_springRestLengths.resize(newSize);
+		_springStrenghts.resize(newSize);
+
+		_springIndices.unmap();
+		_springRestLengths.unmap();
+		_springStrenghts.unmap();
+	}
+	NvFlexHSpringData mapSpringData() {
+		_springIndices.map();
+		_springRestLengths.map();
+		_springStrenghts.map();
+		return NvFlexHSpringData(_springIndices.mappedPtr, _springRestLengths.mappedPtr, _springStrenghts.mappedPtr);
+	}
+	void unmapSpringData() {
+		_springIndices.unmap();
+		_springRestLengths.unmap();
+		_springStrenghts.unmap();
+	}
+	//fast path for restlength/strength only changes: spring indices are not touched. arrays not asked for are NULL
+	NvFlexHSpringData mapSpringParams(bool restLengths, bool strengths) {
+		if (restLengths)_springRestLengths.map();
+		if (strengths)_springStrenghts.map();
+		return NvFlexHSpringData(NULL, restLengths ? _springRestLengths.mappedPtr : NULL, strengths ? _springStrenghts.mappedPtr : NULL);
+	}
+	void unmapSpringParams() {
+		if (_springRestLengths.mappedPtr != NULL)_springRestLengths.unmap();
+		if (_springStrenghts.mappedPtr != NULL)_springStrenghts.unmap();
+	}
+	void pushSpringsToDevice() {
+		NvFlexSetSprings(_slv, _springIndices.buffer, _springRestLengths.buffer, _springStrenghts.buffer, _springRestLengths.size());
+		_bytesUp += int64(_springRestLengths.size()) * (2 * sizeof(int) + 2 * sizeof(float));
+	}
+	//push after mapSpringParams. flex 1.1 has no call for spring params alone, NvFlexSetSprings takes the unchanged indices along,
+	//so only params that changed are counted as uploaded
+	void pushSpringParamsToDevice(bool restLengths, bool strengths) {
+		NvFlexSetSprings(_slv, _springIndices.buffer, _springRestLengths.buffer, _springStrenghts.buffer, _springRestLengths.size());
+		_bytesUp += int64(_springRestLengths.size()) * ((restLengths ? sizeof(float) : 0) + (strengths ? sizeof(float) : 0));
+	}
+
+	//triangles
+	int getTrianglesCount()const { return _triangleIndices.size() / 3; }
+	void resizeTriangleData(int newSize) {
+		/// be sure data is NOT MAPPED before here
+		/// cuz all previous pointers will be invalidated
+		_triangleIndices.map();
+		_triangleNormals.map();
+
+		_triangleIndices.resize(3*newSize);
+		_triangleNormals.resize(3*newSize);
+
+		_triangleIndices.unmap();
+		_triangleNormals.unmap();
+	}
+	NvFlexHTriangleData mapTriangleData() {
+		_triangleIndices.map();
+		_triangleNormals.map();
+		return NvFlexHTriangleData(_triangleIndices.mappedPtr, _triangleNormals.mappedPtr);
+	}
+	void unmapTriangleData() {
+		_triangleIndices.unmap();
+		_triangleNormals.unmap();
+	}
+	void pushTrianglesToDevice(bool pushNormals = true) {
+		NvFlexSetDynamicTriangles(_slv, _triangleIndices.buffer, pushNormals ? _triangleNormals.buffer : NULL, _triangleIndices.size() / 3);
+		_triangleNormalsPushed = pushNormals;
+		_bytesUp += int64(_triangleIndices.size()) * (sizeof(int) + (pushNormals ? sizeof(float) : 0));
+	}
+
+	//rigids
+	int getRigidCount()const { return _rgdStiffness.size(); }
+	int getRigidIndicesCount()const { return _rgdIndices.size(); }
+	void resizeRigidData(const int numbodies, const std::vector<int>& bodysizes) {
+		// data must not be mapped !
+		// pointers will be fucked !
+		
+		//TODO: assert numbodies == bodysizes.size()
+		_rgdOffsets.map();
+		_rgdIndices.map();
+		_rgdRestPositions.map();
+		_rgdRestNormals.map();
+		_rgdStiffness.map();
+		_rgdRotations.map();
+		_rgdTranslations.map();
+
+
+		_rgdOffsets.resize(numbodies + 1);
+		exint ind = 0;
+		for (size_t i = 0; i < numbodies; ++i) {
+			_rgdOffsets[i] = ind;
+			ind += bodysizes[i];
+		}
+		_rgdOffsets[numbodies] = ind;
+
+		_rgdIndices.resize(ind);
+
+		_rgdRestPositions.resize(ind * 3);
+		_rgdRestNormals.resize(ind * 4);
+		_rgdStiffness.resize(numbodies);
+		_rgdRotations.resize(numbodies * 4);
+		_rgdTranslations.resize(numbodies * 3);
+
+		_rgdOffsets.unmap();
+		_rgdIndices.unmap();
+		_rgdRestPositions.unmap();
+		_rgdRestNormals.unmap();
+		_rgdStiffness.unmap();
+		_rgdRotations.unmap();
+		_rgdTranslations.unmap();
+	}
+	NvFlexHRigidData mapRigidData() {
+		_rgdOffsets.map();
+		_rgdIndices.map();
+		_rgdRestPositions.map();
+		_rgdRestNormals.map();
+		_rgdStiffness.map();
+		_rgdRotations.map();
+		_rgdTranslations.map();
+		return NvFlexHRigidData(_rgdOffsets.mappedPtr, _rgdIndices.mappedPtr, _rgdRestPositions.mappedPtr, _rgdRestNormals.mappedPtr, _rgdStiffness.mappedPtr, _rgdRotations.mappedPtr, _rgdTranslations.mappedPtr);
+	}
+	void unmapRigidData() {
+		_rgdOffsets.unmap();
+		_rgdIndices.unmap();
+		_rgdRestPositions.unmap();
+		_rgdRestNormals.unmap();
+		_rgdStiffness.unmap();
+		_rgdRotations.unmap();
+		_rgdTranslations.unmap();
+	}
+	NvFlexHRigidTransData mapRigidTransData() { //maps just the translation+rotation data instead of the whole bunch
+		_rgdRotations.map();
+		_rgdTranslations.map();
+		return NvFlexHRigidTransData(_rgdTranslations.mappedPtr, _rgdRotations.mappedPtr, _rgdStiffness.size());
+	}
+	void unmapRigidTransData() {
+		_rgdRotations.unmap();
+		_rgdTranslations.unmap();
+	}
+	void pushRigidsToDevice() {
+		NvFlexSetRigids(_slv, _rgdOffsets.buffer, _rgdIndices.buffer, _rgdRestPositions.buffer, _rgdRestNormals.buffer, _rgdStiffness.buffer, _rgdRotations.buffer, _rgdTranslations.buffer, _rgdStiffness.size(), _rgdIndices.size());
+		_bytesUp += int64(_rgdOffsets.size() + _rgdIndices.size()) * sizeof(int) + int64(_rgdRestPositions.size() + _rgdRestNormals.size() + _rgdStiffness.size() + _rgdRotations.size() + _rgdTranslations.size()) * sizeof(float);
+	}
+	void pullRigidsFromDevice() {
+		//pull rigid transformations recalculated by solver
+		//WARNING! buffers MUST already be properly resized!
+		NvFlexGetRigidTransforms(_slv, _rgdRotations.buffer, _rgdTranslations.buffer);
+		_bytesDown += int64(_rgdRotations.size() + _rgdTranslations.size()) * sizeof(float);
+	}
+
+private:
+	int64 channelBytes(int channels, int count)const;
+
+	NvFlexHCollisionData* _colld;
+	NvFlexLibrary* _lib;
+	NvFlexSolver* _slv;
+	NvFlexParams _defaultParams; //what solver had right after creation
+	int _maxDiffuseParticles;
+	int _maxNeighbours;
+
+	//particles
+	struct ParticleRange {
+		int start;
+		int size;
+		std::vector<int> freeList; //lowest ids are at the back
+		int64 version;
+	};
+	int rangeOf(int particle)const;
+
+	int _maxParticles;
+	std::vector<ParticleRange> _ranges;
+	int _freeCount;
+	bool _activeDirty; //active list changed since last push
+	bool _activeRangeDirty;
+	int _activeRange;
+	int64 _activeVersion;
+	exint _activeListFetches;
+	int64 _stepCount;
+	int64 _bytesUp;
+	int64 _bytesDown;
+	bool _triangleNormalsPushed; //so a new solver gets triangles the way the old one had them
+	int _mappedChannels;
+	int _staleChannels; //host copies the solver has moved past since they were last pulled or pushed
+	NvFlexHVector<Vec4> _particles;
+	NvFlexHVector<Vec4> _restParticles;
+	NvFlexHVector<Vec3> _velocities;
+	NvFlexHVector<int> _phases;
+	NvFlexHVector<int> _activeIndices;
+
+	//springs
+	NvFlexHVector<int> _springIndices;
+	NvFlexHVector<float> _springRestLengths;
+	NvFlexHVector<float> _springStrenghts;
+	//triangles
+	NvFlexHVector<int> _triangleIndices;
+	NvFlexHVector<float> _triangleNormals;
+	//rigids
+	NvFlexHVector<int> _rgdOffsets; //numRigids+1
+	NvFlexHVector<int> _rgdIndices;
+	NvFlexHVector<float> _rgdRestPositions; //numIndices*3
+	NvFlexHVector<float> _rgdRestNormals; //numIndices*4 (normal.xyz;sdf)
+	NvFlexHVector<float> _rgdStiffness; //numRigids
+	NvFlexHVector<float> _rgdRotations; //numRigids*4 (quat)
+	NvFlexHVector<float> _rgdTranslations; //numRigids*3
+};
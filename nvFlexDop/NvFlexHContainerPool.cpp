@@ -0,0 +1,97 @@
+#include "utils.h"
+#include "NvFlexHContext.h"
+#include "NvFlexHContainerPool.h"
+
+NvFlexHContainerPool& NvFlexHContainerPool::instance() {
+	static NvFlexHContainerPool pool;
+	return pool;
+}
+
+NvFlexHContainerPool::NvFlexHContainerPool() :_capacity(2), _holdsLibrary(false), _reuses(0), _creates(0) {}
+
+NvFlexHContainerPool::~NvFlexHContainerPool() {
+	//cuda may be gone by the time statics are destroyed, so idle containers are left to process exit
+}
+
+NvFlexHContainer* NvFlexHContainerPool::acquire(NvFlexLibrary* lib, int maxParticles, int maxDiffuseParticles, int maxNeighbours) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto it = _idle.rbegin(); it != _idle.rend(); ++it) {
+			NvFlexHContainer *container = *it;
+			if (container->getMaxParticles() != maxParticles || container->getMaxDiffuseParticles() != maxDiffuseParticles || container->getMaxNeighbours() != maxNeighbours)continue;
+			_idle.erase(std::next(it).base());
+			++_reuses;
+			messageLog(5, "container of %d particles taken from pool, %d left idle\n", maxParticles, int(_idle.size()));
+			if (_idle.empty())trim(0); //caller has its own library reference, so this is never the last one
+			return container;
+		}
+		++_creates;
+	}
+	NvFlexHContextAutoGetter context;
+	return new NvFlexHContainer(lib, maxParticles, maxDiffuseParticles, maxNeighbours);
+}
+
+void NvFlexHContainerPool::recycle(NvFlexHContainer* container) {
+	if (container == NULL)return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	{
+		NvFlexHContextAutoGetter context;
+		if (_capacity == 0) {
+			delete container;
+			return;
+		}
+		container->clear();
+	}
+	if (!_holdsLibrary) {
+		NvFlexHContext::instance().addRef(NULL); //library is there already, container is of it
+		_holdsLibrary = true;
+	}
+	_idle.push_back(container);
+	trim(_capacity);
+	messageLog(5, "container of %d particles recycled, %d idle\n", container->getMaxParticles(), int(_idle.size()));
+}
+
+void NvFlexHContainerPool::trim(size_t keep) {
+	if (_idle.size() > keep) {
+		NvFlexHContextAutoGetter context;
+		while (_idle.size() > keep) {
+			delete _idle.front();
+			_idle.pop_front();
+		}
+	}
+	if (_idle.empty() && _holdsLibrary) {
+		_holdsLibrary = false;
+		NvFlexHContext::instance().release(); //may be the last reference, so not inside the context
+	}
+}
+
+void NvFlexHContainerPool::setCapacity(int capacity) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_capacity = capacity < 0 ? 0 : capacity;
+	trim(_capacity);
+}
+
+int NvFlexHContainerPool::getCapacity() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _capacity;
+}
+
+int NvFlexHContainerPool::size() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return int(_idle.size());
+}
+
+void NvFlexHContainerPool::clear() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	trim(0);
+}
+
+exint NvFlexHContainerPool::getReuseCount() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _reuses;
+}
+
+exint NvFlexHContainerPool::getCreateCount() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _creates;
+}
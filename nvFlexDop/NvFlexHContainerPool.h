@@ -0,0 +1,44 @@
+#pragma once
+#include <SYS/SYS_Types.h>
+
+#include <deque>
+#include <mutex>
+
+#include "NvFlexHContainer.h"
+
+//process wide pool of idle containers, keyed by their sizes. a sim reset gets a cleared container back instead of a new solver,
+//and while the pool keeps anything it holds a library reference, so cuda context and flex library are not made again either
+//every method takes the library context itself
+class NvFlexHContainerPool {
+public:
+	static NvFlexHContainerPool& instance();
+
+	//cleared idle container with exactly these sizes, or a new one. throws if flex can't create a solver
+	NvFlexHContainer* acquire(NvFlexLibrary* lib, int maxParticles, int maxDiffuseParticles, int maxNeighbours);
+	//takes a container back for later acquires, clearing it. containers above capacity are destroyed, least recently used first
+	void recycle(NvFlexHContainer* container);
+
+	void setCapacity(int capacity); //idle containers kept, 0 - everything is destroyed right away
+	int getCapacity() const;
+	int size() const;
+	void clear(); //destroys idle containers and lets the library go
+
+	exint getReuseCount() const;
+	exint getCreateCount() const;
+
+private:
+	NvFlexHContainerPool();
+	~NvFlexHContainerPool();
+	NvFlexHContainerPool(const NvFlexHContainerPool&) = delete;
+	NvFlexHContainerPool& operator=(const NvFlexHContainerPool&) = delete;
+
+	//destroys idle containers above keep, releases library reference if nothing is left. lock must be held
+	void trim(size_t keep);
+
+	mutable std::mutex _mutex;
+	std::deque<NvFlexHContainer*> _idle; //most recently recycled at the back
+	int _capacity;
+	bool _holdsLibrary;
+	exint _reuses;
+	exint _creates;
+};
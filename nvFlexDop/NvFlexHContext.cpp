@@ -0,0 +1,139 @@
+#include <NvFlexDevice.h>
+
+#include <cuda.h>
+
+#include <stdexcept>
+
+#include "utils.h"
+#include "NvFlexHTriangleMesh.h"
+#include "NvFlexHDistanceField.h"
+#include "NvFlexHBufferPool.h"
+#include "NvFlexHContext.h"
+
+static thread_local int threadAcquireDepth = 0;
+
+NvFlexHContext& NvFlexHContext::instance() {
+	static NvFlexHContext context;
+	return context;
+}
+
+NvFlexHContext::NvFlexHContext() :_lib(NULL), _refs(0), _cudaContextCreated(false), _cudaExplicitlyInitialized(false) {}
+
+void NvFlexHContext::createCudaContext() {
+	int attempt = 0;
+	if (_cudaExplicitlyInitialized)attempt = 1;
+	for (; attempt < 2; ++attempt) {
+		if (!_cudaExplicitlyInitialized && attempt == 1) {
+			messageLog(3, "initializing CUDA explicitly...\n");
+			CUresult err;
+			if ((err = cuInit(0)) != CUDA_SUCCESS) {
+				messageLog(0, "cuda initialization failed! error code: %d\n", err);
+				throw std::runtime_error("cuda initialization failed!");
+			}
+			_cudaExplicitlyInitialized = true;
+		}
+
+		int cdevice = NvFlexDeviceGetSuggestedOrdinal();
+		if (cdevice == -1) {
+			if (attempt < 1)continue;
+			messageLog(1, "FlexDevice: No Cuda device found ! \n");
+			throw std::runtime_error("Failed to initialize Cuda Context");
+		}
+		if (!NvFlexDeviceCreateCudaContext(cdevice)) {
+			if (attempt < 1)continue;
+			messageLog(1, "FlexDevice: Failed to initialize Cuda Context\n");
+			throw std::runtime_error("Failed to initialize Cuda Context");
+		}
+		_cudaContextCreated = true;
+		break;
+	}
+}
+
+NvFlexLibrary* NvFlexHContext::addRef(NvFlexErrorCallback errorFunc) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_lib.load() == NULL) {
+		if (!_cudaContextCreated)createCudaContext();
+		NvFlexInitDesc desc;
+		desc.deviceIndex = 0; // ignored, device index is set by the context. TODO: make an env variable for fallback device
+		desc.enableExtensions = false;
+		desc.renderDevice = NULL;
+		desc.renderContext = NULL;
+		desc.computeType = NvFlexComputeType::eNvFlexCUDA;
+		NvFlexLibrary *lib = NULL;
+		try {
+			lib = NvFlexInit(110, errorFunc, &desc);
+		}
+		catch (...) { lib = NULL; }
+
+		if (lib == NULL) {
+			messageLog(0, "Failed to initialize Flex library\n");
+			throw std::runtime_error("Failed to initialize Flex library");
+		}
+		_lib.store(lib);
+		messageLog(5, "flex library initialized\n");
+	}
+	++_refs;
+	messageLog(5, "flex context: %d references\n", _refs);
+	return _lib.load();
+}
+
+void NvFlexHContext::release() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_refs == 0)return;
+	--_refs;
+	messageLog(5, "flex context: %d references\n", _refs);
+	if (_refs > 0)return;
+
+	NvFlexLibrary *lib = _lib.load();
+	if (threadAcquireDepth > 0) {
+		messageLog(1, "flex library is released with %d context acquires not restored on this thread\n", threadAcquireDepth);
+		while (threadAcquireDepth > 0) {
+			NvFlexRestoreContext(lib);
+			--threadAcquireDepth;
+			_flexMutex.unlock();
+		}
+	}
+	//no other thread can be in the context by now: everything that acquires it holds a reference
+	std::lock_guard<std::recursive_mutex> flexLock(_flexMutex);
+	NvFlexAcquireContext(lib);
+	NvFlexHTriangleMeshCache::instance().clear(); //meshes still referenced by leftover containers must go before the library
+	NvFlexHDistanceFieldCache::instance().clear();
+	NvFlexHBufferPool::instance().clear(); //last, meshes above give their buffers back to it
+	//lets assume that NvFlexShutdown restores previous context
+	NvFlexShutdown(lib);
+	_lib.store(NULL);
+	NvFlexDeviceDestroyCudaContext();
+	_cudaContextCreated = false;
+	messageLog(5, "flex library destroyed\n");
+}
+
+int NvFlexHContext::refCount() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _refs;
+}
+
+bool NvFlexHContext::acquire() {
+	if (_lib.load() == NULL)return false;
+	_flexMutex.lock();
+	NvFlexLibrary *lib = _lib.load(); //may have been released while we waited
+	if (lib == NULL) {
+		_flexMutex.unlock();
+		return false;
+	}
+	NvFlexAcquireContext(lib);
+	++threadAcquireDepth;
+	return true;
+}
+
+bool NvFlexHContext::restore() {
+	NvFlexLibrary *lib = _lib.load();
+	if (lib == NULL || threadAcquireDepth == 0)return false;
+	NvFlexRestoreContext(lib);
+	--threadAcquireDepth;
+	_flexMutex.unlock();
+	return true;
+}
+
+int NvFlexHContext::threadDepth() {
+	return threadAcquireDepth;
+}
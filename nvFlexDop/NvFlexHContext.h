@@ -0,0 +1,54 @@
+#pragma once
+#include <NvFlex.h>
+
+#include <atomic>
+#include <mutex>
+
+//process wide flex library and cuda context it runs in.
+//library is reference counted, so it lives while any dop network (or in process pdg work item) holds it.
+//acquires nest per thread, cuda keeps a stack of current contexts per thread, so one thread's acquires mean nothing to another.
+//flex makes no promise a library can be used from several threads at once, so a thread holding the context holds the library:
+//acquired sections of different threads run one at a time, work outside of them still overlaps
+class NvFlexHContext {
+public:
+	static NvFlexHContext& instance();
+
+	//first reference makes cuda context and flex library. throws std::runtime_error if it can't
+	NvFlexLibrary* addRef(NvFlexErrorCallback errorFunc);
+	//last one destroys cached collision meshes, the library and cuda context
+	void release();
+	NvFlexLibrary* library() const { return _lib.load(); }
+	int refCount() const;
+
+	//waits until no other thread has the context, then makes it current on calling thread. false if there is no library
+	bool acquire();
+	//restores what was current before the matching acquire. false if calling thread has nothing acquired
+	bool restore();
+	static int threadDepth(); //not restored acquires of calling thread
+
+private:
+	NvFlexHContext();
+	NvFlexHContext(const NvFlexHContext&) = delete;
+	NvFlexHContext& operator=(const NvFlexHContext&) = delete;
+
+	void createCudaContext();
+
+	mutable std::mutex _mutex; //library lifetime
+	std::recursive_mutex _flexMutex; //flex calls, locked from acquire to its restore. after _mutex when both are taken
+	std::atomic<NvFlexLibrary*> _lib;
+	int _refs;
+	bool _cudaContextCreated;
+	bool _cudaExplicitlyInitialized;
+};
+
+//context of the library is current on this thread while it lives
+class NvFlexHContextAutoGetter {
+public:
+	NvFlexHContextAutoGetter() :_acquired(NvFlexHContext::instance().acquire()) {}
+	NvFlexHContextAutoGetter(const NvFlexHContextAutoGetter&) = delete;
+	NvFlexHContextAutoGetter& operator=(const NvFlexHContextAutoGetter&) = delete;
+	~NvFlexHContextAutoGetter() { if (_acquired)NvFlexHContext::instance().restore(); }
+	bool isAcquired() const { return _acquired; }
+private:
+	bool _acquired;
+};
@@ -0,0 +1,27 @@
+#include "NvFlexHConvexMesh.h"
+
+
+NvFlexHConvexMesh::NvFlexHConvexMesh(NvFlexLibrary* lib) :planevec(lib) {
+	id = NvFlexCreateConvexMesh(lib);
+	planevec.resize(0);
+	planevec.unmap();
+}
+
+NvFlexHConvexMesh::~NvFlexHConvexMesh() {
+	NvFlexDestroyConvexMesh(planevec.lib, id);
+	planevec.destroy();
+}
+
+NvFlexConvexMeshId NvFlexHConvexMesh::getId() const {
+	return id;
+}
+
+void NvFlexHConvexMesh::loadData(const Vec4* planes, int planecount, const float* lower, const float* upper) {
+	planevec.map();
+	planevec.resize(planecount);
+	memcpy(planevec.mappedPtr, planes, planecount * sizeof(Vec4));
+	memcpy(this->lower, lower, 3 * sizeof(float));
+	memcpy(this->upper, upper, 3 * sizeof(float));
+	planevec.unmap();
+	NvFlexUpdateConvexMesh(planevec.lib, id, planevec.buffer, planevec.size(), this->lower, this->upper);
+}
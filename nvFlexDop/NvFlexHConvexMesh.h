@@ -0,0 +1,28 @@
+#pragma once
+#include <SYS/SYS_Types.h>
+#include <string.h> // for memcpy required in NvFlexExt.h
+#include <NvFlex.h>
+#include <NvFlexExt.h>
+#include <../core/maths.h>
+
+#include "NvFlexHVector.h"
+
+
+//convex collider given by its outward planes, each plane is (n, w) with dot(n, x) + w == 0 on it
+class NvFlexHConvexMesh
+{
+public:
+	NvFlexHConvexMesh(NvFlexLibrary* lib);
+	NvFlexHConvexMesh(const NvFlexHConvexMesh&) = delete;
+	NvFlexHConvexMesh& operator=(const NvFlexHConvexMesh&) = delete;
+	~NvFlexHConvexMesh();
+
+	NvFlexConvexMeshId getId()const;
+	void loadData(const Vec4* planes, int planecount, const float* lower, const float* upper); //also pushes to flex, same id is kept on reloads
+
+private:
+	NvFlexConvexMeshId id;
+	NvFlexHVector<Vec4> planevec;
+	float lower[3];
+	float upper[3];
+};
@@ -0,0 +1,173 @@
+#include <FS/FS_Info.h>
+#include <UT/UT_StringArray.h>
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+#include <algorithm>
+
+#include "NvFlexHDistanceField.h"
+#include "utils.h"
+
+
+NvFlexHDistanceField::NvFlexHDistanceField(NvFlexLibrary* lib) :fieldvec(lib) {
+	id = NvFlexCreateDistanceField(lib);
+	fieldvec.resize(0);
+	fieldvec.unmap();
+}
+
+NvFlexHDistanceField::~NvFlexHDistanceField() {
+	NvFlexDestroyDistanceField(fieldvec.lib, id);
+	fieldvec.destroy();
+}
+
+NvFlexDistanceFieldId NvFlexHDistanceField::getId() const {
+	return id;
+}
+
+void NvFlexHDistanceField::loadData(const float* field, int dim) {
+	fieldvec.map();
+	fieldvec.resize(dim*dim*dim);
+	memcpy(fieldvec.mappedPtr, field, size_t(dim)*dim*dim * sizeof(float));
+	fieldvec.unmap();
+	NvFlexUpdateDistanceField(fieldvec.lib, id, dim, dim, dim, fieldvec.buffer);
+}
+
+//field cache
+NvFlexHDistanceFieldCache& NvFlexHDistanceFieldCache::instance() {
+	static NvFlexHDistanceFieldCache cache;
+	return cache;
+}
+
+NvFlexHDistanceFieldCache::~NvFlexHDistanceFieldCache() {
+	//library is gone by now, so just forget the fields
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)it->second.field = NULL;
+}
+
+uint64 NvFlexHDistanceFieldCache::fieldHash(const float* field, int dim) {
+	uint64 h = 0xcbf29ce484222325ULL;
+	h = hashBytes(h, &dim, sizeof(dim));
+	return hashBytes(h, field, size_t(dim)*dim*dim * sizeof(float));
+}
+
+NvFlexHDistanceField* NvFlexHDistanceFieldCache::acquire(NvFlexLibrary* lib, uint64 hash, const float* field, int dim, bool *missed) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto range = _entries.equal_range(hash);
+	auto it = range.first;
+	while (it != range.second && it->second.dim != dim)++it;
+	if (missed != NULL)*missed = it == range.second && field != NULL;
+	if (it != range.second) {
+		++it->second.refs;
+		++_hits;
+		return it->second.field;
+	}
+	if (field == NULL)return NULL;
+	++_misses;
+	NvFlexHDistanceField* sdf = new NvFlexHDistanceField(lib);
+	sdf->loadData(field, dim);
+	_entries.emplace(hash, Entry{ sdf, 1, dim });
+	return sdf;
+}
+
+void NvFlexHDistanceFieldCache::release(uint64 hash, const NvFlexHDistanceField* field) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto range = _entries.equal_range(hash);
+	auto it = range.first;
+	while (it != range.second && it->second.field != field)++it;
+	if (it == range.second)return;
+	if (--it->second.refs > 0)return;
+	delete it->second.field;
+	_entries.erase(it);
+}
+
+void NvFlexHDistanceFieldCache::clear() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)delete it->second.field;
+	_entries.clear();
+}
+
+exint NvFlexHDistanceFieldCache::size() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+//disk cache. file is a small header followed by raw floats, written in native byte order since it never leaves the machine
+static const char bakeMagic[8] = { 'N','V','F','H','S','D','F','1' };
+
+std::string NvFlexHDistanceFieldCache::bakePath(const char* dir, uint64 hash) {
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.sdf", (unsigned long long)hash);
+	return std::string(dir) + name;
+}
+
+bool NvFlexHDistanceFieldCache::loadBake(const char* dir, uint64 hash, int dim, std::vector<float> &field) {
+	if (dir == NULL || dir[0] == '\0')return false;
+	const std::string path = bakePath(dir, hash);
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == NULL)return false;
+	char magic[8];
+	int fdim = 0;
+	bool ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, bakeMagic, 8) == 0 && fread(&fdim, sizeof(int), 1, f) == 1 && fdim == dim;
+	if (ok) {
+		field.resize(size_t(dim)*dim*dim);
+		ok = fread(field.data(), sizeof(float), field.size(), f) == field.size();
+	}
+	fclose(f);
+	if (ok)utime(path.c_str(), NULL); //pruning goes by mtime, so a bake in use is not the first to go
+	return ok;
+}
+
+bool NvFlexHDistanceFieldCache::saveBake(const char* dir, uint64 hash, int dim, const std::vector<float> &field) {
+	if (dir == NULL || dir[0] == '\0')return false;
+	//write to a temp name first, so a half written file is never picked up by another session
+	const std::string path = bakePath(dir, hash);
+	const std::string tmppath = path + ".tmp";
+	FILE* f = fopen(tmppath.c_str(), "wb");
+	if (f == NULL)return false;
+	bool ok = fwrite(bakeMagic, 1, 8, f) == 8 && fwrite(&dim, sizeof(int), 1, f) == 1 && fwrite(field.data(), sizeof(float), field.size(), f) == field.size();
+	ok = fclose(f) == 0 && ok;
+	if (ok) {
+		remove(path.c_str());
+		ok = rename(tmppath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)remove(tmppath.c_str());
+	return ok;
+}
+
+int NvFlexHDistanceFieldCache::pruneBakes(const char* dir, int64 maxBytes) {
+	if (dir == NULL || dir[0] == '\0')return 0;
+	UT_StringArray names;
+	if (!FS_Info(dir).getContents(names))return 0;
+	struct Bake {
+		std::string path;
+		time_t time;
+		int64 bytes;
+	};
+	std::vector<Bake> bakes;
+	int64 total = 0;
+	for (exint i = 0; i < names.entries(); ++i) {
+		const char *name = names(i).c_str();
+		const size_t len = strlen(name);
+		if (len < 4 || strcmp(name + len - 4, ".sdf") != 0)continue;
+		Bake bake;
+		bake.path = std::string(dir) + "/" + name;
+		FS_Info info(bake.path.c_str());
+		bake.time = info.getModTime();
+		bake.bytes = info.getFileDataSize();
+		total += bake.bytes;
+		bakes.push_back(bake);
+	}
+	if (total <= maxBytes)return 0;
+	std::sort(bakes.begin(), bakes.end(), [](const Bake &a, const Bake &b) { return a.time < b.time; });
+	int removed = 0;
+	for (size_t i = 0; i < bakes.size() && total > maxBytes; ++i) {
+		if (remove(bakes[i].path.c_str()) != 0)continue; //may be gone already, another session prunes the same dir
+		total -= bakes[i].bytes;
+		++removed;
+	}
+	return removed;
+}
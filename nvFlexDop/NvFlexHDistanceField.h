@@ -0,0 +1,74 @@
+#pragma once
+#include <SYS/SYS_Types.h>
+#include <string.h> // for memcpy required in NvFlexExt.h
+#include <NvFlex.h>
+#include <NvFlexExt.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "NvFlexHVector.h"
+
+
+//cubic signed distance field in flex's normalized space: cells cover [0,1]^3, distances are in the same units
+class NvFlexHDistanceField
+{
+public:
+	NvFlexHDistanceField(NvFlexLibrary* lib);
+	NvFlexHDistanceField(const NvFlexHDistanceField&) = delete;
+	NvFlexHDistanceField& operator=(const NvFlexHDistanceField&) = delete;
+	~NvFlexHDistanceField();
+
+	NvFlexDistanceFieldId getId()const;
+	void loadData(const float* field, int dim); //dim^3 values, x fastest. also pushes to flex
+
+private:
+	NvFlexDistanceFieldId id;
+	NvFlexHVector<float> fieldvec;
+};
+
+
+//library wide cache of distance fields keyed by content hash, same idea as NvFlexHTriangleMeshCache
+//bakes can also be kept on disk, so an asset is baked once and not once per session
+class NvFlexHDistanceFieldCache {
+public:
+	static NvFlexHDistanceFieldCache& instance();
+
+	static uint64 fieldHash(const float* field, int dim);
+
+	//returns cached field with this hash and dim. field can be NULL to only look the cache up, then NULL is returned on a miss
+	//a hash collision with a different dim is a miss. every successful acquire must be paired with a release
+	//missed (if given) tells if it was uploaded by this call
+	NvFlexHDistanceField* acquire(NvFlexLibrary* lib, uint64 hash, const float* field, int dim, bool *missed = NULL);
+	void release(uint64 hash, const NvFlexHDistanceField* field); //field is destroyed when last user releases it, so cuda context must be acquired
+
+	void clear(); //for library shutdown, destroys everything regardless of references
+
+	//disk side. file name is made of the hash, so any change of the source makes a new file
+	static std::string bakePath(const char* dir, uint64 hash);
+	static bool loadBake(const char* dir, uint64 hash, int dim, std::vector<float> &field);
+	static bool saveBake(const char* dir, uint64 hash, int dim, const std::vector<float> &field);
+	//deletes least recently written or loaded bakes until the ones in dir take no more than maxBytes. returns number of files deleted
+	static int pruneBakes(const char* dir, int64 maxBytes);
+
+	exint getHitCount() const { return _hits; }
+	exint getMissCount() const { return _misses; }
+	exint size() const;
+
+private:
+	NvFlexHDistanceFieldCache() :_hits(0), _misses(0) {}
+	~NvFlexHDistanceFieldCache();
+
+	struct Entry {
+		NvFlexHDistanceField* field;
+		int refs;
+		int dim; //checked on a hash hit
+	};
+	std::unordered_multimap<uint64, Entry> _entries;
+	mutable std::mutex _mutex;
+	std::atomic<exint> _hits; //read without the lock
+	std::atomic<exint> _misses;
+};
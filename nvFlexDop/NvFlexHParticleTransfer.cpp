@@ -0,0 +1,220 @@
+#include <GA/GA_Handle.h>
+#include <GA/GA_PageHandle.h>
+#include <GA/GA_PageIterator.h>
+#include <GA/GA_SplittableRange.h>
+#include <UT/UT_ParallelUtil.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define NVFLEXH_SSE
+#endif
+
+#include "NvFlexHParticleTransfer.h"
+
+//gathers xyz of 4 float4 particles ii[0..3] into 12 packed floats (4 x UT_Vector3F)
+static inline void gatherParticles4(const float *particles, const int *ii, float *dst) {
+#ifdef NVFLEXH_SSE
+	const __m128 a = _mm_loadu_ps(particles + ii[0] * 4);
+	const __m128 b = _mm_loadu_ps(particles + ii[1] * 4);
+	const __m128 c = _mm_loadu_ps(particles + ii[2] * 4);
+	const __m128 d = _mm_loadu_ps(particles + ii[3] * 4);
+	const __m128 t0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 2, 2)); // z0 z0 x1 x1
+	_mm_storeu_ps(dst + 0, _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 1, 0))); // x0 y0 z0 x1
+	_mm_storeu_ps(dst + 4, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 1))); // y1 z1 x2 y2
+	const __m128 t2 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0, 0, 2, 2)); // z2 z2 x3 x3
+	_mm_storeu_ps(dst + 8, _mm_shuffle_ps(t2, d, _MM_SHUFFLE(2, 1, 2, 0))); // z2 x3 y3 z3
+#else
+	for (int k = 0; k < 4; ++k) {
+		dst[k * 3 + 0] = particles[ii[k] * 4 + 0];
+		dst[k * 3 + 1] = particles[ii[k] * 4 + 1];
+		dst[k * 3 + 2] = particles[ii[k] * 4 + 2];
+	}
+#endif
+}
+
+
+void pushGeoToParticles(const GU_Detail *gdp, const NvFlexExtParticleData &pdat, const int *indices, int nactives, int channels, int phaseGroupOffset, int newChannels, const char *newParticles) {
+	GA_ROHandleV3 phnd(gdp->getP());
+	GA_ROHandleV3 vhnd(gdp->findPointAttribute("v"));
+	GA_ROHandleI phshnd(gdp->findPointAttribute("phs"));
+	GA_ROHandleF mhnd(gdp->findPointAttribute("imass"));
+	GA_ROHandleV3 rhnd(gdp->findPointAttribute("restP"));
+	if (newParticles == NULL)newChannels = NVFLEXH_CHANNEL_NONE;
+	const int allChannels = channels | newChannels;
+	const bool hasRest = rhnd.isValid();
+
+	float * const particles = pdat.particles;
+	float * const restParticles = pdat.restParticles;
+	float * const velocities = pdat.velocities;
+	int * const phases = pdat.phases;
+
+	UTparallelFor(GA_SplittableRange(gdp->getPointRange()), [&](const GA_SplittableRange &r) {
+		GA_Offset bst, bed;
+		for (GA_Iterator it(r); it.blockAdvance(bst, bed);) {
+			for (GA_Offset off = bst; off < bed; ++off) {
+				GA_Index idx = gdp->pointIndex(off);
+				if (idx >= nactives)continue; //index order may differ from offset order, so no early break here
+
+				int iid = indices[idx];
+				int iid4 = iid * 4;
+				int iid3 = iid * 3;
+				const int pointChannels = (newChannels != NVFLEXH_CHANNEL_NONE && newParticles[iid]) ? allChannels : channels;
+				const bool doParticles = pointChannels & NVFLEXH_CHANNEL_PARTICLES;
+				const bool doRest = hasRest && (pointChannels & NVFLEXH_CHANNEL_REST);
+				const bool doVelocities = pointChannels & NVFLEXH_CHANNEL_VELOCITIES;
+				const bool doPhases = pointChannels & NVFLEXH_CHANNEL_PHASES;
+				if (doParticles) {
+					UT_Vector3F p = phnd.get(off);
+					particles[iid4 + 0] = p.x();
+					particles[iid4 + 1] = p.y();
+					particles[iid4 + 2] = p.z();
+					particles[iid4 + 3] = mhnd.get(off);
+				}
+				if (doRest) {
+					UT_Vector3F rst = rhnd.get(off);
+					restParticles[iid4 + 0] = rst.x();
+					restParticles[iid4 + 1] = rst.y();
+					restParticles[iid4 + 2] = rst.z();
+					restParticles[iid4 + 3] = 1.0f; //cannot find in manual what it expects here
+				}
+				if (doVelocities) {
+					UT_Vector3F v = vhnd.get(off);
+					velocities[iid3 + 0] = v.x();
+					velocities[iid3 + 1] = v.y();
+					velocities[iid3 + 2] = v.z();
+				}
+				if (doPhases) {
+					phases[iid] = offsetPhaseGroup(phshnd.get(off), phaseGroupOffset);
+				}
+			}
+		}
+	});
+}
+
+
+void pullParticlesToGeo(GU_Detail *gdp, const NvFlexExtParticleData &pdat, const int *indices, GA_Attribute *vattr, GA_Attribute *iidattr, GA_Attribute *phsattr, GA_Attribute *restattr, GA_Attribute *imassattr, int phaseGroupOffset) {
+	const float * const particles = pdat.particles;
+	const float * const velocities = pdat.velocities;
+	const int * const phases = pdat.phases;
+	const float * const restParticles = pdat.restParticles;
+	const bool doParticles = particles != NULL;
+	const bool doVelocities = vattr != NULL && velocities != NULL;
+	const bool doIds = iidattr != NULL;
+	const bool doPhases = phsattr != NULL && phases != NULL;
+	const bool doRest = restattr != NULL && restParticles != NULL;
+	const bool doMass = imassattr != NULL && particles != NULL;
+	if (!(doParticles || doVelocities || doIds || doPhases || doRest))return;
+	const bool trivialmap = gdp->getPointMap().isTrivialMap(); //then point index == offset and we skip index lookups
+
+	UTparallelFor(GA_SplittableRange(gdp->getPointRange()), [&](const GA_SplittableRange &r) {
+		GA_RWPageHandleV3 phnd(gdp->getP());
+		GA_RWPageHandleV3 vhnd(doVelocities ? vattr : NULL);
+		GA_RWPageHandleI iidhnd(doIds ? iidattr : NULL);
+		GA_RWPageHandleI phshnd(doPhases ? phsattr : NULL);
+		GA_RWPageHandleV3 rhnd(doRest ? restattr : NULL);
+		GA_RWPageHandleF mhnd(doMass ? imassattr : NULL);
+		int ii[GA_PAGE_SIZE];
+
+		for (GA_PageIterator pit = r.beginPages(); !pit.atEnd(); ++pit) {
+			GA_Offset start, end;
+			for (GA_Iterator it(pit.begin()); it.blockAdvance(start, end);) {
+				if (doParticles)phnd.setPage(start);
+				if (doVelocities)vhnd.setPage(start);
+				if (doIds)iidhnd.setPage(start);
+				if (doPhases)phshnd.setPage(start);
+				if (doRest)rhnd.setPage(start);
+				if (doMass)mhnd.setPage(start);
+
+				const GA_Size count = end - start;
+				if (trivialmap) {
+					for (GA_Size k = 0; k < count; ++k)ii[k] = indices[start + k];
+				}
+				else {
+					for (GA_Size k = 0; k < count; ++k)ii[k] = indices[gdp->pointIndex(start + k)];
+				}
+
+				//blocks never cross a page, so page data for [start, end) is contiguous
+				if (doParticles) {
+					float *pdst = phnd.value(start).data();
+					GA_Size k = 0;
+					for (; k + 4 <= count; k += 4) {
+						gatherParticles4(particles, ii + k, pdst + k * 3);
+					}
+					for (; k < count; ++k) {
+						pdst[k * 3 + 0] = particles[ii[k] * 4 + 0];
+						pdst[k * 3 + 1] = particles[ii[k] * 4 + 1];
+						pdst[k * 3 + 2] = particles[ii[k] * 4 + 2];
+					}
+				}
+				if (doRest) {
+					float *rdst = rhnd.value(start).data();
+					GA_Size k = 0;
+					for (; k + 4 <= count; k += 4) {
+						gatherParticles4(restParticles, ii + k, rdst + k * 3);
+					}
+					for (; k < count; ++k) {
+						rdst[k * 3 + 0] = restParticles[ii[k] * 4 + 0];
+						rdst[k * 3 + 1] = restParticles[ii[k] * 4 + 1];
+						rdst[k * 3 + 2] = restParticles[ii[k] * 4 + 2];
+					}
+				}
+				if (doVelocities) {
+					float *vdst = vhnd.value(start).data();
+					for (GA_Size k = 0; k < count; ++k)memcpy(vdst + k * 3, velocities + ii[k] * 3, 3 * sizeof(float));
+				}
+				if (doIds) {
+					int32 *iiddst = &iidhnd.value(start);
+					for (GA_Size k = 0; k < count; ++k)iiddst[k] = ii[k];
+				}
+				if (doPhases) {
+					int32 *phsdst = &phshnd.value(start);
+					for (GA_Size k = 0; k < count; ++k)phsdst[k] = offsetPhaseGroup(phases[ii[k]], -phaseGroupOffset);
+				}
+				if (doMass) {
+					float *mdst = &mhnd.value(start);
+					for (GA_Size k = 0; k < count; ++k)mdst[k] = particles[ii[k] * 4 + 3];
+				}
+			}
+		}
+	});
+}
+
+bool syncPointsToParticles(GU_Detail *gdp, const int *activeIds, int nactives, int maxParticles, int *indices) {
+	const GA_Size npts = gdp->getNumPoints();
+	GA_ROHandleI iidhnd(gdp->findPointAttribute("iid"));
+	const std::vector<int> ids(activeIds, activeIds + nactives);
+
+	std::vector<char> active(maxParticles, 0);
+	for (int i = 0; i < nactives; ++i)active[ids[i]] = 1;
+	std::vector<char> taken(maxParticles, 0); //particle already has a point
+
+	//points are visited in index order, so kept ones end up in indices in the same order they stay in gdp
+	GA_OffsetList dead;
+	int nkept = 0;
+	for (GA_Index idx = 0; idx < npts; ++idx) {
+		const GA_Offset off = gdp->pointOffset(idx);
+		int iid = -1;
+		if (iidhnd.isValid())iid = iidhnd.get(off);
+		else if (idx < nactives)iid = ids[idx];
+		if (iid >= 0 && iid < maxParticles && active[iid] && !taken[iid]) {
+			taken[iid] = 1;
+			indices[nkept++] = iid;
+		}
+		else dead.append(off);
+	}
+
+	const int nnew = nactives - nkept;
+	if (dead.entries() == 0 && nnew == 0)return false;
+
+	if (dead.entries() > 0)gdp->destroyPointOffsets(GA_Range(gdp->getPointMap(), dead), GA_Detail::GA_DESTROY_DEGENERATE);
+	if (nnew > 0) {
+		gdp->appendPointBlock(nnew);
+		for (int i = 0; i < nactives; ++i) {
+			if (!taken[ids[i]])indices[nkept++] = ids[i];
+		}
+	}
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <string.h> //for memcpy in NvFlexExt.h
+#include <NvFlex.h>
+#include <NvFlexExt.h>
+
+//threaded copy helpers between houdini geometry and mapped NvFlex particle buffers
+//they do not call anything from Flex library, only write into already mapped host memory, so can be used without flex context
+
+//particle channels as they are stored on device. P and imass share one float4 buffer
+enum NvFlexHParticleChannel {
+	NVFLEXH_CHANNEL_NONE = 0,
+	NVFLEXH_CHANNEL_PARTICLES = 1 << 0, //P + imass
+	NVFLEXH_CHANNEL_REST = 1 << 1, //restP
+	NVFLEXH_CHANNEL_VELOCITIES = 1 << 2, //v
+	NVFLEXH_CHANNEL_PHASES = 1 << 3, //phs
+	NVFLEXH_CHANNEL_ALL = NVFLEXH_CHANNEL_PARTICLES | NVFLEXH_CHANNEL_REST | NVFLEXH_CHANNEL_VELOCITIES | NVFLEXH_CHANNEL_PHASES
+};
+
+//objects sharing one solver get their phase groups shifted by this much per object, so their groups don't mix
+//groups of one object are expected to stay below it
+#define NVFLEXH_SHARED_GROUP_STRIDE 1024
+
+//shifts group bits of a phase, flags are kept. same offset with minus sign shifts it back
+inline int offsetPhaseGroup(int phase, int groupOffset) {
+	return (phase & ~eNvFlexPhaseGroupMask) | ((phase + groupOffset) & eNvFlexPhaseGroupMask);
+}
+
+//copies P+imass, restP (if exists), v and phs of every point into particle slot indices[pointIndex]
+//only channels set in channels mask are written, others may be not mapped at all
+//channels in newChannels are written only into slots marked in newParticles (by particle id), the rest keep what they have
+//points with index >= nactives are skipped. all required attributes must exist on gdp.
+//each point writes only its own slot, so the result does not depend on the number of threads
+void pushGeoToParticles(const GU_Detail *gdp, const NvFlexExtParticleData &pdat, const int *indices, int nactives, int channels = NVFLEXH_CHANNEL_ALL, int phaseGroupOffset = 0,
+	int newChannels = NVFLEXH_CHANNEL_NONE, const char *newParticles = NULL);
+
+//makes gdp have one point per active particle without rebuilding it: points whose iid is no longer active are deleted,
+//active particles no point refers to get points appended at the end. other points keep all their attribute values
+//activeIds are sorted active particle ids (maxParticles is one past the largest possible id). without iid points are matched by index
+//activeIds and indices may be the same array
+//writes point index -> particle id into indices and returns true if any points were added or removed
+bool syncPointsToParticles(GU_Detail *gdp, const int *activeIds, int nactives, int maxParticles, int *indices);
+
+//writes particle positions, velocities, indices, phases and rest positions back into P, v, iid, phs and restP point attributes
+//P is written if particles are mapped, the rest only if both the attribute is given and its channel is mapped, iid if iidattr is given
+//imass comes from the particles channel too, it's only needed for points that did not have it before
+//works on whole GA pages in parallel. gdp must have exactly as many points as there are active particles
+void pullParticlesToGeo(GU_Detail *gdp, const NvFlexExtParticleData &pdat, const int *indices, GA_Attribute *vattr, GA_Attribute *iidattr, GA_Attribute *phsattr, GA_Attribute *restattr = NULL, GA_Attribute *imassattr = NULL, int phaseGroupOffset = 0);
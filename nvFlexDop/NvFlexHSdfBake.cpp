@@ -0,0 +1,82 @@
+#include <GEO/GEO_PrimVolume.h>
+#include <GEO/GEO_PrimVDB.h>
+#include <GU/GU_SDF.h>
+#include <UT/UT_ParallelUtil.h>
+
+#include "NvFlexHSdfBake.h"
+
+namespace {
+	const int sdfMarginCells = 2;
+
+	//samples dist(p) at cell centers, one z slab per task item
+	template<typename DIST>
+	void sampleField(int dim, const NvFlexHSdfFrame &frame, std::vector<float> &field, const DIST &dist) {
+		field.resize(size_t(dim)*dim*dim);
+		const float cell = frame.size / dim;
+		const float norm = 1.0f / frame.size;
+		UTparallelFor(UT_BlockedRange<int>(0, dim), [&](const UT_BlockedRange<int> &r) {
+			for (int z = r.begin(); z != r.end(); ++z) {
+				float *slab = field.data() + size_t(z)*dim*dim;
+				for (int y = 0; y < dim; ++y) {
+					for (int x = 0; x < dim; ++x) {
+						const UT_Vector3F p(frame.origin.x() + (x + 0.5f)*cell, frame.origin.y() + (y + 0.5f)*cell, frame.origin.z() + (z + 0.5f)*cell);
+						slab[y*dim + x] = float(dist(p))*norm;
+					}
+				}
+			}
+		});
+	}
+}
+
+const GEO_Primitive* findSdfVolume(const GU_Detail *gdp) {
+	for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+		const GEO_Primitive *prim = gdp->getGEOPrimitive(*it);
+		const GA_PrimitiveTypeId type = prim->getTypeId();
+		if (type == GA_PRIMVOLUME && static_cast<const GEO_PrimVolume*>(prim)->isSDF())return prim;
+		if (type == GA_PRIMVDB && static_cast<const GEO_PrimVDB*>(prim)->isSDF())return prim;
+	}
+	return NULL;
+}
+
+GA_Size colliderTriangleCount(const GU_Detail *gdp) {
+	GA_Size count = 0;
+	for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+		const GA_Size vtxcount = gdp->getPrimitiveVertexCount(*it);
+		if (vtxcount > 2)count += vtxcount - 2;
+	}
+	return count;
+}
+
+bool sdfFrame(const UT_BoundingBox &bounds, int dim, NvFlexHSdfFrame &frame) {
+	if (!bounds.isValid() || dim <= 2 * sdfMarginCells)return false;
+	const float extent = bounds.sizeMax();
+	if (extent <= 0)return false;
+	frame.size = extent*dim / float(dim - 2 * sdfMarginCells);
+	frame.origin = bounds.center() - UT_Vector3F(frame.size, frame.size, frame.size)*0.5f;
+	return true;
+}
+
+void sampleVolumeSdf(const GEO_Primitive *volume, int dim, const NvFlexHSdfFrame &frame, std::vector<float> &field) {
+	if (volume->getTypeId() == GA_PRIMVDB) {
+		const GEO_PrimVDB *vdb = static_cast<const GEO_PrimVDB*>(volume);
+		sampleField(dim, frame, field, [vdb](const UT_Vector3F &p) { return vdb->getValueF(p); });
+	}
+	else {
+		const GEO_PrimVolume *vol = static_cast<const GEO_PrimVolume*>(volume);
+		sampleField(dim, frame, field, [vol](const UT_Vector3F &p) { return vol->getValue(p); });
+	}
+}
+
+void bakeMeshSdf(const GU_Detail *gdp, int dim, const NvFlexHSdfFrame &frame, std::vector<float> &field) {
+	UT_BoundingBox cube;
+	cube.initBounds(frame.origin);
+	cube.enlargeBounds(frame.origin + UT_Vector3F(frame.size, frame.size, frame.size));
+
+	GU_SDFParms parms;
+	parms.setDivisions(dim, dim, dim);
+	parms.setBBox(cube);
+	parms.setMode(GU_SDFParms::RAY_INTERSECT); //signs by ray casting, copes with small holes in colliders
+	GU_SDF sdf;
+	sdf.build(gdp, parms);
+	sampleField(dim, frame, field, [&sdf](const UT_Vector3F &p) { return sdf.getDistance(p); });
+}
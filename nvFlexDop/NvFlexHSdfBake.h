@@ -0,0 +1,24 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_BoundingBox.h>
+
+#include <vector>
+
+//where a baked field sits in collider geometry space: flex fields cover a cube given by its lower corner and edge length
+struct NvFlexHSdfFrame {
+	UT_Vector3F origin;
+	float size;
+	NvFlexHSdfFrame() :origin(0, 0, 0), size(0) {}
+};
+
+//first sdf volume or vdb primitive of the collider, NULL if there is none
+const GEO_Primitive* findSdfVolume(const GU_Detail *gdp);
+//number of triangles the collider turns into as a triangle mesh
+GA_Size colliderTriangleCount(const GU_Detail *gdp);
+
+//cube around the bounds with a couple of cells of margin, so the surface never touches the field border
+bool sdfFrame(const UT_BoundingBox &bounds, int dim, NvFlexHSdfFrame &frame);
+
+//both fill dim^3 cell centered samples, x fastest, with distances already normalized by frame size
+void sampleVolumeSdf(const GEO_Primitive *volume, int dim, const NvFlexHSdfFrame &frame, std::vector<float> &field);
+void bakeMeshSdf(const GU_Detail *gdp, int dim, const NvFlexHSdfFrame &frame, std::vector<float> &field); //expensive, that's what disk cache is for
@@ -0,0 +1,240 @@
+#include <GEO/GEO_PrimSphere.h>
+#include <GEO/GEO_PrimTube.h>
+#include <UT/UT_Matrix3.h>
+#include <SYS/SYS_Math.h>
+#include <UT/UT_ParallelUtil.h>
+#include <GA/GA_SplittableRange.h>
+
+#include "NvFlexHShapeFit.h"
+
+#include <algorithm>
+
+namespace {
+	//quadric transform rows are its local axes, scale included
+	bool quadricAxes(const UT_Matrix3 &xform, float tolerance, UT_Vector3F axes[3], float lengths[3]) {
+		for (int i = 0; i < 3; ++i) {
+			axes[i] = UT_Vector3F(xform(i, 0), xform(i, 1), xform(i, 2));
+			lengths[i] = axes[i].length();
+			if (lengths[i] <= 0)return false;
+		}
+		//sheared quadrics are not something flex shapes can represent
+		for (int i = 0; i < 3; ++i) {
+			const int j = (i + 1) % 3;
+			if (SYSabs(dot(axes[i], axes[j])) > tolerance*lengths[i] * lengths[j])return false;
+		}
+		return true;
+	}
+
+	bool fitQuadric(const GEO_Primitive *prim, float tolerance, NvFlexHShapeFit &fit) {
+		const GA_PrimitiveTypeId type = prim->getTypeId();
+		if (type != GA_PRIMSPHERE && type != GA_PRIMTUBE)return false;
+
+		UT_Vector3F axes[3];
+		float lengths[3];
+		if (!quadricAxes(static_cast<const GEO_Quadric*>(prim)->getTransform(), tolerance, axes, lengths))return false;
+
+		if (type == GA_PRIMSPHERE) {
+			const float r = (lengths[0] + lengths[1] + lengths[2]) / 3;
+			for (int i = 0; i < 3; ++i)if (SYSabs(lengths[i] - r) > tolerance*r)return false;
+			fit.type = NVFLEXH_FIT_SPHERE;
+			fit.radius = r;
+		}
+		else {
+			const GEO_PrimTube *tube = static_cast<const GEO_PrimTube*>(prim);
+			if (SYSabs(tube->getTaper() - 1) > tolerance)return false;
+			//tube goes along its local y from -0.5 to 0.5, cross section has to be a circle
+			const float r = (lengths[0] + lengths[2]) / 2;
+			if (SYSabs(lengths[0] - lengths[2]) > tolerance*r)return false;
+			//tube ends are flat, capsule ends are round caps of radius r. only a tube long enough for that to not matter is a capsule
+			const float halfLength = lengths[1] * 0.5f;
+			if (r > tolerance*halfLength)return false;
+			fit.type = NVFLEXH_FIT_CAPSULE;
+			fit.radius = r;
+			fit.halfHeight = SYSmax(0.0f, halfLength - r);
+			fit.orientation.updateFromVectors(UT_Vector3F(1, 0, 0), axes[1] / lengths[1]);
+		}
+		fit.center = prim->baryCenter();
+		return true;
+	}
+
+	bool fitPolygons(const GU_Detail *gdp, float tolerance, NvFlexHShapeFit &fit) {
+		if (gdp->getNumPoints() < 8)return false;
+		double area = 0;
+		for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+			const GEO_Primitive *prim = gdp->getGEOPrimitive(*it);
+			if (prim->getTypeId() != GA_PRIMPOLY)return false;
+			area += prim->calcArea();
+		}
+
+		UT_Vector3F lo(SYS_FP32_MAX, SYS_FP32_MAX, SYS_FP32_MAX), hi(-SYS_FP32_MAX, -SYS_FP32_MAX, -SYS_FP32_MAX);
+		for (GA_Iterator it(gdp->getPointRange()); !it.atEnd(); ++it) {
+			const UT_Vector3F p = gdp->getPos3(*it);
+			for (int k = 0; k < 3; ++k) {
+				lo[k] = SYSmin(lo[k], p[k]);
+				hi[k] = SYSmax(hi[k], p[k]);
+			}
+		}
+		const UT_Vector3F size = hi - lo;
+		const float abstol = tolerance*size.length();
+		if (abstol <= 0)return false;
+
+		//box: every point on some bbox face, all 8 corners present, and surface area of a closed box
+		//area check is what throws out open containers and double walled stuff
+		bool box = true;
+		int corners = 0;
+		for (GA_Iterator it(gdp->getPointRange()); box && !it.atEnd(); ++it) {
+			const UT_Vector3F p = gdp->getPos3(*it);
+			float facedist = SYS_FP32_MAX;
+			int corner = 0;
+			bool iscorner = true;
+			for (int k = 0; k < 3; ++k) {
+				const float dlo = p[k] - lo[k], dhi = hi[k] - p[k];
+				facedist = SYSmin(facedist, SYSmin(dlo, dhi));
+				if (dhi <= abstol)corner |= 1 << k;
+				else if (dlo > abstol)iscorner = false;
+			}
+			if (facedist > abstol)box = false;
+			else if (iscorner)corners |= 1 << corner;
+		}
+		const double boxarea = 2.0*(size.x()*size.y() + size.y()*size.z() + size.z()*size.x());
+		if (box && corners == 0xff && SYSabs(area - boxarea) <= tolerance*boxarea) {
+			fit.type = NVFLEXH_FIT_BOX;
+			fit.center = (lo + hi)*0.5f;
+			fit.halfExtents = size*0.5f;
+			return true;
+		}
+
+		//sphere: all points at the same distance from bbox center, and bbox spans the whole diameter on every axis
+		const UT_Vector3F center = (lo + hi)*0.5f;
+		double rsum = 0;
+		for (GA_Iterator it(gdp->getPointRange()); !it.atEnd(); ++it)rsum += (gdp->getPos3(*it) - center).length();
+		const float r = float(rsum / gdp->getNumPoints());
+		if (r <= 0)return false;
+		for (int k = 0; k < 3; ++k)if (SYSabs(size[k] - 2 * r) > 2 * tolerance*r)return false;
+		for (GA_Iterator it(gdp->getPointRange()); !it.atEnd(); ++it) {
+			if (SYSabs((gdp->getPos3(*it) - center).length() - r) > tolerance*r)return false;
+		}
+		fit.type = NVFLEXH_FIT_SPHERE;
+		fit.center = center;
+		fit.radius = r;
+		return true;
+	}
+
+	struct FaceNormal {
+		UT_Vector3F n;
+		float area;
+	};
+
+	//max projection of all points on every direction, and point bounds on the way
+	class SupportReduce {
+	public:
+		SupportReduce(const GU_Detail *gdp, const std::vector<UT_Vector3F> &dirs) :_gdp(gdp), _dirs(dirs) { init(); }
+		SupportReduce(SupportReduce &src, UT_Split) :_gdp(src._gdp), _dirs(src._dirs) { init(); }
+
+		void operator()(const GA_SplittableRange &r) {
+			GA_Offset start, end;
+			for (GA_Iterator it(r); it.blockAdvance(start, end);) {
+				for (GA_Offset off = start; off < end; ++off) {
+					const UT_Vector3F p = _gdp->getPos3(off);
+					for (size_t i = 0; i < _dirs.size(); ++i)support[i] = SYSmax(support[i], dot(_dirs[i], p));
+					for (int k = 0; k < 3; ++k) {
+						lower[k] = SYSmin(lower[k], p[k]);
+						upper[k] = SYSmax(upper[k], p[k]);
+					}
+				}
+			}
+		}
+		void join(const SupportReduce &other) {
+			for (size_t i = 0; i < support.size(); ++i)support[i] = SYSmax(support[i], other.support[i]);
+			for (int k = 0; k < 3; ++k) {
+				lower[k] = SYSmin(lower[k], other.lower[k]);
+				upper[k] = SYSmax(upper[k], other.upper[k]);
+			}
+		}
+
+		std::vector<float> support;
+		UT_Vector3F lower, upper;
+
+	private:
+		void init() {
+			support.assign(_dirs.size(), -SYS_FP32_MAX);
+			lower.assign(SYS_FP32_MAX, SYS_FP32_MAX, SYS_FP32_MAX);
+			upper.assign(-SYS_FP32_MAX, -SYS_FP32_MAX, -SYS_FP32_MAX);
+		}
+		const GU_Detail *_gdp;
+		const std::vector<UT_Vector3F> &_dirs;
+	};
+}
+
+bool fitAnalyticShape(const GU_Detail *gdp, float tolerance, NvFlexHShapeFit &fit) {
+	fit = NvFlexHShapeFit();
+	if (gdp == NULL || gdp->getNumPrimitives() == 0)return false;
+	tolerance = SYSmax(tolerance, 0.0f);
+
+	if (gdp->getNumPrimitives() == 1) {
+		const GEO_Primitive *prim = gdp->getGEOPrimitive(gdp->primitiveOffset(GA_Index(0)));
+		if (fitQuadric(prim, tolerance, fit))return true;
+	}
+	if (fitPolygons(gdp, tolerance, fit))return true;
+	fit = NvFlexHShapeFit();
+	return false;
+}
+
+bool fitConvexPlanes(const GU_Detail *gdp, int maxPlanes, std::vector<UT_Vector4F> &planes, UT_Vector3F &lower, UT_Vector3F &upper) {
+	planes.clear();
+	if (gdp->getNumPoints() == 0)return false;
+
+	//fixed directions keep the polytope bounded whatever the faces are
+	std::vector<UT_Vector3F> dirs;
+	for (int x = -1; x <= 1; ++x) {
+		for (int y = -1; y <= 1; ++y) {
+			for (int z = -1; z <= 1; ++z) {
+				if (x == 0 && y == 0 && z == 0)continue;
+				UT_Vector3F d = UT_Vector3F(x, y, z);
+				d.normalize();
+				dirs.push_back(d);
+			}
+		}
+	}
+
+	//biggest faces first, so with a plane budget the ones that matter most for contacts make it in
+	std::vector<FaceNormal> faces(gdp->getNumPrimitives());
+	UTparallelFor(GA_SplittableRange(gdp->getPrimitiveRange()), [&](const GA_SplittableRange &r) {
+		GA_Offset start, end;
+		for (GA_Iterator it(r); it.blockAdvance(start, end);) {
+			for (GA_Offset off = start; off < end; ++off) {
+				const GEO_Primitive *prim = gdp->getGEOPrimitive(off);
+				FaceNormal &face = faces[gdp->primitiveIndex(off)];
+				if (prim->getTypeId() != GA_PRIMPOLY || gdp->getPrimitiveVertexCount(off) < 3) {
+					face.area = 0;
+					continue;
+				}
+				face.n = prim->computeNormal();
+				face.area = float(prim->calcArea());
+			}
+		}
+	});
+	UTparallelSort(faces.begin(), faces.end(), [](const FaceNormal &a, const FaceNormal &b) { return a.area > b.area; });
+
+	const float sameDirection = 0.9999f;
+	for (const FaceNormal &face : faces) {
+		if (int(dirs.size()) >= maxPlanes || face.area <= 0)break;
+		if (face.n.length2() < 0.5f)continue;
+		bool known = false;
+		for (const UT_Vector3F &d : dirs) {
+			if (dot(d, face.n) > sameDirection) {
+				known = true;
+				break;
+			}
+		}
+		if (!known)dirs.push_back(face.n);
+	}
+
+	SupportReduce body(gdp, dirs);
+	UTparallelReduce(GA_SplittableRange(gdp->getPointRange()), body);
+	planes.resize(dirs.size());
+	for (size_t i = 0; i < dirs.size(); ++i)planes[i] = UT_Vector4F(dirs[i].x(), dirs[i].y(), dirs[i].z(), -body.support[i]);
+	lower = body.lower;
+	upper = body.upper;
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_Quaternion.h>
+#include <UT/UT_Vector4.h>
+
+#include <vector>
+
+enum NvFlexHShapeFitType {
+	NVFLEXH_FIT_NONE = 0,
+	NVFLEXH_FIT_SPHERE,
+	NVFLEXH_FIT_CAPSULE,
+	NVFLEXH_FIT_BOX
+};
+
+//analytic stand-in for collider geometry, in collider geometry space
+struct NvFlexHShapeFit {
+	NvFlexHShapeFitType type;
+	UT_Vector3F center;
+	UT_QuaternionF orientation; //capsule lies along local x, as flex wants it
+	float radius; //sphere and capsule
+	float halfHeight; //capsule, caps not included
+	UT_Vector3F halfExtents; //box
+
+	NvFlexHShapeFit() :type(NVFLEXH_FIT_NONE), center(0, 0, 0), orientation(0, 0, 0, 1), radius(0), halfHeight(0), halfExtents(0, 0, 0) {}
+};
+
+//recognizes a single sphere or tube primitive, and polygonal boxes (axis aligned in geometry space) and spheres
+//tolerance is relative to the collider size. returns false if the geometry has to stay a triangle mesh
+bool fitAnalyticShape(const GU_Detail *gdp, float tolerance, NvFlexHShapeFit &fit);
+
+//convex polytope around collider points, as outward planes n.x*x + n.y*y + n.z*z + w = 0
+//support planes along 26 fixed directions, plus normals of the biggest faces up to maxPlanes in total
+//that's the exact hull for convex pieces with few faces, and a snug conservative bound for anything else. false for no points
+bool fitConvexPlanes(const GU_Detail *gdp, int maxPlanes, std::vector<UT_Vector4F> &planes, UT_Vector3F &lower, UT_Vector3F &upper);
@@ -0,0 +1,77 @@
+#include <GA/GA_Handle.h>
+#include <UT/UT_WorkBuffer.h>
+
+#include <cstdio>
+
+#include "NvFlexHStepStats.h"
+
+static const char* phaseNames[NVFLEXH_PHASE_COUNT] = { "ingest", "constraints", "collision", "params", "solve", "pull", "writeback" };
+
+NvFlexHStepStats::NvFlexHStepStats() :bytesUp(0), bytesDown(0), bufferAllocs(0) {
+	for (int i = 0; i < NVFLEXH_PHASE_COUNT; ++i)ms[i] = 0;
+}
+
+const char* NvFlexHStepStats::phaseName(int phase) {
+	return phase >= 0 && phase < NVFLEXH_PHASE_COUNT ? phaseNames[phase] : "unknown";
+}
+
+double NvFlexHStepStats::totalMs() const {
+	double total = 0;
+	for (int i = 0; i < NVFLEXH_PHASE_COUNT; ++i)total += ms[i];
+	return total;
+}
+
+void NvFlexHStepStats::add(const NvFlexHStepStats &other) {
+	for (int i = 0; i < NVFLEXH_PHASE_COUNT; ++i)ms[i] += other.ms[i];
+	bytesUp += other.bytesUp;
+	bytesDown += other.bytesDown;
+	bufferAllocs += other.bufferAllocs;
+}
+
+static void setDetailFloat(GU_Detail *gdp, const char *name, float value) {
+	GA_RWAttributeRef attr = gdp->findFloatTuple(GA_ATTRIB_GLOBAL, name, 1, 1);
+	if (!attr.isValid())attr = gdp->addFloatTuple(GA_ATTRIB_GLOBAL, name, 1);
+	GA_RWHandleF hnd(attr);
+	hnd.set(GA_Offset(0), value);
+	hnd.bumpDataId();
+}
+
+static void setDetailInt64(GU_Detail *gdp, const char *name, int64 value) {
+	GA_Attribute *attr = gdp->findGlobalAttribute(name);
+	if (attr == NULL)attr = gdp->addTuple(GA_STORE_INT64, GA_ATTRIB_GLOBAL, name, 1);
+	GA_RWHandleID hnd(attr);
+	hnd.set(GA_Offset(0), value);
+	hnd.bumpDataId();
+}
+
+void NvFlexHStepStats::writeDetailAttribs(GU_Detail *gdp, const char *prefix) const {
+	UT_WorkBuffer name;
+	for (int i = 0; i < NVFLEXH_PHASE_COUNT; ++i) {
+		name.sprintf("%s_%s_ms", prefix, phaseNames[i]);
+		setDetailFloat(gdp, name.buffer(), float(ms[i]));
+	}
+	name.sprintf("%s_total_ms", prefix);
+	setDetailFloat(gdp, name.buffer(), float(totalMs()));
+	name.sprintf("%s_bytes_up", prefix);
+	setDetailInt64(gdp, name.buffer(), bytesUp);
+	name.sprintf("%s_bytes_down", prefix);
+	setDetailInt64(gdp, name.buffer(), bytesDown);
+	name.sprintf("%s_buffer_allocs", prefix);
+	setDetailInt64(gdp, name.buffer(), bufferAllocs);
+}
+
+bool NvFlexHStepStats::appendCsv(const char *path, double time, const char *objname, int particles) const {
+	FILE *f = fopen(path, "a");
+	if (f == NULL)return false;
+	fseek(f, 0, SEEK_END);
+	if (ftell(f) == 0) {
+		fprintf(f, "time,object,particles");
+		for (int i = 0; i < NVFLEXH_PHASE_COUNT; ++i)fprintf(f, ",%s_ms", phaseNames[i]);
+		fprintf(f, ",total_ms,bytes_up,bytes_down,buffer_allocs\n");
+	}
+	fprintf(f, "%g,%s,%d", time, objname, particles);
+	for (int i = 0; i < NVFLEXH_PHASE_COUNT; ++i)fprintf(f, ",%.4f", ms[i]);
+	fprintf(f, ",%.4f,%lld,%lld,%lld\n", totalMs(), (long long)bytesUp, (long long)bytesDown, (long long)bufferAllocs);
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <GU/GU_Detail.h>
+
+#include <chrono>
+
+//where the time of one solver step goes, per object
+enum NvFlexHStepPhase {
+	NVFLEXH_PHASE_INGEST = 0, //geometry points into particle buffers and push
+	NVFLEXH_PHASE_CONSTRAINTS, //springs, triangles, rigids
+	NVFLEXH_PHASE_COLLISION,
+	NVFLEXH_PHASE_PARAMS,
+	NVFLEXH_PHASE_SOLVE, //NvFlexUpdateSolver only queues work on gpu, so most of the solve shows up in pull
+	NVFLEXH_PHASE_PULL,
+	NVFLEXH_PHASE_WRITEBACK,
+	NVFLEXH_PHASE_COUNT
+};
+
+struct NvFlexHStepStats {
+	double ms[NVFLEXH_PHASE_COUNT];
+	int64 bytesUp; //everything given to flex during the step
+	int64 bytesDown;
+	int64 bufferAllocs; //flex buffers that had to be reallocated
+
+	NvFlexHStepStats();
+	static const char* phaseName(int phase);
+	double totalMs() const;
+	//sums phases and bytes, for steps some of which are done once for several objects
+	void add(const NvFlexHStepStats &other);
+
+	//<prefix>_<phase>_ms, <prefix>_total_ms, <prefix>_bytes_up and <prefix>_bytes_down detail attributes
+	void writeDetailAttribs(GU_Detail *gdp, const char *prefix = "nvflex") const;
+	//appends a row, writing the header first if the file is new. returns false if it can't be opened
+	bool appendCsv(const char *path, double time, const char *objname, int particles) const;
+};
+
+//adds time from construction to stop() or destruction to one phase
+class NvFlexHPhaseTimer {
+public:
+	NvFlexHPhaseTimer(NvFlexHStepStats &stats, NvFlexHStepPhase phase) :_stats(&stats), _phase(phase), _start(std::chrono::steady_clock::now()) {}
+	NvFlexHPhaseTimer(const NvFlexHPhaseTimer&) = delete;
+	NvFlexHPhaseTimer& operator=(const NvFlexHPhaseTimer&) = delete;
+	~NvFlexHPhaseTimer() { stop(); }
+
+	void stop() {
+		if (_stats == NULL)return;
+		_stats->ms[_phase] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+		_stats = NULL;
+	}
+
+private:
+	NvFlexHStepStats *_stats;
+	NvFlexHStepPhase _phase;
+	std::chrono::steady_clock::time_point _start;
+};
@@ -0,0 +1,225 @@
+#include <GA/GA_Handle.h>
+#include <GA/GA_PageIterator.h>
+#include <GA/GA_SplittableRange.h>
+#include <UT/UT_ParallelUtil.h>
+
+#include "NvFlexHTopology.h"
+
+namespace {
+	enum PrimKind { PRIM_NONE, PRIM_SPRING, PRIM_TRIANGLE, PRIM_RIGID };
+
+	struct PageCounts {
+		GA_Size springs, triangles, rigids, rigidVerts;
+	};
+
+	inline PrimKind classify(const GU_Detail *gdp, const GA_ROHandleI &prgdhnd, GA_Offset off, GA_Size &vtxcount) {
+		vtxcount = gdp->getPrimitiveVertexCount(off);
+		if (prgdhnd.isValid() && prgdhnd.get(off))return PRIM_RIGID;
+		if (vtxcount == 2)return PRIM_SPRING;
+		if (vtxcount == 3)return PRIM_TRIANGLE;
+		return PRIM_NONE;
+	}
+
+	//calls op(offset) for each primitive, every GA page is handled by one task only
+	template<typename OP>
+	void forEachPrimPage(const GU_Detail *gdp, const OP &op) {
+		UTparallelFor(GA_SplittableRange(gdp->getPrimitiveRange()), [&](const GA_SplittableRange &r) {
+			for (GA_PageIterator pit = r.beginPages(); !pit.atEnd(); ++pit) {
+				GA_Offset start, end;
+				for (GA_Iterator it(pit.begin()); it.blockAdvance(start, end);) {
+					op(GAgetPageNum(start), start, end);
+				}
+			}
+		});
+	}
+}
+
+NvFlexHTopologyPlan::NvFlexHTopologyPlan() :_topologyId(-1), _rigidAttribId(-1), _activeVersion(-1) {}
+
+bool NvFlexHTopologyPlan::isValid(int64 topologyId, int64 rigidAttribId, int64 activeVersion) const {
+	return _topologyId != -1 && _topologyId == topologyId && _rigidAttribId == rigidAttribId && _activeVersion == activeVersion;
+}
+
+void NvFlexHTopologyPlan::invalidate() {
+	_topologyId = -1;
+}
+
+void NvFlexHTopologyPlan::build(const GU_Detail *gdp, const int *indices, int64 topologyId, int64 rigidAttribId, int64 activeVersion) {
+	GA_ROHandleI prgdhnd(gdp->findPrimitiveAttribute("rgd_isrigid"));
+	const GA_Size npages = (GA_Size(gdp->getPrimitiveMap().offsetSize()) + GA_PAGE_SIZE - 1) >> GA_PAGE_BITS;
+
+	//first pass: count every kind per page
+	std::vector<PageCounts> counts(npages, PageCounts{ 0, 0, 0, 0 });
+	forEachPrimPage(gdp, [&](GA_PageNum page, GA_Offset start, GA_Offset end) {
+		PageCounts &c = counts[page];
+		for (GA_Offset off = start; off < end; ++off) {
+			GA_Size vtxcount;
+			switch (classify(gdp, prgdhnd, off, vtxcount)) {
+			case PRIM_SPRING: ++c.springs; break;
+			case PRIM_TRIANGLE: ++c.triangles; break;
+			case PRIM_RIGID: ++c.rigids; c.rigidVerts += vtxcount; break;
+			default: break;
+			}
+		}
+	});
+
+	//exclusive prefix sums turn page counts into page starting slots
+	PageCounts total{ 0, 0, 0, 0 };
+	for (PageCounts &c : counts) {
+		PageCounts base = total;
+		total.springs += c.springs;
+		total.triangles += c.triangles;
+		total.rigids += c.rigids;
+		total.rigidVerts += c.rigidVerts;
+		c = base;
+	}
+
+	springPrims.resize(total.springs);
+	springIds.resize(total.springs * 2);
+	trianglePrims.resize(total.triangles);
+	triangleIds.resize(total.triangles * 3);
+	triangleVertices.resize(total.triangles * 3);
+	rigidPrims.resize(total.rigids);
+	rigidOffsets.resize(total.rigids + 1);
+	rigidIds.resize(total.rigidVerts);
+	rigidVertices.resize(total.rigidVerts);
+	rigidOffsets[total.rigids] = int(total.rigidVerts);
+
+	//second pass: fill slots, order inside a kind is primitive offset order
+	forEachPrimPage(gdp, [&](GA_PageNum page, GA_Offset start, GA_Offset end) {
+		PageCounts &c = counts[page]; //block ranges of one page come in order, so we just keep advancing its cursors
+		for (GA_Offset off = start; off < end; ++off) {
+			GA_Size vtxcount;
+			const PrimKind kind = classify(gdp, prgdhnd, off, vtxcount);
+			if (kind == PRIM_NONE)continue;
+			GA_OffsetListRef vtxs = gdp->getPrimitiveVertexList(off);
+			if (kind == PRIM_SPRING) {
+				springPrims[c.springs] = off;
+				for (int i = 0; i < 2; ++i)springIds[c.springs * 2 + i] = indices[gdp->pointIndex(gdp->vertexPoint(vtxs(i)))];
+				++c.springs;
+			}
+			else if (kind == PRIM_TRIANGLE) {
+				trianglePrims[c.triangles] = off;
+				for (int i = 0; i < 3; ++i) {
+					triangleVertices[c.triangles * 3 + i] = vtxs(i);
+					triangleIds[c.triangles * 3 + i] = indices[gdp->pointIndex(gdp->vertexPoint(vtxs(i)))];
+				}
+				++c.triangles;
+			}
+			else {
+				rigidPrims[c.rigids] = off;
+				rigidOffsets[c.rigids] = int(c.rigidVerts);
+				for (GA_Size i = 0; i < vtxcount; ++i) {
+					rigidVertices[c.rigidVerts] = vtxs(i);
+					rigidIds[c.rigidVerts] = indices[gdp->pointIndex(gdp->vertexPoint(vtxs(i)))];
+					++c.rigidVerts;
+				}
+				++c.rigids;
+			}
+		}
+	});
+
+	_topologyId = topologyId;
+	_rigidAttribId = rigidAttribId;
+	_activeVersion = activeVersion;
+}
+
+std::vector<int> NvFlexHTopologyPlan::rigidSizes() const {
+	std::vector<int> sizes(rigidCount());
+	for (size_t i = 0; i < sizes.size(); ++i)sizes[i] = rigidOffsets[i + 1] - rigidOffsets[i];
+	return sizes;
+}
+
+short NvFlexHTopologyPlan::triangleNormalType(const GU_Detail *gdp) {
+	if (gdp->findPrimitiveAttribute("N") != NULL)return 3;
+	if (gdp->findVertexAttribute("N") != NULL)return 2;
+	if (gdp->findPointAttribute("N") != NULL)return 1;
+	return 0;
+}
+
+void NvFlexHTopologyPlan::writeSprings(const GU_Detail *gdp, int *outIds, float *restLengths, float *strengths) const {
+	GA_ROHandleF rlhnd(gdp->findPrimitiveAttribute("restlength"));
+	GA_ROHandleF sthnd(gdp->findPrimitiveAttribute("strength"));
+	if (outIds != NULL)memcpy(outIds, springIds.data(), springIds.size() * sizeof(int));
+	UTparallelForLightItems(UT_BlockedRange<GA_Size>(0, springCount()), [&](const UT_BlockedRange<GA_Size> &r) {
+		for (GA_Size i = r.begin(); i != r.end(); ++i) {
+			if (restLengths != NULL)restLengths[i] = rlhnd.get(springPrims[i]);
+			if (strengths != NULL)strengths[i] = sthnd.get(springPrims[i]);
+		}
+	});
+}
+
+void NvFlexHTopologyPlan::writeTriangles(const GU_Detail *gdp, int *outIds, float *normals) const {
+	memcpy(outIds, triangleIds.data(), triangleIds.size() * sizeof(int));
+	const short triNormalType = normals == NULL ? 0 : triangleNormalType(gdp);
+	if (triNormalType == 0)return;
+
+	GA_ROHandleV3 nphnd(gdp->findPointAttribute("N"));
+	GA_ROHandleV3 nvhnd(gdp->findVertexAttribute("N"));
+	GA_ROHandleV3 nrhnd(gdp->findPrimitiveAttribute("N"));
+	UTparallelForLightItems(UT_BlockedRange<GA_Size>(0, triangleCount()), [&](const UT_BlockedRange<GA_Size> &r) {
+		for (GA_Size i = r.begin(); i != r.end(); ++i) {
+			const GA_Offset *vtx = triangleVertices.data() + i * 3;
+			UT_Vector3F n;
+			if (triNormalType == 1) {
+				n = nphnd.get(gdp->vertexPoint(vtx[0]));
+				n += nphnd.get(gdp->vertexPoint(vtx[1]));
+				n += nphnd.get(gdp->vertexPoint(vtx[2]));
+				n.normalize();
+			}
+			else if (triNormalType == 2) {
+				n = nvhnd.get(vtx[0]);
+				n += nvhnd.get(vtx[1]);
+				n += nvhnd.get(vtx[2]);
+				n.normalize();
+			}
+			else {
+				n = nrhnd.get(trianglePrims[i]);
+			}
+			normals[i * 3 + 0] = n.x();
+			normals[i * 3 + 1] = n.y();
+			normals[i * 3 + 2] = n.z();
+		}
+	});
+}
+
+void NvFlexHTopologyPlan::writeRigids(const GU_Detail *gdp, int *offsets, int *outIds, float *restPositions, float *restNormals, float *stiffness, float *rotations, float *translations) const {
+	GA_ROHandleV3 prtrshnd(gdp->findPrimitiveAttribute("rgd_translation"));
+	GA_ROHandleV4 prrothnd(gdp->findPrimitiveAttribute("rgd_rotation"));
+	GA_ROHandleV3 vrrsphnd(gdp->findVertexAttribute("rgd_restP"));
+	GA_ROHandleV3 vrrsnhnd(gdp->findVertexAttribute("rgd_restN"));
+	GA_ROHandleF vrsdfhnd(gdp->findVertexAttribute("rgd_sdf"));
+	GA_ROHandleF prstfhnd(gdp->findPrimitiveAttribute("rgd_stiffness"));
+
+	memcpy(offsets, rigidOffsets.data(), rigidOffsets.size() * sizeof(int));
+	memcpy(outIds, rigidIds.data(), rigidIds.size() * sizeof(int));
+	UTparallelForLightItems(UT_BlockedRange<GA_Size>(0, rigidIndicesCount()), [&](const UT_BlockedRange<GA_Size> &r) {
+		for (GA_Size i = r.begin(); i != r.end(); ++i) {
+			const GA_Offset vtxoff = rigidVertices[i];
+			UT_Vector3F vrestP = vrrsphnd.get(vtxoff);
+			UT_Vector3F vrestN = vrrsnhnd.get(vtxoff);
+			restPositions[i * 3 + 0] = vrestP.x();
+			restPositions[i * 3 + 1] = vrestP.y();
+			restPositions[i * 3 + 2] = vrestP.z();
+			restNormals[i * 4 + 0] = vrestN.x();
+			restNormals[i * 4 + 1] = vrestN.y();
+			restNormals[i * 4 + 2] = vrestN.z();
+			restNormals[i * 4 + 3] = vrsdfhnd.get(vtxoff);
+		}
+	});
+	UTparallelForLightItems(UT_BlockedRange<GA_Size>(0, rigidCount()), [&](const UT_BlockedRange<GA_Size> &r) {
+		for (GA_Size i = r.begin(); i != r.end(); ++i) {
+			const GA_Offset off = rigidPrims[i];
+			UT_Vector3F ptrs = prtrshnd.get(off);
+			UT_Vector4F prot = prrothnd.get(off);
+			stiffness[i] = prstfhnd.get(off);
+			translations[i * 3 + 0] = ptrs.x();
+			translations[i * 3 + 1] = ptrs.y();
+			translations[i * 3 + 2] = ptrs.z();
+			rotations[i * 4 + 0] = prot.x();
+			rotations[i * 4 + 1] = prot.y();
+			rotations[i * 4 + 2] = prot.z();
+			rotations[i * 4 + 3] = prot.w();
+		}
+	});
+}
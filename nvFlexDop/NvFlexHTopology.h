@@ -0,0 +1,51 @@
+#pragma once
+#include <GU/GU_Detail.h>
+
+#include <vector>
+
+//cached split of geometry primitives into flex springs, triangles and rigids with particle ids already resolved
+//depends only on topology, rgd_isrigid and the particle index map, so it's kept until one of those changes
+class NvFlexHTopologyPlan {
+public:
+	NvFlexHTopologyPlan();
+
+	bool isValid(int64 topologyId, int64 rigidAttribId, int64 activeVersion) const;
+	void invalidate();
+
+	//classifies all primitives in parallel, indices maps point index to particle id
+	void build(const GU_Detail *gdp, const int *indices, int64 topologyId, int64 rigidAttribId, int64 activeVersion);
+
+	GA_Size springCount() const { return springPrims.size(); }
+	GA_Size triangleCount() const { return trianglePrims.size(); }
+	GA_Size rigidCount() const { return rigidPrims.size(); }
+	GA_Size rigidIndicesCount() const { return rigidIds.size(); }
+	std::vector<int> rigidSizes() const;
+
+	//0 - no normals, 1 - point N, 2 - vertex N, 3 - primitive N
+	static short triangleNormalType(const GU_Detail *gdp);
+
+	//these fill already mapped flex buffers from current attribute values. springs need restlength and strength
+	//writeSprings skips any of its arrays passed as NULL, so restlength/strength can be rewritten without indices
+	void writeSprings(const GU_Detail *gdp, int *springIds, float *restLengths, float *strengths) const;
+	void writeTriangles(const GU_Detail *gdp, int *triangleIds, float *normals) const; //normals can be NULL
+	void writeRigids(const GU_Detail *gdp, int *offsets, int *indices, float *restPositions, float *restNormals, float *stiffness, float *rotations, float *translations) const;
+
+public:
+	//slot -> primitive offset, in primitive offset order
+	std::vector<GA_Offset> springPrims;
+	std::vector<GA_Offset> trianglePrims;
+	std::vector<GA_Offset> rigidPrims;
+
+	//resolved particle ids
+	std::vector<int> springIds; //2 per spring
+	std::vector<int> triangleIds; //3 per triangle
+	std::vector<GA_Offset> triangleVertices; //3 per triangle, for vertex normals
+	std::vector<int> rigidOffsets; //rigidCount+1
+	std::vector<int> rigidIds;
+	std::vector<GA_Offset> rigidVertices; //same layout as rigidIds, for rest attributes
+
+private:
+	int64 _topologyId;
+	int64 _rigidAttribId;
+	int64 _activeVersion;
+};
@@ -1,4 +1,5 @@
 #include "NvFlexHTriangleMesh.h"
+#include "utils.h"
 
 
 
@@ -20,15 +21,28 @@ NvFlexTriangleMeshId NvFlexHTriangleMesh::getId() const {
 	return id;
 }
 
-void NvFlexHTriangleMesh::loadData(const Vec3* verts, const int* tris, int vertcount, int triscount) {
+void NvFlexHTriangleMesh::loadData(const Vec3* verts, const int* tris, int vertcount, int triscount, const float* lower, const float* upper) {
 	mapall();
 
 	vertvec.resize(vertcount);
 	trivec.resize(triscount * 3);
 	memcpy(vertvec.mappedPtr, verts, vertcount * sizeof(Vec3));
 	memcpy(trivec.mappedPtr, tris, triscount * 3 * sizeof(int));
+	memcpy(this->lower, lower, 3 * sizeof(float));
+	memcpy(this->upper, upper, 3 * sizeof(float));
 
 	unmapall();
+	updateNvBuffers();
+}
+
+void NvFlexHTriangleMesh::updateVertices(const Vec3* verts, int vertcount, const float* lower, const float* upper) {
+	vertvec.map();
+	vertvec.resize(vertcount);
+	memcpy(vertvec.mappedPtr, verts, vertcount * sizeof(Vec3));
+	memcpy(this->lower, lower, 3 * sizeof(float));
+	memcpy(this->upper, upper, 3 * sizeof(float));
+	vertvec.unmap();
+	updateNvBuffers();
 }
 
 void NvFlexHTriangleMesh::mapall() {
@@ -43,4 +57,90 @@ void NvFlexHTriangleMesh::unmapall() {
 
 void NvFlexHTriangleMesh::updateNvBuffers() {
 	NvFlexUpdateTriangleMesh(vertvec.lib, id, vertvec.buffer, trivec.buffer, vertvec.size(), trivec.size() / 3, lower, upper);
-}
\ No newline at end of file
+}
+
+//mesh cache
+NvFlexHTriangleMeshCache& NvFlexHTriangleMeshCache::instance() {
+	static NvFlexHTriangleMeshCache cache;
+	return cache;
+}
+
+NvFlexHTriangleMeshCache::~NvFlexHTriangleMeshCache() {
+	//library is gone by now, so just forget the meshes
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)it->second.mesh = NULL;
+}
+
+uint64 NvFlexHTriangleMeshCache::trianglesHash(const int* tris, int triscount) {
+	uint64 h = 0xcbf29ce484222325ULL;
+	h = hashBytes(h, &triscount, sizeof(triscount));
+	return hashBytes(h, tris, triscount * 3 * sizeof(int));
+}
+
+uint64 NvFlexHTriangleMeshCache::contentHash(const Vec3* verts, int vertcount, uint64 trianglesHash) {
+	uint64 h = hashBytes(trianglesHash, &vertcount, sizeof(vertcount));
+	return hashBytes(h, verts, vertcount * sizeof(Vec3));
+}
+
+NvFlexHTriangleMeshCache::EntryMap::iterator NvFlexHTriangleMeshCache::find(uint64 hash, int vertcount, int triscount) {
+	auto range = _entries.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.vertcount == vertcount && it->second.triscount == triscount)return it;
+	}
+	return _entries.end();
+}
+
+NvFlexHTriangleMeshCache::EntryMap::iterator NvFlexHTriangleMeshCache::find(uint64 hash, const NvFlexHTriangleMesh* mesh) {
+	auto range = _entries.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.mesh == mesh)return it;
+	}
+	return _entries.end();
+}
+
+NvFlexHTriangleMesh* NvFlexHTriangleMeshCache::acquire(NvFlexLibrary* lib, uint64 hash, const Vec3* verts, const int* tris, int vertcount, int triscount, const float* lower, const float* upper, bool *missed) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = find(hash, vertcount, triscount);
+	if (missed != NULL)*missed = it == _entries.end();
+	if (it != _entries.end()) {
+		++it->second.refs;
+		++_hits;
+		return it->second.mesh;
+	}
+	++_misses;
+	NvFlexHTriangleMesh* mesh = new NvFlexHTriangleMesh(lib);
+	mesh->loadData(verts, tris, vertcount, triscount, lower, upper);
+	_entries.emplace(hash, Entry{ mesh, 1, vertcount, triscount });
+	return mesh;
+}
+
+void NvFlexHTriangleMeshCache::release(uint64 hash, const NvFlexHTriangleMesh* mesh) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = find(hash, mesh);
+	if (it == _entries.end())return;
+	if (--it->second.refs > 0)return;
+	delete it->second.mesh;
+	_entries.erase(it);
+}
+
+NvFlexHTriangleMesh* NvFlexHTriangleMeshCache::updateVertices(uint64 oldHash, NvFlexHTriangleMesh* mesh, uint64 newHash, const Vec3* verts, int vertcount, const float* lower, const float* upper) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = find(oldHash, mesh);
+	if (it == _entries.end() || it->second.refs > 1 || it->second.vertcount != vertcount || find(newHash, vertcount, it->second.triscount) != _entries.end())return NULL;
+	Entry entry = it->second;
+	_entries.erase(it);
+	entry.mesh->updateVertices(verts, vertcount, lower, upper);
+	_entries.emplace(newHash, entry);
+	++_inPlaceUpdates;
+	return entry.mesh;
+}
+
+void NvFlexHTriangleMeshCache::clear() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)delete it->second.mesh;
+	_entries.clear();
+}
+
+exint NvFlexHTriangleMeshCache::size() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
@@ -1,9 +1,16 @@
 #pragma once
+#include <SYS/SYS_Types.h>
 #include <string.h> // for memcpy required in NvFlexExt.h
 #include <NvFlex.h>
 #include <NvFlexExt.h>
 #include <../core/maths.h>
 
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "NvFlexHVector.h"
+
 
 class NvFlexHTriangleMesh
 {
@@ -14,7 +21,8 @@ public:
 	~NvFlexHTriangleMesh();
 
 	NvFlexTriangleMeshId getId()const;
-	void loadData(const Vec3* verts, const int* tris, int vertcount, int triscount);
+	void loadData(const Vec3* verts, const int* tris, int vertcount, int triscount, const float* lower, const float* upper); //also pushes to flex
+	void updateVertices(const Vec3* verts, int vertcount, const float* lower, const float* upper); //triangles stay as they are, also pushes to flex
 	
 	void mapall();
 	void unmapall();
@@ -25,8 +33,8 @@ private:
 	friend class NvFlexHTriangleMeshAutoMapper;
 
 	NvFlexTriangleMeshId id;
-	NvFlexVector<Vec3> vertvec;
-	NvFlexVector<int> trivec;
+	NvFlexHVector<Vec3> vertvec;
+	NvFlexHVector<int> trivec;
 	float lower[3];
 	float upper[3];
 };
@@ -51,3 +59,51 @@ public:
 private:
 	NvFlexHTriangleMesh& mesh;
 };
+
+
+//library wide cache of triangle meshes keyed by content hash of vertices and triangles
+//same collider used by several containers (or several dop networks) is built and uploaded only once
+class NvFlexHTriangleMeshCache {
+public:
+	static NvFlexHTriangleMeshCache& instance();
+
+	//content hash is vertices hash combined with triangles hash, so triangles of deforming meshes are hashed only once
+	static uint64 trianglesHash(const int* tris, int triscount);
+	static uint64 contentHash(const Vec3* verts, int vertcount, uint64 trianglesHash);
+
+	//returns cached mesh with this hash and counts, or creates and uploads a new one. every acquire must be paired with a release
+	//a hash collision with different counts is a miss, both meshes are kept under the same hash
+	//missed (if given) tells if it was uploaded by this call
+	NvFlexHTriangleMesh* acquire(NvFlexLibrary* lib, uint64 hash, const Vec3* verts, const int* tris, int vertcount, int triscount, const float* lower, const float* upper, bool *missed = NULL);
+	void release(uint64 hash, const NvFlexHTriangleMesh* mesh); //mesh is destroyed when last user releases it, so cuda context must be acquired
+	//for deforming meshes: if the only user of mesh moves its vertices, mesh is refreshed in place and re-keyed from oldHash to newHash
+	//returns NULL if mesh is shared or newHash is already cached, then go with acquire/release
+	NvFlexHTriangleMesh* updateVertices(uint64 oldHash, NvFlexHTriangleMesh* mesh, uint64 newHash, const Vec3* verts, int vertcount, const float* lower, const float* upper);
+
+	void clear(); //for library shutdown, destroys everything regardless of references
+
+	exint getHitCount() const { return _hits; }
+	exint getMissCount() const { return _misses; }
+	exint getInPlaceUpdateCount() const { return _inPlaceUpdates; }
+	exint size() const;
+
+private:
+	NvFlexHTriangleMeshCache() :_hits(0), _misses(0), _inPlaceUpdates(0) {}
+	~NvFlexHTriangleMeshCache();
+
+	struct Entry {
+		NvFlexHTriangleMesh* mesh;
+		int refs;
+		int vertcount; //checked on a hash hit, so a collision never hands out the wrong mesh
+		int triscount;
+	};
+	typedef std::unordered_multimap<uint64, Entry> EntryMap;
+	EntryMap::iterator find(uint64 hash, int vertcount, int triscount);
+	EntryMap::iterator find(uint64 hash, const NvFlexHTriangleMesh* mesh);
+	EntryMap _entries;
+	mutable std::mutex _mutex;
+	//counters are read without the lock
+	std::atomic<exint> _hits;
+	std::atomic<exint> _misses;
+	std::atomic<exint> _inPlaceUpdates;
+};
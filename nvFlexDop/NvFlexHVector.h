@@ -0,0 +1,89 @@
+#pragma once
+#include <SYS/SYS_Types.h>
+#include <string.h>
+#include <NvFlex.h>
+
+#include <algorithm>
+#include <climits>
+
+#include "NvFlexHBufferPool.h"
+
+#define NVFLEXH_VECTOR_MIN_CAPACITY 64
+//resizes in a row to under a quarter of capacity before a vector shrinks, so counts going up and down a bit don't reallocate
+#define NVFLEXH_VECTOR_SHRINK_DELAY 8
+
+//drop-in for NvFlexVector with capacity kept apart from size. grows at least twice, shrinks only when it's been mostly empty for a while,
+//and gets and gives its buffers through NvFlexHBufferPool. same mapping rules: resize keeps contents only if mapped, and leaves a new buffer mapped
+template<typename T>
+class NvFlexHVector {
+public:
+	explicit NvFlexHVector(NvFlexLibrary* l) :lib(l), buffer(NULL), mappedPtr(NULL), _count(0), _capacity(0), _underused(0), _allocs(0) {}
+	NvFlexHVector(const NvFlexHVector&) = delete;
+	NvFlexHVector& operator=(const NvFlexHVector&) = delete;
+	~NvFlexHVector() { destroy(); }
+
+	NvFlexLibrary* const lib;
+	NvFlexBuffer* buffer;
+	T* mappedPtr;
+
+	void destroy() {
+		if (buffer == NULL)return;
+		unmap();
+		NvFlexHBufferPool::instance().recycle(lib, buffer, _capacity, sizeof(T));
+		buffer = NULL;
+		_count = 0;
+		_capacity = 0;
+		_underused = 0;
+	}
+	void map(int flags = eNvFlexMapWait) {
+		if (buffer == NULL)return;
+		mappedPtr = (T*)NvFlexMap(buffer, flags);
+	}
+	void unmap() {
+		if (buffer == NULL || mappedPtr == NULL)return;
+		NvFlexUnmap(buffer);
+		mappedPtr = NULL;
+	}
+
+	void resize(int newCount) {
+		int capacity = _capacity;
+		if (newCount > _capacity) {
+			capacity = std::max(NVFLEXH_VECTOR_MIN_CAPACITY, int(std::min(std::max(int64(newCount), int64(_capacity) * 2), int64(INT_MAX / sizeof(T)))));
+			_underused = 0;
+		}
+		else if (newCount < _capacity / 4 && _capacity > NVFLEXH_VECTOR_MIN_CAPACITY) {
+			if (++_underused >= NVFLEXH_VECTOR_SHRINK_DELAY)capacity = std::max(NVFLEXH_VECTOR_MIN_CAPACITY, newCount * 2);
+		}
+		else _underused = 0;
+		if (capacity != _capacity)reallocate(capacity, std::min(_count, newCount));
+		_count = newCount;
+	}
+
+	T& operator[](int index) { return mappedPtr[index]; }
+	const T& operator[](int index) const { return mappedPtr[index]; }
+	int size() const { return _count; }
+	bool empty() const { return _count == 0; }
+	int getCapacity() const { return _capacity; }
+	exint getAllocCount() const { return _allocs; } //times this vector had to take another buffer
+
+private:
+	void reallocate(int capacity, int keep) {
+		NvFlexBuffer *newBuffer = NvFlexHBufferPool::instance().acquire(lib, capacity, sizeof(T));
+		T *newPtr = (T*)NvFlexMap(newBuffer, eNvFlexMapWait);
+		if (buffer != NULL) {
+			if (keep > 0 && mappedPtr != NULL)memcpy(newPtr, mappedPtr, sizeof(T) * keep);
+			unmap();
+			NvFlexHBufferPool::instance().recycle(lib, buffer, _capacity, sizeof(T));
+		}
+		buffer = newBuffer;
+		mappedPtr = newPtr;
+		_capacity = capacity;
+		_underused = 0;
+		++_allocs;
+	}
+
+	int _count;
+	int _capacity;
+	int _underused;
+	exint _allocs;
+};
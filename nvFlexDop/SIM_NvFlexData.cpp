@@ -1,38 +1,28 @@
 #include <PRM/PRM_Template.h>
 #include <PRM/PRM_Default.h>
+#include <PRM/PRM_Range.h>
 #include <NvFlexDevice.h>
 
-#include <cuda.h>
+#include <algorithm>
+#include <climits>
 
 #include "utils.h"
 
 #include "SIM_NvFlexData.h"
+#include "NvFlexHContainerPool.h"
 
 static void CreateFluidParticleGrid(NvFlexExtParticleData& ptd, int* indices, Vec3 lower, int dimx, int dimy, int dimz, float radius, Vec3 velocity, float invMass, int phase, float jitter = 0.005f);
 
-static uint cudaContextAcquiredCount = 0;
-static bool cudaExplicitlyInitizlized = false;
-
-bool acquireCudaContext() {
-	if (SIM_NvFlexData::nvFlexLibrary == NULL)return false;
-	NvFlexAcquireContext(SIM_NvFlexData::nvFlexLibrary);
-	++cudaContextAcquiredCount;
-	return true;
-}
-
-bool releaseCudaContext() {
-	if (SIM_NvFlexData::nvFlexLibrary==NULL || cudaContextAcquiredCount==0)return false;
-	NvFlexRestoreContext(SIM_NvFlexData::nvFlexLibrary);
-	--cudaContextAcquiredCount;
-	return true;
-}
-
 void SIM_NvFlexData::initializeSubclass() {
 	SIM_Data::initializeSubclass();
 	_lastGdpPId = -1;
 	_lastGdpVId = -1;
 	_lastGdpTId = -1;
 	_lastGdpStrId = -1;
+	_lastGdpRlId = -1;
+	_lastGdpIMassId = -1;
+	_lastGdpPhsId = -1;
+	_lastGdpRestId = -1;
 
 	
 
@@ -63,18 +53,20 @@ void SIM_NvFlexData::setParametersSubclass(const SIM_Options & parms) {
 	
 	int ptsmaxcount = getMaxPtsCount();
 	if (_prevMaxPts == ptsmaxcount)return;
+	if (_restored && nvdata) { //options may be set after load, restored container already is of the size it was simulated with
+		_prevMaxPts = ptsmaxcount;
+		return;
+	}
 
 	try {
-		acquireCudaContext();
-		nvdata.reset(new NvFlexContainerWrapper(SIM_NvFlexData::nvFlexLibrary, ptsmaxcount, 0));
-		releaseCudaContext();
-		_indices.reset(new int[ptsmaxcount]);
+		resetContainer(createContainer(initialParticleCount()), -1);
 	}
 	catch (...) {
 		messageLog(1, "nvflex data initialization failed!\n");
 		_valid = false;
 		nvdata.reset();
 		_indices.reset();
+		_topology.reset();
 		return;
 	}
 	_prevMaxPts = ptsmaxcount;
@@ -92,26 +84,47 @@ void SIM_NvFlexData::makeEqualSubclass(const SIM_Data* source) {
 	}
 	nvdata = src->nvdata;
 	_indices = src->_indices;
+	_indicesSize = src->_indicesSize;
+	_indicesVersion = src->_indicesVersion;
+	_nactives = src->_nactives;
+	_topology = src->_topology;
+	_range = src->_range;
+	_restored = src->_restored;
+	_stateStep = src->_stateStep;
+	_geoChannels = src->_geoChannels;
+	_springBase = src->_springBase;
+	_springCount = src->_springCount;
+	_triangleBase = src->_triangleBase;
+	_triangleCount = src->_triangleCount;
+	_rigidBase = src->_rigidBase;
+	_rigidCount = src->_rigidCount;
+	_rigidIndexBase = src->_rigidIndexBase;
 	_lastGdpPId = src->_lastGdpPId;
 	_lastGdpVId = src->_lastGdpVId;
 	_lastGdpTId = src->_lastGdpTId;
 	_lastGdpStrId = src->_lastGdpStrId;
+	_lastGdpRlId = src->_lastGdpRlId;
+	_lastGdpIMassId = src->_lastGdpIMassId;
+	_lastGdpPhsId = src->_lastGdpPhsId;
+	_lastGdpRestId = src->_lastGdpRestId;
 	_prevMaxPts = src->_prevMaxPts;
 	_valid = _valid && src->_valid;
 	if (!_valid) {
 		messageLog(6, "makeEqual data was invalid\n");;
 		nvdata.reset();
 		_indices.reset();
+		_topology.reset();
 	}
 }
 
 const SIM_DopDescription* SIM_NvFlexData::getDescriptionForFucktory() {
 	static PRM_Name maxpts_name("maxpts", "Maximum Particles Count");
 
-	static PRM_Default maxpts_default(1000000);
+	static PRM_Default maxpts_default(1000000); //0 - no fixed limit, grow as needed
+	static PRM_Range maxpts_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 1000000);
 
 	static PRM_Template prms[]{
-		PRM_Template(PRM_INT_E, 1, &maxpts_name, &maxpts_default),
+		PRM_Template(PRM_INT_E, 1, &maxpts_name, &maxpts_default, 0, &maxpts_range),
 		PRM_Template()
 	};
 
@@ -119,6 +132,82 @@ const SIM_DopDescription* SIM_NvFlexData::getDescriptionForFucktory() {
 	return &desc;
 }
 
+#define NVFLEXH_DATA_STATE_VERSION 1
+//version, has state, springBase, springCount, triangleBase, triangleCount, rigidBase, rigidCount, rigidIndexBase
+#define NVFLEXH_DATA_HEADER_SIZE 9
+
+void SIM_NvFlexData::saveSubclass(std::ostream &os) const {
+	SIM_Data::saveSubclass(os);
+	//the container is shared with earlier copies of this data in dop cache and holds the state of the latest step only,
+	//so a copy it has stepped past saves nothing rather than a state from another frame
+	const bool latest = _valid && nvdata && _stateStep == nvdata->getStepCount();
+	const bool hasState = latest && _range < 0;
+	if (_valid && nvdata && !latest)messageLog(2, "nvflex data: cached frame is older than its container's state, solver state is not saved. object restarts from its geometry when loaded\n");
+	else if (latest && _range >= 0)messageLog(2, "nvflex data: object shares a container, solver state is not saved. object is packed again from its geometry when loaded\n");
+	std::vector<char> state;
+	if (hasState) {
+		NvFlexHContextAutoGetter context;
+		nvdata->saveState(state);
+	}
+	const int32 header[NVFLEXH_DATA_HEADER_SIZE] = { NVFLEXH_DATA_STATE_VERSION, hasState ? 1 : 0, _springBase, _springCount, _triangleBase, _triangleCount, _rigidBase, _rigidCount, _rigidIndexBase };
+	const int64 size = int64(state.size());
+	os.write((const char*)header, sizeof(header));
+	os.write((const char*)&size, sizeof(size));
+	os.write(state.data(), state.size());
+	messageLog(5, "nvflex data saved %lld bytes of state\n", size);
+}
+
+bool SIM_NvFlexData::loadSubclass(UT_IStream &is) {
+	if (!SIM_Data::loadSubclass(is))return false;
+	int32 header[NVFLEXH_DATA_HEADER_SIZE];
+	int64 size = 0;
+	if (is.bread((char*)header, sizeof(header)) != exint(sizeof(header)) || header[0] != NVFLEXH_DATA_STATE_VERSION ||
+		is.bread((char*)&size, sizeof(size)) != exint(sizeof(size)) || size < 0) {
+		messageLog(1, "nvflex data: unknown or damaged state in checkpoint\n");
+		return false;
+	}
+	std::vector<char> state((size_t)size);
+	if (size > 0 && is.bread(state.data(), size) != size) {
+		messageLog(1, "nvflex data: checkpoint state is truncated\n");
+		return false;
+	}
+	if (header[1] == 0)return true; //shared container or invalid data, nothing to restore
+	if (!_valid) {
+		messageLog(1, "nvflex data: flex is not available, checkpoint state is dropped\n");
+		return true;
+	}
+
+	int maxParticles, maxDiffuseParticles, maxNeighbours;
+	if (!NvFlexHContainer::readStateSizes(state.data(), state.size(), maxParticles, maxDiffuseParticles, maxNeighbours) || maxDiffuseParticles != NVFLEXH_DATA_MAX_DIFFUSE_PARTICLES || maxNeighbours != NVFLEXH_DATA_MAX_NEIGHBOURS) {
+		messageLog(1, "nvflex data: checkpoint state is not of an nvflex data container\n");
+		return false;
+	}
+	try {
+		std::shared_ptr<NvFlexContainerWrapper> container = createContainer(maxParticles);
+		{
+			NvFlexHContextAutoGetter context;
+			container->loadState(state.data(), state.size());
+		}
+		resetContainer(container, -1);
+	}
+	catch (std::runtime_error &e) {
+		messageLog(1, "nvflex data: could not restore checkpoint state: %s\n", e.what());
+		return false;
+	}
+	_springBase = header[2];
+	_springCount = header[3];
+	_triangleBase = header[4];
+	_triangleCount = header[5];
+	_rigidBase = header[6];
+	_rigidCount = header[7];
+	_rigidIndexBase = header[8];
+	_restored = true;
+	_geoChannels = NVFLEXH_CHANNEL_NONE; //saved geometry has only what was written back, restored container has the rest
+	_prevMaxPts = getMaxPtsCount();
+	messageLog(3, "nvflex data restored %d particles container from %lld bytes of state\n", maxParticles, size);
+	return true;
+}
+
 static void nvFlexErrorCallbackPrint(NvFlexErrorSeverity type, const char *msg, const char *file, int line) {
 	const char * err = "NvF ERROR";
 	const char * wrn = "NvF WARNING";
@@ -145,22 +234,68 @@ static void nvFlexErrorCallbackPrint(NvFlexErrorSeverity type, const char *msg,
 		errlvl = 4;
 		break;
 	}
-	messageLog(errlvl, "%s", pre);
-	if (msg != NULL)messageLog(errlvl, ": %s", msg);
-	if (file != NULL)messageLog(errlvl, " :: %s", file);
-	messageLog(errlvl, " : line %d\n", line);
+	//one call, so lines from solvers on different threads don't interleave
+	messageLog(errlvl, "%s: %s :: %s : line %d\n", pre, msg != NULL ? msg : "", file != NULL ? file : "", line);
 
 }
 
-//cuda-aware deleter
+//cuda-aware deleter. containers go back to the pool, so the next reset doesn't have to make a new solver
 void delete_NvFlexContainerWrapper(SIM_NvFlexData::NvFlexContainerWrapper *wrp) {
-	acquireCudaContext();
-	delete wrp;
-	releaseCudaContext();
+	NvFlexHContainerPool::instance().recycle(wrp);
+}
+
+std::shared_ptr<SIM_NvFlexData::NvFlexContainerWrapper> SIM_NvFlexData::createContainer(int maxParticles) {
+	return std::shared_ptr<NvFlexContainerWrapper>(NvFlexHContainerPool::instance().acquire(NvFlexHContext::instance().library(), maxParticles, NVFLEXH_DATA_MAX_DIFFUSE_PARTICLES, NVFLEXH_DATA_MAX_NEIGHBOURS), delete_NvFlexContainerWrapper);
+}
+
+void SIM_NvFlexData::resetContainer(std::shared_ptr<NvFlexContainerWrapper> container, int range) {
+	nvdata = container;
+	_range = range;
+	_restored = false;
+	_indicesSize = range < 0 ? container->getMaxParticles() : container->getRangeSize(range);
+	_indices.reset(new int[_indicesSize], [](int*p) {delete[] p; });
+	_indicesVersion = -1;
+	_nactives = 0;
+	_stateStep = container->getStepCount();
+	_geoChannels = NVFLEXH_CHANNEL_ALL;
+	_topology.reset(new NvFlexHTopologyPlan());
+	_springBase = _springCount = 0;
+	_triangleBase = _triangleCount = 0;
+	_rigidBase = _rigidCount = _rigidIndexBase = 0;
+	_lastGdpPId = -1;
+	_lastGdpVId = -1;
+	_lastGdpTId = -1;
+	_lastGdpStrId = -1;
+	_lastGdpRlId = -1;
+	_lastGdpIMassId = -1;
+	_lastGdpPhsId = -1;
+	_lastGdpRestId = -1;
+}
+
+
+int SIM_NvFlexData::updateActiveIndices() {
+	//container may have grown without our ids moving, the array still has to have room for the whole range
+	const int size = _range < 0 ? nvdata->getMaxParticles() : nvdata->getRangeSize(_range);
+	if (size > _indicesSize) { //the old array may still be used by earlier copies of this data, so it's a new one
+		_indices.reset(new int[size], [](int*p) {delete[] p; });
+		_indicesSize = size;
+		_indicesVersion = -1;
+	}
+	if (_indicesVersion != nvdata->getActiveVersion(_range)) {
+		_nactives = nvdata->getActiveList(_indices.get(), _range);
+		_indicesVersion = nvdata->getActiveVersion(_range);
+	}
+	return _nactives;
+}
+
+int SIM_NvFlexData::grownParticleCount(int current, int needed) {
+	int64 count = std::max(current, 1);
+	while (count < needed)count *= 2;
+	return int(std::min(count, int64(INT_MAX)));
 }
 
 
-SIM_NvFlexData::SIM_NvFlexData(const SIM_DataFactory*fack):SIM_Data(fack),SIM_OptionsUser(this), _indices(nullptr, [](int*p){delete[] p;}), nvdata(nullptr, delete_NvFlexContainerWrapper), _lastGdpPId(-1), _lastGdpVId(-1), _lastGdpTId(-1), _lastGdpStrId(-1), _prevMaxPts(-1), _valid(false) {
+SIM_NvFlexData::SIM_NvFlexData(const SIM_DataFactory*fack):SIM_Data(fack),SIM_OptionsUser(this), _indices(nullptr, [](int*p){delete[] p;}), _indicesSize(0), nvdata(nullptr, delete_NvFlexContainerWrapper), _lastGdpPId(-1), _lastGdpVId(-1), _lastGdpTId(-1), _lastGdpStrId(-1), _lastGdpRlId(-1), _lastGdpIMassId(-1), _lastGdpPhsId(-1), _lastGdpRestId(-1), _indicesVersion(-1), _nactives(0), _range(-1), _restored(false), _stateStep(0), _geoChannels(NVFLEXH_CHANNEL_ALL), _springBase(0), _springCount(0), _triangleBase(0), _triangleCount(0), _rigidBase(0), _rigidCount(0), _rigidIndexBase(0), _prevMaxPts(-1), _valid(false) {
 	if (nvFlexLibrary != NULL)_valid = true;
 	messageLog(5, "flex data constructed.\n");
 }
@@ -172,81 +307,12 @@ SIM_NvFlexData::~SIM_NvFlexData() {
 
 
 //wrapper
-bool NvFlexHLibraryHolder::cudaContextCreated = false;
-NvFlexLibrary* NvFlexHLibraryHolder::nvFlexLibrary = NULL;
-GA_Size NvFlexHLibraryHolder::_instanceCount = 0;
-
-
-
-NvFlexHLibraryHolder::NvFlexHLibraryHolder() {
-	++_instanceCount;
-	if (nvFlexLibrary == NULL) {
-		if (!cudaContextCreated) {
-			int attempt = 0;
-			if (cudaExplicitlyInitizlized)attempt = 1;
-			for (; attempt < 2; ++attempt) {
-				if (!cudaExplicitlyInitizlized && attempt == 1) {
-					messageLog(3, "initializing CUDA explicitly...\n");
-					CUresult err;
-					if ((err = cuInit(0)) != CUDA_SUCCESS) {
-						messageLog(0, "cuda initialization failed! error code: %d\n", err);
-						throw std::runtime_error("cuda initialization failed!");
-					}
-					cudaExplicitlyInitizlized = true;
-				}
-
-				int cdevice = NvFlexDeviceGetSuggestedOrdinal();
-				if (cdevice == -1) {
-					if (attempt < 1)continue;
-					messageLog(1, "FlexDevice: No Cuda device found ! \n");
-					throw std::runtime_error("Failed to initialize Cuda Context");
-				}
-				if (!NvFlexDeviceCreateCudaContext(cdevice)) {
-					if (attempt < 1)continue;
-					messageLog(1, "FlexDevice: Failed to initialize Cuda Context\n");
-					throw std::runtime_error("Failed to initialize Cuda Context");
-				}
-				cudaContextCreated = true;
-				break;
-			}
-		}
-		NvFlexInitDesc desc;
-		desc.deviceIndex = 0; // ignored, device index is set by the context. TODO: make an env variable for fallback device
-		desc.enableExtensions = false;
-		desc.renderDevice = NULL;
-		desc.renderContext = NULL;
-		desc.computeType = NvFlexComputeType::eNvFlexCUDA;
-		bool flexFailed = false;
-		try {
-			nvFlexLibrary = NvFlexInit(110, &nvFlexErrorCallbackPrint, &desc);
-		}
-		catch (...) { flexFailed = true; }
-		if (nvFlexLibrary == NULL)flexFailed = true;
+NvFlexHLibraryHolder::NvFlexHLibraryHolder() :nvFlexLibrary(NvFlexHContext::instance().addRef(nvFlexErrorCallbackPrint)) {}
 
-		if (flexFailed) {
-			messageLog(0, "Failed to initialize Flex library\n");
-			throw std::runtime_error("Failed to initialize Flex library");
-		}
+NvFlexHLibraryHolder::NvFlexHLibraryHolder(const NvFlexHLibraryHolder&) :nvFlexLibrary(NvFlexHContext::instance().addRef(nvFlexErrorCallbackPrint)) {}
 
-		messageLog(5, "flex library initialized\n");
-	}
-	messageLog(5, "libhld: instancecount: %d\n",  _instanceCount);
-}
 NvFlexHLibraryHolder::~NvFlexHLibraryHolder() {
-	--_instanceCount;
-	messageLog(5, "libhld: instancecount: %d\n", _instanceCount);
-	if (_instanceCount == 0) {
-		//no, lets assume that we need to have proper context by this time for it to be properly released
-		// and lets assume that NvFlexShutdown restores previous context
-		while (releaseCudaContext()) {};//release all cuda contexts
-		NvFlexAcquireContext(nvFlexLibrary);
-		NvFlexShutdown(nvFlexLibrary);
-		nvFlexLibrary = NULL;
-		cudaContextAcquiredCount = 0;
-		NvFlexDeviceDestroyCudaContext();
-		cudaContextCreated = false;
-		messageLog(5, "flex library destroyed\n");
-	}
+	NvFlexHContext::instance().release();
 }
 
 
@@ -9,18 +9,25 @@
 #include <../core/types.h>
 #include <../core/maths.h>
 
-#include "NvFlexHCollisionData.h"
-
-//a little wrapper to keep track of the library
+#include "NvFlexHContainer.h"
+#include "NvFlexHContext.h"
+#include "NvFlexHTopology.h"
+#include "NvFlexHParticleTransfer.h"
+
+//containers of data with maxpts 0 start this big and grow with the geometry
+#define NVFLEXH_GROWABLE_INITIAL_PARTICLES 16384
+//every container of nvflex data is made with these, checkpoint state with anything else is not ours
+#define NVFLEXH_DATA_MAX_DIFFUSE_PARTICLES 0
+#define NVFLEXH_DATA_MAX_NEIGHBOURS 96
+
+//a little wrapper to keep track of the library, holds a reference of NvFlexHContext
 class NvFlexHLibraryHolder {
 public:
 	NvFlexHLibraryHolder();
+	NvFlexHLibraryHolder(const NvFlexHLibraryHolder&);
 	virtual ~NvFlexHLibraryHolder();
 protected:
-	static NvFlexLibrary* nvFlexLibrary;
-	static bool cudaContextCreated;
-private:
-	static GA_Size _instanceCount;
+	NvFlexLibrary* nvFlexLibrary;
 };
 
 //wrapper done
@@ -30,222 +37,7 @@ class SIM_NvFlexSolver; //fwd decl
 class SIM_NvFlexData:public SIM_Data, public SIM_OptionsUser, public NvFlexHLibraryHolder
 {
 public:
-	class NvFlexContainerWrapper {
-	public:
-		typedef struct NvFlexHSpringData {
-			int* const springIds;
-			float* const springRls;
-			float* const springSts;
-
-			NvFlexHSpringData(int*sid, float*srl, float*sts):springIds(sid),springRls(srl),springSts(sts) {}
-		} NvFlexHSpringData;
-
-		typedef struct NvFlexHTriangleData {
-			int* const triangleIds;
-			float* const triangleNms;
-
-			NvFlexHTriangleData(int*tid, float*tnm):triangleIds(tid),triangleNms(tnm) {}
-		} NvFlexHTriangleData;
-
-		typedef struct NvFlexHRigidData {
-			int* offsets; //numRigids+1
-			int* indices;
-			float* restPositions; //numRigids*3
-			float* restNormals; //numRigids*4 (normal.xyz;sdf)
-			float* stiffness; //numRigids
-			float* rotations; //numRigids*4 (quat)
-			float* translations;
-
-			NvFlexHRigidData(int*off, int*ind, float*rep, float*ren, float*stf, float*rot, float*trs) :offsets(off), indices(ind), restPositions(rep), restNormals(ren), stiffness(stf), rotations(rot), translations(trs) {};
-		} NvFlexRigidData;
-
-		typedef struct NvFlexHRigidTransData {
-			int rigidsCount;
-			float* rotations; //numRigids*4 (quat)
-			float* translations;
-			NvFlexHRigidTransData(float*trs, float*rot, int count) :translations(trs), rotations(rot), rigidsCount(count) {};
-		} NvFlexHRigidTransData;
-
-		explicit NvFlexContainerWrapper(NvFlexLibrary*lib, int maxParticles, int MaxDiffuseParticles, int maxNeighbours = 96):_springIndices(lib),_springRestLengths(lib),_springStrenghts(lib), _triangleIndices(lib),_triangleNormals(lib), _rgdOffsets(lib), _rgdIndices(lib), _rgdRestPositions(lib), _rgdRestNormals(lib), _rgdStiffness(lib), _rgdRotations(lib), _rgdTranslations(lib) {
-			_slv = NvFlexCreateSolver(lib, maxParticles, MaxDiffuseParticles, maxNeighbours);
-			if (_slv == NULL)throw std::runtime_error("NULL NVFLEX SOLVER!");
-			_cont = NvFlexExtCreateContainer(lib, _slv, maxParticles);
-			if (_cont == NULL)throw std::runtime_error("NULL NVFLEX CONTAINER!");
-			_colld = new NvFlexHCollisionData(lib);
-		}
-		NvFlexContainerWrapper(NvFlexContainerWrapper&) = delete;
-		~NvFlexContainerWrapper() {
-			//NvFlexAcquireContext(SIM_NvFlexData::nvFlexLibrary);
-			//no aquire cuz we assume the destructor wrapper is responsible for that
-			NvFlexExtDestroyContainer(_cont);
-			NvFlexDestroySolver(_slv);
-			delete _colld;
-			//NvFlexRestoreContext(SIM_NvFlexData::nvFlexLibrary);
-		}
-
-		NvFlexSolver* solver() { return _slv; }
-		NvFlexExtContainer * container() { return _cont; }
-		NvFlexHCollisionData* collisionData() { return _colld; }
-
-		//springs
-		int getSpringsCount()const { return _springRestLengths.size(); }
-		void resizeSpringData(int newSize) {
-			/// be sure data is NOT MAPPED before here
-			/// cuz all previous pointers will be invalidated
-			_springIndices.map();
-			_springRestLengths.map();
-			_springStrenghts.map();
-
-			_springIndices.resize(2*newSize);
-			_springRestLengths.resize(newSize);
-			_springStrenghts.resize(newSize);
-
-			_springIndices.unmap();
-			_springRestLengths.unmap();
-			_springStrenghts.unmap();
-		}
-		NvFlexHSpringData mapSpringData() {
-			_springIndices.map();
-			_springRestLengths.map();
-			_springStrenghts.map();
-			return NvFlexHSpringData(_springIndices.mappedPtr, _springRestLengths.mappedPtr, _springStrenghts.mappedPtr);
-		}
-		void unmapSpringData() {
-			_springIndices.unmap();
-			_springRestLengths.unmap();
-			_springStrenghts.unmap();
-		}
-		void pushSpringsToDevice() {
-			NvFlexSetSprings(_slv, _springIndices.buffer, _springRestLengths.buffer, _springStrenghts.buffer, _springRestLengths.size());
-		}
-
-		//triangles
-		int getTrianglesCount()const { return _triangleIndices.size() / 3; }
-		void resizeTriangleData(int newSize) {
-			/// be sure data is NOT MAPPED before here
-			/// cuz all previous pointers will be invalidated
-			_triangleIndices.map();
-			_triangleNormals.map();
-
-			_triangleIndices.resize(3*newSize);
-			_triangleNormals.resize(3*newSize);
-
-			_triangleIndices.unmap();
-			_triangleNormals.unmap();
-		}
-		NvFlexHTriangleData mapTriangleData() {
-			_triangleIndices.map();
-			_triangleNormals.map();
-			return NvFlexHTriangleData(_triangleIndices.mappedPtr, _triangleNormals.mappedPtr);
-		}
-		void unmapTriangleData() {
-			_triangleIndices.unmap();
-			_triangleNormals.unmap();
-		}
-		void pushTrianglesToDevice(bool pushNormals = true) {
-			NvFlexSetDynamicTriangles(_slv, _triangleIndices.buffer, pushNormals ? _triangleNormals.buffer : NULL, _triangleIndices.size() / 3);
-		}
-
-		//rigids
-		int getRigidCount()const { return _rgdStiffness.size(); }
-		int getRigidIndicesCount()const { return _rgdIndices.size(); }
-		void resizeRigidData(const int numbodies, const std::vector<int>& bodysizes) {
-			// data must not be mapped !
-			// pointers will be fucked !
-			
-			//TODO: assert numbodies == bodysizes.size()
-			_rgdOffsets.map();
-			_rgdIndices.map();
-			_rgdRestPositions.map();
-			_rgdRestNormals.map();
-			_rgdStiffness.map();
-			_rgdRotations.map();
-			_rgdTranslations.map();
-
-
-			_rgdOffsets.resize(numbodies + 1);
-			exint ind = 0;
-			for (size_t i = 0; i < numbodies; ++i) {
-				_rgdOffsets[i] = ind;
-				ind += bodysizes[i];
-			}
-			_rgdOffsets[numbodies] = ind;
-
-			_rgdIndices.resize(ind);
-
-			_rgdRestPositions.resize(ind * 3);
-			_rgdRestNormals.resize(ind * 4);
-			_rgdStiffness.resize(numbodies);
-			_rgdRotations.resize(numbodies * 4);
-			_rgdTranslations.resize(numbodies * 3);
-
-			_rgdOffsets.unmap();
-			_rgdIndices.unmap();
-			_rgdRestPositions.unmap();
-			_rgdRestNormals.unmap();
-			_rgdStiffness.unmap();
-			_rgdRotations.unmap();
-			_rgdTranslations.unmap();
-		}
-		NvFlexHRigidData mapRigidData() {
-			_rgdOffsets.map();
-			_rgdIndices.map();
-			_rgdRestPositions.map();
-			_rgdRestNormals.map();
-			_rgdStiffness.map();
-			_rgdRotations.map();
-			_rgdTranslations.map();
-			return NvFlexHRigidData(_rgdOffsets.mappedPtr, _rgdIndices.mappedPtr, _rgdRestPositions.mappedPtr, _rgdRestNormals.mappedPtr, _rgdStiffness.mappedPtr, _rgdRotations.mappedPtr, _rgdTranslations.mappedPtr);
-		}
-		void unmapRigidData() {
-			_rgdOffsets.unmap();
-			_rgdIndices.unmap();
-			_rgdRestPositions.unmap();
-			_rgdRestNormals.unmap();
-			_rgdStiffness.unmap();
-			_rgdRotations.unmap();
-			_rgdTranslations.unmap();
-		}
-		NvFlexHRigidTransData mapRigidTransData() { //maps just the translation+rotation data instead of the whole bunch
-			_rgdRotations.map();
-			_rgdTranslations.map();
-			return NvFlexHRigidTransData(_rgdTranslations.mappedPtr, _rgdRotations.mappedPtr, _rgdStiffness.size());
-		}
-		void unmapRigidTransData() {
-			_rgdRotations.unmap();
-			_rgdTranslations.unmap();
-		}
-		void pushRigidsToDevice() {
-			NvFlexSetRigids(_slv, _rgdOffsets.buffer, _rgdIndices.buffer, _rgdRestPositions.buffer, _rgdRestNormals.buffer, _rgdStiffness.buffer, _rgdRotations.buffer, _rgdTranslations.buffer, _rgdStiffness.size(), _rgdIndices.size());
-		}
-		void pullRigidsFromDevice() {
-			//pull rigid transformations recalculated by solver
-			//WARNING! buffers MUST already be properly resized!
-			NvFlexGetRigidTransforms(_slv, _rgdRotations.buffer, _rgdTranslations.buffer);
-		}
-
-	private:
-		NvFlexHCollisionData* _colld;
-		NvFlexSolver* _slv;
-		NvFlexExtContainer* _cont;
-
-		//springs
-		NvFlexVector<int> _springIndices;
-		NvFlexVector<float> _springRestLengths;
-		NvFlexVector<float> _springStrenghts;
-		//triangles
-		NvFlexVector<int> _triangleIndices;
-		NvFlexVector<float> _triangleNormals;
-		//rigids
-		NvFlexVector<int> _rgdOffsets; //numRigids+1
-		NvFlexVector<int> _rgdIndices;
-		NvFlexVector<float> _rgdRestPositions; //numIndices*3
-		NvFlexVector<float> _rgdRestNormals; //numIndices*4 (normal.xyz;sdf)
-		NvFlexVector<float> _rgdStiffness; //numRigids
-		NvFlexVector<float> _rgdRotations; //numRigids*4 (quat)
-		NvFlexVector<float> _rgdTranslations; //numRigids*3
-	};
-
+	typedef NvFlexHContainer NvFlexContainerWrapper;
 	
 	//static NvFlexLibrary* nvFlexLibrary;
 
@@ -254,6 +46,14 @@ public:
 	std::shared_ptr<NvFlexContainerWrapper> nvdata;
 public:
 	inline bool isNvValid() { return _valid; }
+	//maxpts 0 - no fixed limit, container is grown when geometry gets more points than it has room for
+	inline bool isGrowable() { return getMaxPtsCount() <= 0; }
+	inline int initialParticleCount() { return isGrowable() ? NVFLEXH_GROWABLE_INITIAL_PARTICLES : int(getMaxPtsCount()); }
+	//at least doubles, so a sim growing every frame makes only a few new solvers
+	static int grownParticleCount(int current, int needed);
+
+	//cleared container from the pool or a new one, with cuda-aware deleter giving it back. throws if flex can't create a solver
+	static std::shared_ptr<NvFlexContainerWrapper> createContainer(int maxParticles);
 
 protected:
 	explicit SIM_NvFlexData(const SIM_DataFactory*fack);
@@ -264,17 +64,40 @@ protected:
 
 	void setParametersSubclass(const SIM_Options & parms);
 
+	//checkpoints carry the whole solver state of objects with their own container, see NvFlexHContainer::saveState
+	//objects of a shared container save none, they are packed again and take their geometry on the next step.
+	//neither do copies the container has stepped past, it only holds the state of the latest step
+	void saveSubclass(std::ostream &os) const;
+	bool loadSubclass(UT_IStream &is);
+
 private:
 	bool _valid;
 	int64 _prevMaxPts;
 private: //for a friend
+	//active particle index map: point index -> particle id. kept between steps and refetched only when container's active version changes
+	int updateActiveIndices();
+	//switches to another container (or a range of a shared one), everything will be taken from geometry again on next step
+	void resetContainer(std::shared_ptr<NvFlexContainerWrapper> container, int range);
+	int _range; //particle range of nvdata this object owns, -1 - whole container
+	bool _restored; //container came from a checkpoint, first step takes the geometry saved with it as already ingested
+	int64 _stateStep; //container's step count when this copy's step was done, see NvFlexHContainer::markStepped
+	int _geoChannels; //particle channels geometry holds live values of: all of them before the first step, then the ones written back
+	//phase groups of objects sharing a container are moved apart so they don't self-collide across objects
+	inline int phaseGroupOffset() const { return _range > 0 ? _range * NVFLEXH_SHARED_GROUP_STRIDE : 0; }
+	//this object's slices of container's springs, triangles and rigids
+	int _springBase, _springCount, _triangleBase, _triangleCount;
+	int _rigidBase, _rigidCount, _rigidIndexBase;
 	std::shared_ptr<int> _indices;
-	int64 _lastGdpPId,_lastGdpTId,_lastGdpStrId,_lastGdpVId;
+	int _indicesSize; //container may have grown since _indices was allocated
+	int64 _indicesVersion;
+	int _nactives;
+	//springs/triangles/rigids split of the last geometry, rebuilt only when its topology changes
+	std::shared_ptr<NvFlexHTopologyPlan> _topology;
+	int64 _lastGdpPId,_lastGdpTId,_lastGdpStrId,_lastGdpRlId,_lastGdpVId;
+	int64 _lastGdpIMassId, _lastGdpPhsId, _lastGdpRestId;
 
 	friend class SIM_NvFlexSolver;
 	friend void delete_NvFlexContainerWrapper(SIM_NvFlexData::NvFlexContainerWrapper *wrp);
-	friend bool acquireCudaContext();
-	friend bool releaseCudaContext();
 
 private:
 	static const SIM_DopDescription* getDescriptionForFucktory();
@@ -11,19 +11,33 @@
 #include <GA/GA_PageIterator.h>
 #include <GA/GA_PageHandle.h>
 #include <GA/GA_SplittableRange.h>
+#include <UT/UT_Thread.h>
+#include <UT/UT_ParallelUtil.h>
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
+#include <vector>
+#include <unordered_set>
 
 #include <NvFlexDevice.h>
 
 #include "utils.h"
 #include "NvFlexHTriangleMesh.h"
+#include "NvFlexHParticleTransfer.h"
+#include "NvFlexHTopology.h"
+#include "NvFlexHColliderUpdate.h"
+#include "NvFlexHStepStats.h"
 #include "SIM_NvFlexData.h" //for static library
 #include "SIM_NvFlexSolver.h"
 
+static inline int64 attribDataId(const GA_Attribute *attr) {
+	return attr == NULL ? -1 : attr->getDataId();
+}
+
 SIM_NvFlexSolver::SIM_Result SIM_NvFlexSolver::solveObjectsSubclass(SIM_Engine & engine, SIM_ObjectArray & objs, SIM_ObjectArray & newobjs, SIM_ObjectArray & feedbackobjs, const SIM_Time & timestep)
 {
-
+	std::vector<NvFlexHSolveTarget> targets;
 	for (exint obji = 0; obji < objs.entries(); ++obji) {
 		SIM_Object* obj = objs(obji);
 
@@ -36,547 +50,681 @@ SIM_NvFlexSolver::SIM_Result SIM_NvFlexSolver::solveObjectsSubclass(SIM_Engine &
 			addError(obj, SIM_BADSUBDATA, "NvFlexData is in invalid state (maybe insufficient GPU resources). try resetting the simulation.", UT_ERROR_WARNING);
 			continue;
 		}
+		targets.push_back(NvFlexHSolveTarget(obj, nvdata));
+	}
+	if (targets.empty())return SIM_SOLVER_SUCCESS;
 
-		NvFlexHContextAutoGetter contextAutoGetAndRelease(nvdata->nvFlexLibrary);
-
-		std::shared_ptr<SIM_NvFlexData::NvFlexContainerWrapper> consolv = nvdata->nvdata;
-
-		
+	//acquires nest per thread, so solvers of other dop networks can be cooking on their own threads meanwhile
+	NvFlexHContextAutoGetter contextAutoGetAndRelease;
 
-		// Getting old geometry and shoving it into NvFlex buffers
-		const SIM_Geometry *geo=SIM_DATA_GETCONST(*obj, "Geometry", SIM_Geometry);
-		if (geo != NULL) {
-			GU_DetailHandleAutoReadLock lock(geo->getGeometry());
-			if (lock.isValid()) {
-				int nactives = -1;
-				const GU_Detail *gdp = lock.getGdp();
-				int64 ndid = gdp->getP()->getDataId();
-				int64 nvdid = -1;
-				{
-					const GA_Attribute* vattr=gdp->findPointAttribute("v");
-					if (vattr != NULL) nvdid = vattr->getDataId();
+	if (getSharedContainer() != 0) {
+		//all objects in one flex solver: they interact with each other and there is one solve per step instead of one per object
+		if (packSharedContainer(targets))solveGroup(engine, targets, timestep);
+	}
+	else {
+		for (size_t ti = 0; ti < targets.size(); ++ti) {
+			SIM_NvFlexData *nvdata = targets[ti].nvdata;
+			if (nvdata->_range >= 0) { //was in a shared container, gets its own one back
+				try {
+					nvdata->resetContainer(SIM_NvFlexData::createContainer(nvdata->initialParticleCount()), -1);
 				}
-				
-				int64 ntopdid = gdp->getTopology().getDataId();
-				messageLog(5, "P data id = %lld\n", ndid);
-				if (ndid != nvdata->_lastGdpPId || nvdid != nvdata->_lastGdpVId || ntopdid != nvdata->_lastGdpTId) {
-					messageLog(5, "found geo, new id !! old P id: %lld. old v id: %lld. old topo id: %lld\n", nvdata->_lastGdpPId, nvdata->_lastGdpVId, nvdata->_lastGdpTId);
-
-					//we just search for attribs, not creating them cuz for now we work with RO geometry
-
-					GA_ROHandleV3 phnd(gdp->getP());
-					GA_ROHandleV3 vhnd(gdp->findPointAttribute("v"));
-					GA_ROHandleI ihnd(gdp->findPointAttribute("iid"));
-					GA_ROHandleI phshnd(gdp->findPointAttribute("phs"));
-					GA_ROHandleF mhnd(gdp->findPointAttribute("imass"));
-					GA_ROHandleV3 rhnd(gdp->findPointAttribute("restP"));
-					const bool hasRest = rhnd.isValid();
-
-					int* indices = nvdata->_indices.get();
-					if (nactives == -1)nactives = NvFlexExtGetActiveList(consolv->container(), indices); //do not reread indices if they have already been read before in this geo lock block
-
-					if (phnd.isValid() && vhnd.isValid() && ihnd.isValid() && phshnd.isValid() && mhnd.isValid()) {
-
-						const GA_Size ngdpoints = gdp->getNumPoints();
-						if (ngdpoints > nvdata->getMaxPtsCount()) {
-							addError(obj, SIM_BADSUBDATA, "Geometry pointcount exceeds maximum pointcound allocated by NvData!", UT_ERROR_ABORT);
-							continue;
-						}
-
-						bool reget = false;
-						if (nactives < ngdpoints) {
-							int nptscount = NvFlexExtAllocParticles(consolv->container(), ngdpoints - nactives, indices); //whoa! carefull with that! your luck the mapped buffer is not reallocated during this operation!
-							/*for (int npi = 0; npi < nptscount; ++npi) {
-								pdat.phases[indices[npi]] = eNvFlexPhaseSelfCollide | eNvFlexPhaseFluid;
-							}*/
-							reget = true;
-						}
-						else if (nactives > ngdpoints) {
-							NvFlexExtFreeParticles(consolv->container(), nactives - ngdpoints, indices);
-							reget = true;
-						}
-						if (reget) nactives = NvFlexExtGetActiveList(consolv->container(), indices);
-
-						NvFlexExtParticleData pdat = NvFlexExtMapParticleData(consolv->container());
-
-						GA_Offset bst, bed;
-						bool stoploop = false;
-						for (GA_Iterator it(gdp->getPointRange()); it.blockAdvance(bst, bed);) { //TODO: make it threaded after debugged
-							for (GA_Offset off = bst; off < bed; ++off) {
-								UT_Vector3F p = phnd.get(off);
-								UT_Vector3F v = vhnd.get(off);
-
-								GA_Index idx = gdp->pointIndex(off);
-								if (idx >= nactives) {
-									stoploop = true;
-									break;
-								}
-								int iid = indices[idx];
-								int iid4 = iid * 4;
-								int iid3 = iid * 3;
-								pdat.particles[iid4 + 0] = p.x();
-								pdat.particles[iid4 + 1] = p.y();
-								pdat.particles[iid4 + 2] = p.z();
-								pdat.particles[iid4 + 3] = mhnd.get(off);
-								if (hasRest) {
-									UT_Vector3F rst = rhnd.get(off);
-									pdat.restParticles[iid4 + 0] = rst.x();
-									pdat.restParticles[iid4 + 1] = rst.y();
-									pdat.restParticles[iid4 + 2] = rst.z();
-									pdat.restParticles[iid4 + 3] = 1.0f; //cannot find in manual what it expects here
-								}
-
-								pdat.velocities[iid3 + 0] = v.x();
-								pdat.velocities[iid3 + 1] = v.y();
-								pdat.velocities[iid3 + 2] = v.z();
-
-								pdat.phases[iid] = phshnd.get(off);
-							}
-							if (stoploop)break;
-						}
-
-						NvFlexExtUnmapParticleData(consolv->container());
-
-						//Push NvFlex data to GPU. since it's async - we need to do it as far from the solver tick as possible to use this time to do CPU work
-						NvFlexExtPushToDevice(consolv->container()); //This pushes all from particle data returned by map. so collisions, springs and triangles we can push separately.
-						//Also note that as long as we don't call anything with nvFlexExtAssets - we are free to rebind springs manually.
-
-					}
+				catch (...) {
+					addError(targets[ti].obj, SIM_BADSUBDATA, "could not create NvFlex container for the object", UT_ERROR_ABORT);
+					continue;
 				}
+			}
+			std::vector<NvFlexHSolveTarget> group(1, targets[ti]);
+			solveGroup(engine, group, timestep);
+		}
+	}
 
-				//NOW PRIMITIVES
-
-				GA_Size nprims = gdp->getNumPrimitives();
-				if(nprims>0) {//Create and Push SPRINGS and TRIANGLES and RIGIDS
-					GA_ROHandleF rlhnd(gdp->findPrimitiveAttribute("restlength"));
-					GA_ROHandleF sthnd(gdp->findPrimitiveAttribute("strength"));
-					//--
-					GA_ROHandleV3 nphnd(gdp->findPointAttribute("N"));
-					GA_ROHandleV3 nvhnd(gdp->findVertexAttribute("N"));
-					GA_ROHandleV3 nrhnd(gdp->findPrimitiveAttribute("N"));
-					const short triNormalType = nrhnd.isValid() ? 3 : (nvhnd.isValid() ? 2 : (nphnd.isValid() ? 1 : 0));
-					//--
-					GA_ROHandleV3 prtrshnd(gdp->findPrimitiveAttribute("rgd_translation"));
-					GA_ROHandleV4 prrothnd(gdp->findPrimitiveAttribute("rgd_rotation"));
-					GA_ROHandleV3 vrrsphnd(gdp->findVertexAttribute("rgd_restP"));
-					GA_ROHandleV3 vrrsnhnd(gdp->findVertexAttribute("rgd_restN"));
-					GA_ROHandleF vrsdfhnd(gdp->findVertexAttribute("rgd_sdf"));
-					GA_ROHandleF prstfhnd(gdp->findPrimitiveAttribute("rgd_stiffness"));
-					GA_ROHandleI  prgdhnd(gdp->findPrimitiveAttribute("rgd_isrigid"));
-
-					int* indices = nvdata->_indices.get();
-					if (nactives == -1)nactives = NvFlexExtGetActiveList(consolv->container(), indices); //do not reread indices if they have already been read before in this geo lock block
-
-					const bool doSprings = rlhnd.isValid() && sthnd.isValid() && (sthnd.getAttribute()->getDataId() != nvdata->_lastGdpStrId || ntopdid != nvdata->_lastGdpTId);
-					const bool doTriangles = ntopdid != nvdata->_lastGdpTId;
-					const bool doRigids = prtrshnd.isValid() && prrothnd.isValid() && vrrsphnd.isValid() && vrrsnhnd.isValid() && vrsdfhnd.isValid() && prstfhnd.isValid() && prgdhnd.isValid() && (ntopdid != nvdata->_lastGdpTId);
-					if (doSprings || doTriangles || doRigids) {
-						//calculate primitives of different types
-						GA_Size totalspringcount = 0;
-						GA_Size totaltricount = 0;
-						GA_Size totalrigidcount = 0;
-						std::vector<int> rgdPrimSizes;
-						rgdPrimSizes.reserve(nprims);//reserve size of total prim count. not particulary good, but it's main RAM and we can assume we have an ass load of it.
-						for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
-							GA_Offset off = *it;
-							GA_Size vtxcount = gdp->getPrimitiveVertexCount(off);
-							const bool isRigid = prgdhnd.isValid() && prgdhnd.get(off);
-							if (isRigid) {
-								++totalrigidcount;
-								rgdPrimSizes.push_back(vtxcount);
-							} else {
-								if (vtxcount == 2)++totalspringcount;
-								else if (vtxcount == 3)++totaltricount;
-							}
-						}
-						consolv->resizeSpringData(totalspringcount);
-						consolv->resizeTriangleData(totaltricount);
-						consolv->resizeRigidData(totalrigidcount, rgdPrimSizes);
-						messageLog(5, "total springs count: %lld\n", totalspringcount);
-						messageLog(5, "total triangles count: %lld\n", totaltricount);
-						messageLog(5, "total rigids count: %lld\n", totalrigidcount);
-
-						auto sprdat = consolv->mapSpringData();
-						auto tridat = consolv->mapTriangleData();
-						auto rgddat = consolv->mapRigidData();
-						GA_Size springcount = 0; //TODO: replace with SYS_AtomicCounter in threaded implementation
-						GA_Size trianglecount = 0;
-						GA_Size rgdcount = 0;
-						GA_Size rgdindoff = 0;
-						for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
-							GA_Offset off = *it;
-							GA_Size vtxcount = gdp->getPrimitiveVertexCount(off);
-							const bool isRigid = prgdhnd.isValid() && prgdhnd.get(off);
-							if (isRigid) {
-								rgddat.offsets[rgdcount] = rgdindoff;
-								for (GA_Iterator vit = gdp->getPrimitive(off)->getVertexRange().begin(); !vit.atEnd(); ++vit) {
-									GA_Offset vtxoff = *vit;
-									UT_Vector3 vrestP = vrrsphnd.get(vtxoff);
-									UT_Vector3 vrestN = vrrsnhnd.get(vtxoff);
-									float vsdf = vrsdfhnd.get(vtxoff);
-
-									rgddat.indices[rgdindoff] = indices[gdp->pointIndex(gdp->vertexPoint(vtxoff))];
-									rgddat.restPositions[rgdindoff * 3 + 0] = vrestP.x();
-									rgddat.restPositions[rgdindoff * 3 + 1] = vrestP.y();
-									rgddat.restPositions[rgdindoff * 3 + 2] = vrestP.z();
-									rgddat.restNormals[rgdindoff * 4 + 0] = vrestN.x();
-									rgddat.restNormals[rgdindoff * 4 + 1] = vrestN.y();
-									rgddat.restNormals[rgdindoff * 4 + 2] = vrestN.z();
-									rgddat.restNormals[rgdindoff * 4 + 3] = vsdf;
-
-									++rgdindoff;
-								}
-								float pstiff = prstfhnd.get(off);
-								UT_Vector3F ptrs = prtrshnd.get(off);
-								UT_Vector4F prot = prrothnd.get(off);
-								rgddat.stiffness[rgdcount] = pstiff;
-								rgddat.translations[rgdcount * 3 + 0] = ptrs.x();
-								rgddat.translations[rgdcount * 3 + 1] = ptrs.y();
-								rgddat.translations[rgdcount * 3 + 2] = ptrs.z();
-								rgddat.rotations[rgdcount * 4 + 0] = prot.x();
-								rgddat.rotations[rgdcount * 4 + 1] = prot.y();
-								rgddat.rotations[rgdcount * 4 + 2] = prot.z();
-								rgddat.rotations[rgdcount * 4 + 3] = prot.w();
-
-								++rgdcount;
-							}
-							else {
-								if (vtxcount == 2) {
-									GA_OffsetListRef vtxs = gdp->getPrimitiveVertexList(off);
-									GA_Offset vt0 = vtxs(0);
-									GA_Offset vt1 = vtxs(1);
-
-									//TODO: check that if we hit pts limit - we dont write geo indices above the limit!!
-									//at this point indices should still be valid
-									sprdat.springIds[springcount * 2 + 0] = indices[gdp->pointIndex(gdp->vertexPoint(vt0))];
-									sprdat.springIds[springcount * 2 + 1] = indices[gdp->pointIndex(gdp->vertexPoint(vt1))];
-									sprdat.springRls[springcount] = rlhnd.get(off);
-									sprdat.springSts[springcount] = sthnd.get(off);
-
-									++springcount;
-								}
-								else if (vtxcount == 3) {
-									GA_OffsetListRef vtxs = gdp->getPrimitiveVertexList(off);
-									GA_Offset vt0 = vtxs(0);
-									GA_Offset vt1 = vtxs(1);
-									GA_Offset vt2 = vtxs(2);
-
-									GA_Offset pt0 = gdp->vertexPoint(vt0);
-									GA_Offset pt1 = gdp->vertexPoint(vt1);
-									GA_Offset pt2 = gdp->vertexPoint(vt2);
-
-									GA_Size tricnt3 = trianglecount * 3;
-									tridat.triangleIds[tricnt3 + 0] = indices[gdp->pointIndex(pt0)];
-									tridat.triangleIds[tricnt3 + 1] = indices[gdp->pointIndex(pt1)];
-									tridat.triangleIds[tricnt3 + 2] = indices[gdp->pointIndex(pt2)];
-
-									if (triNormalType > 0) {
-										UT_Vector3F n;
-										if (triNormalType == 1) {
-											n = nphnd.get(pt0);
-											n += nphnd.get(pt1);
-											n += nphnd.get(pt2);
-											n.normalize();
-										}
-										else if (triNormalType == 2) {
-											n = nvhnd.get(vt0);
-											n += nvhnd.get(vt1);
-											n += nvhnd.get(vt2);
-											n.normalize();
-										}
-										else if (triNormalType == 3) {
-											n = nrhnd.get(off);
-										}
-										tridat.triangleNms[tricnt3 + 0] = n.x();
-										tridat.triangleNms[tricnt3 + 1] = n.y();
-										tridat.triangleNms[tricnt3 + 2] = n.z();
-									}
-
-									++trianglecount;
-								}
-							}
-						}
-						rgddat.offsets[rgdcount] = rgdindoff;
-						consolv->unmapSpringData();
-						consolv->unmapTriangleData();
-						consolv->unmapRigidData();
-
-
-						consolv->pushSpringsToDevice();//Note that we should do this only if change occured in springs. for now we do not detect those changes, so we push always.
-						consolv->pushTrianglesToDevice(triNormalType > 0);
-						consolv->pushRigidsToDevice();
-
-					}
-					else {//TODO: imagine geometry changed and no such attribs now - we need to destroy nvFles springs/triangles/rigids and push zero arrays to device as well!
-						//condition changed, for now this destruction of constraints is commented out, the case described in TODO above is not very probable
-						/*consolv->resizeSpringData(0);
-						consolv->resizeTriangleData(0);
-						consolv->resizeRigidData(0,std::vector<int>());
-						consolv->pushSpringsToDevice();
-						consolv->pushTrianglesToDevice(false);
-						consolv->pushRigidsToDevice();*/
-					}
+	return SIM_SOLVER_SUCCESS;
+}
 
-				}
-				else {//END SPRINGS AND TRIANGLES AND RIGIDS
-					consolv->resizeSpringData(0);
-					consolv->resizeTriangleData(0);
-					consolv->resizeRigidData(0, std::vector<int>());
-					consolv->pushSpringsToDevice();
-					consolv->pushTrianglesToDevice(false);
-					consolv->pushRigidsToDevice();
-				}
+bool SIM_NvFlexSolver::packSharedContainer(std::vector<NvFlexHSolveTarget> &targets) {
+	//object i owns range i, sized by its own maxpts (growable ones may have grown past their initial size). if anything about that changed - the container is made again
+	//and every object takes its whole geometry on this step, as if the simulation was just started from it
+	const NvFlexHContainer *current = targets[0].nvdata->nvdata.get();
+	bool packed = current != NULL && current->getRangeCount() == int(targets.size());
+	for (size_t ti = 0; packed && ti < targets.size(); ++ti) {
+		SIM_NvFlexData *nvdata = targets[ti].nvdata;
+		const int rangeSize = current->getRangeSize(int(ti));
+		packed = nvdata->nvdata.get() == current && nvdata->_range == int(ti) && (nvdata->isGrowable() ? rangeSize >= nvdata->initialParticleCount() : rangeSize == nvdata->getMaxPtsCount());
+	}
+	if (packed)return true;
 
-			}
-		}
+	std::vector<int> sizes(targets.size());
+	int total = 0;
+	for (size_t ti = 0; ti < targets.size(); ++ti) {
+		sizes[ti] = targets[ti].nvdata->initialParticleCount();
+		total += sizes[ti];
+	}
+	std::shared_ptr<SIM_NvFlexData::NvFlexContainerWrapper> shared;
+	try {
+		shared = SIM_NvFlexData::createContainer(total);
+		shared->setRanges(sizes);
+	}
+	catch (...) {
+		for (size_t ti = 0; ti < targets.size(); ++ti)addError(targets[ti].obj, SIM_BADSUBDATA, "could not create shared NvFlex container for objects of the solver", UT_ERROR_ABORT);
+		return false;
+	}
+	for (size_t ti = 0; ti < targets.size(); ++ti)targets[ti].nvdata->resetContainer(shared, int(ti));
+	messageLog(3, "packed %d objects into one shared container of %d particles\n", int(targets.size()), total);
+	return true;
+}
 
-		
-		
-		
-		// Updating collision Geometry.
-		// TODO: kill/deactivate meshes that are no longer in relationships
-		{
-			NvFlexHCollisionData* colldata = consolv->collisionData();
-			colldata->mapall();
-			/*
-			colldata->addSphere("test");
-			colldata->getSphere("test").collgeo->radius = 1.0f;
-			colldata->getSphere("test").position->y = 1.0f;
-			colldata->getSphere("test").prevposition->y = 1.0f;
-			*/
-
-			//find collision relationships and build collisions
-			SIM_ConstObjectArray affs;
-			obj->getConstAffectors(affs, "SIM_RelationshipCollide");
-			for (exint afi = 0; afi < affs.entries(); ++afi) {
-				const SIM_Object* aff = affs(afi);
-				if (aff == obj)continue;
-				const SIM_Geometry*affgeo = SIM_DATA_GETCONST(*aff, SIM_GEOMETRY_DATANAME, SIM_Geometry);
-				if (affgeo == NULL)continue;
-
-				std::string objidname = std::to_string(aff->getObjectId());
-				
-				GU_DetailHandleAutoReadLock hlk(affgeo->getGeometry());
-				const GU_Detail *gdp = hlk.getGdp();
-				int64 pDataId=gdp->getP()->getDataId();
-								
-				if(pDataId != colldata->getStoredHash(objidname)) { //TODO: why why why have i ever desiced to use strings for keys??? there must have been a reason, right?
-					messageLog(5, "updating collision mesh %s\n", objidname.c_str());
-					colldata->setStoredHash(objidname, pDataId); 
-					colldata->addTriangleMesh(objidname);
-					NvfTrimeshGeo trigeo=colldata->getTriangleMesh(objidname);
-
-					NvFlexHTriangleMeshAutoMapper tmeshlock(trigeo.collgeo);
-
-
-					GA_Offset off;
-					tmeshlock.setVertexCount(gdp->getNumPoints());
-					Vec3* trigeop = tmeshlock.vertices();
-					float* trigeolw = tmeshlock.lower();
-					float* trigeoup = tmeshlock.upper();
-					trigeoup[0] = trigeoup[1] = trigeoup[2] = -FLT_MAX;
-					trigeolw[0] = trigeolw[1] = trigeolw [2] = FLT_MAX;
-					GA_FOR_ALL_PTOFF(gdp, off) {
-						UT_Vector3 p=gdp->getPos3(off);
-						Vec3* currtgp = trigeop + gdp->pointIndex(off);
-						currtgp->x = p.x();
-						currtgp->y = p.y();
-						currtgp->z = p.z();
-						trigeolw[0] = std::min(p.x(), trigeolw[0]);
-						trigeolw[1] = std::min(p.y(), trigeolw[1]);
-						trigeolw[2] = std::min(p.z(), trigeolw[2]);
-						trigeoup[0] = std::max(p.x(), trigeoup[0]);
-						trigeoup[1] = std::max(p.y(), trigeoup[1]);
-						trigeoup[2] = std::max(p.z(), trigeoup[2]);
-					}
-
-					//now we need to calculate triangles
-					GA_Size tricount = 0;
-					for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
-						tricount += std::max(gdp->getPrimitiveVertexCount(*it) - 2, GA_Size(0));
-					}
-					tmeshlock.setTrianglesCount(tricount);
-					//now set triangles!
-					size_t i = 0;
-					int* trigeot = tmeshlock.triangles();
-					for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
-						GA_OffsetListRef pvlr=gdp->getPrimitiveVertexList(*it);
-						GA_Index sttidx = -1;
-						GA_Index prvidx = -1;
-						for (int vi = 0; vi < pvlr.entries(); ++vi) {
-							GA_Index idx = gdp->pointIndex(gdp->vertexPoint(pvlr(vi)));//gdp->vertexIndex(pvlr(vi));//
-							if (vi == 0)sttidx = idx;
-							else if (vi > 1) {
-								//invert order cuz houdini goes clockwise
-								trigeot[i++] = sttidx;
-								trigeot[i++] = idx;
-								trigeot[i++] = prvidx;
-							}
-							prvidx = idx;
-						}
-					}
+void SIM_NvFlexSolver::solveGroup(SIM_Engine &engine, std::vector<NvFlexHSolveTarget> &targets, const SIM_Time &timestep) {
+	std::shared_ptr<SIM_NvFlexData::NvFlexContainerWrapper> consolv = targets[0].nvdata->nvdata;
+	NvFlexHStepStats groupStats; //everything done once for the whole container
+	const int64 bytesUpBefore = consolv->getUploadedBytes();
+	const int64 bytesDownBefore = consolv->getDownloadedBytes();
+	const exint allocsBefore = consolv->getBufferAllocCount();
 
-				}
+	{
+		NvFlexHPhaseTimer growTimer(groupStats, NVFLEXH_PHASE_INGEST);
+		growContainer(targets, consolv.get());
+	}
 
-				//update aff position
-				const SIM_Position* affpos = aff->getPosition();
-				if (affpos != NULL) {
-					UT_Vector3 pos = affpos->selfToWorld(UT_Vector3()); // not with getpos cuz there is shitty pivot, so its less code just to do like this.
-					UT_Quaternion rot;
-					affpos->getOrientation(rot);
-					NvfTrimeshGeo trigeo = colldata->getTriangleMesh(objidname); //TODO: think of a bit of restructurizing collision data, cuz here we need only the common pos-rot-shit thing, and we dont need to specifically get triangle mesh - it can be sdf or whatever as well
-					if (trigeo.collgeo != NULL) { //just for rare case the object data was not created in loop before
-						trigeo.updatePosition(Vec4(pos[0], pos[1], pos[2], 1));
-						trigeo.updateRotation(Quat(rot[0], rot[1], rot[2], rot[3]));
-					}
-				}
+	// Getting old geometry and shoving it into NvFlex buffers
+	int dirtyChannels = NVFLEXH_CHANNEL_NONE;
+	for (auto it = targets.begin(); it != targets.end();) {
+		if (ingestParticles(*it, consolv.get(), dirtyChannels))++it;
+		else it = targets.erase(it);
+	}
+	if (targets.empty())return;
+	if (dirtyChannels != NVFLEXH_CHANNEL_NONE) {
+		NvFlexHPhaseTimer ingestTimer(groupStats, NVFLEXH_PHASE_INGEST);
+		//Push NvFlex data to GPU. since it's async - we need to do it as far from the solver tick as possible to use this time to do CPU work
+		consolv->pushParticlesToDevice(dirtyChannels); //This pushes only changed particle channels. so collisions, springs and triangles we can push separately.
+	}
 
-			}
+	//NOW PRIMITIVES
+	{
+		NvFlexHPhaseTimer constraintsTimer(groupStats, NVFLEXH_PHASE_CONSTRAINTS);
+		updateConstraints(targets, consolv.get());
+	}
+
+	// Updating collision Geometry.
+	// shapes no longer in relationships are evicted after colliderGracePeriod steps
+	{
+		NvFlexHPhaseTimer collisionTimer(groupStats, NVFLEXH_PHASE_COLLISION);
+		updateCollisions(targets, consolv.get());
+	}
 
-			colldata->unmapall();
-			colldata->setCollisionData(consolv->solver());
+	nvparams.numIterations = getIterations();
+	int substeps = getSubsteps();
+	NvFlexHPhaseTimer paramsTimer(groupStats, NVFLEXH_PHASE_PARAMS);
+	NvFlexGetParams(consolv->solver(), &nvparams);
+	updateSolverParams();
+	//Find and apply gravity. there is one gravity per flex solver, so with shared container the first object's forces are used
+	{
+		const SIM_Object *obj = targets[0].obj;
+		SIM_ConstDataArray gravities;
+		obj->filterConstSubData(gravities, 0, SIM_DataFilterByType("SIM_ForceGravity"), SIM_FORCES_DATANAME, SIM_DataFilterNone());
+		for (exint i = 0; i < gravities.entries(); ++i) {
+			const SIM_ForceGravity* force = SIM_DATA_CASTCONST(gravities(i), SIM_ForceGravity);
+			if (force == NULL)continue;
+			UT_Vector3 outForce, outTorque;
+			force->getForce(*obj, UT_Vector3(), UT_Vector3(), UT_Vector3(), 1.0f, outForce,outTorque);
+
+			nvparams.gravity[0] += outForce.x();
+			nvparams.gravity[1] += outForce.y();
+			nvparams.gravity[2] += outForce.z();
 		}
+	}
+	NvFlexSetParams(consolv->solver(), &nvparams);
+	paramsTimer.stop();
 
+	//NvFlexExtTickContainer(consolv->container(), timestep, substeps, false);
+	messageLog(5, "timestep %f\n", (float)timestep);
+	{
+		NvFlexHPhaseTimer solveTimer(groupStats, NVFLEXH_PHASE_SOLVE);
+		NvFlexUpdateSolver(consolv->solver(), timestep, substeps, false);
+	}
+	consolv->markStepped();
+	for (size_t ti = 0; ti < targets.size(); ++ti)targets[ti].nvdata->_stateStep = consolv->getStepCount();
+
+	//only channels the output asks for are read back and written. geometry copies of the others go stale,
+	//so ingest never takes them for particles that already exist, see SIM_NvFlexData::_geoChannels
+	int readbackChannels = NVFLEXH_CHANNEL_NONE;
+	if (getReadbackP() != 0)readbackChannels |= NVFLEXH_CHANNEL_PARTICLES;
+	if (getReadbackV() != 0)readbackChannels |= NVFLEXH_CHANNEL_VELOCITIES;
+	if (getReadbackPhs() != 0)readbackChannels |= NVFLEXH_CHANNEL_PHASES;
+	if (getReadbackRest() != 0)readbackChannels |= NVFLEXH_CHANNEL_REST;
+	const bool readbackIid = getReadbackIid() != 0;
+
+	{
+		NvFlexHPhaseTimer pullTimer(groupStats, NVFLEXH_PHASE_PULL);
+		consolv->pullParticlesFromDevice(readbackChannels);
+		if (consolv->getRigidCount() > 0)consolv->pullRigidsFromDevice();
+	}
 
-		nvparams.numIterations = getIterations();
-		int substeps = getSubsteps();
-		NvFlexGetParams(consolv->solver(), &nvparams);
-		updateSolverParams();
-		//Find and apply gravity
-		{
-			SIM_ConstDataArray gravities;
-			obj->filterConstSubData(gravities, 0, SIM_DataFilterByType("SIM_ForceGravity"), SIM_FORCES_DATANAME, SIM_DataFilterNone());
-			for (exint i = 0; i < gravities.entries(); ++i) {
-				const SIM_ForceGravity* force = SIM_DATA_CASTCONST(gravities(i), SIM_ForceGravity);
-				if (force == NULL)continue;
-				UT_Vector3 outForce, outTorque;
-				force->getForce(*obj, UT_Vector3(), UT_Vector3(), UT_Vector3(), 1.0f, outForce,outTorque);
-
-				nvparams.gravity[0] += outForce.x();
-				nvparams.gravity[1] += outForce.y();
-				nvparams.gravity[2] += outForce.z();
-			}
+	//params go both ways every step
+	groupStats.bytesUp = consolv->getUploadedBytes() - bytesUpBefore + sizeof(NvFlexParams);
+	groupStats.bytesDown = consolv->getDownloadedBytes() - bytesDownBefore + sizeof(NvFlexParams);
+	groupStats.bufferAllocs = consolv->getBufferAllocCount() - allocsBefore;
+
+	//with a shared container, solve, pull and transfers are of the whole container, so they go into one row of their own
+	const bool sharedStats = targets.size() > 1;
+	for (size_t ti = 0; ti < targets.size(); ++ti)writebackObject(engine, targets[ti], consolv.get(), readbackChannels, readbackIid, groupStats, sharedStats);
+	if (!sharedStats)return;
+	messageLog(5, "shared container step took %f ms (solve %f, pull %f), %lld bytes up, %lld bytes down, %lld buffer reallocations\n", groupStats.totalMs(), groupStats.ms[NVFLEXH_PHASE_SOLVE], groupStats.ms[NVFLEXH_PHASE_PULL], groupStats.bytesUp, groupStats.bytesDown, groupStats.bufferAllocs);
+	UT_String statsLog;
+	getStatsLogFile(statsLog);
+	if (statsLog.isstring() && !groupStats.appendCsv(statsLog.c_str(), engine.getSimulationTime(), "<shared>", consolv->getActiveCount())) {
+		messageLog(1, "could not write step statistics to %s\n", statsLog.c_str());
+	}
+}
+
+void SIM_NvFlexSolver::growContainer(std::vector<NvFlexHSolveTarget> &targets, NvFlexHContainer *consolv) {
+	std::vector<int> sizes(consolv->getRangeCount());
+	for (int r = 0; r < consolv->getRangeCount(); ++r)sizes[r] = consolv->getRangeSize(r);
+	bool grow = false;
+	for (size_t ti = 0; ti < targets.size(); ++ti) {
+		SIM_NvFlexData *nvdata = targets[ti].nvdata;
+		if (!nvdata->isGrowable())continue;
+		const SIM_Geometry *geo = SIM_DATA_GETCONST(*targets[ti].obj, "Geometry", SIM_Geometry);
+		if (geo == NULL)continue;
+		GU_DetailHandleAutoReadLock lock(geo->getGeometry());
+		if (!lock.isValid())continue;
+		const int range = std::max(nvdata->_range, 0);
+		const GA_Size npoints = lock.getGdp()->getNumPoints();
+		if (npoints <= sizes[range])continue;
+		sizes[range] = SIM_NvFlexData::grownParticleCount(sizes[range], int(std::min(npoints, GA_Size(INT_MAX))));
+		grow = true;
+	}
+	if (!grow)return;
+
+	const int oldMax = consolv->getMaxParticles();
+	try {
+		consolv->growRanges(sizes);
+	}
+	catch (std::runtime_error &e) {
+		//objects that don't fit will fail in ingest
+		messageLog(1, "could not grow NvFlex container: %s\n", e.what());
+		return;
+	}
+	messageLog(3, "NvFlex container grown from %d to %d particles\n", oldMax, consolv->getMaxParticles());
+}
+
+bool SIM_NvFlexSolver::ingestParticles(NvFlexHSolveTarget &target, NvFlexHContainer *consolv, int &dirtyChannels) {
+	SIM_Object *obj = target.obj;
+	SIM_NvFlexData *nvdata = target.nvdata;
+	const SIM_Geometry *geo=SIM_DATA_GETCONST(*obj, "Geometry", SIM_Geometry);
+	if (geo == NULL)return true;
+	GU_DetailHandleAutoReadLock lock(geo->getGeometry());
+	if (!lock.isValid())return true;
+
+	const GU_Detail *gdp = lock.getGdp();
+	int64 ndid = gdp->getP()->getDataId();
+	int64 nvdid = attribDataId(gdp->findPointAttribute("v"));
+	int64 nmdid = attribDataId(gdp->findPointAttribute("imass"));
+	int64 nphsdid = attribDataId(gdp->findPointAttribute("phs"));
+	int64 nrdid = attribDataId(gdp->findPointAttribute("restP"));
+
+	int64 ntopdid = gdp->getTopology().getDataId();
+	messageLog(5, "P data id = %lld\n", ndid);
+
+	if (nvdata->_restored) {
+		//container came from a checkpoint together with this geometry. it already has all of it and what geometry doesn't keep,
+		//so current data ids are taken as ingested instead of overwriting restored state. topology plan is made for the restored indices
+		nvdata->_restored = false;
+		if (gdp->getNumPoints() == nvdata->updateActiveIndices()) {
+			nvdata->_lastGdpPId = ndid;
+			nvdata->_lastGdpVId = nvdid;
+			nvdata->_lastGdpIMassId = nmdid;
+			nvdata->_lastGdpPhsId = nphsdid;
+			nvdata->_lastGdpRestId = nrdid;
+			nvdata->_lastGdpTId = ntopdid;
+			nvdata->_lastGdpStrId = attribDataId(gdp->findPrimitiveAttribute("strength"));
+			nvdata->_lastGdpRlId = attribDataId(gdp->findPrimitiveAttribute("restlength"));
+			if (gdp->getNumPrimitives() > 0)nvdata->_topology->build(gdp, nvdata->_indices.get(), ntopdid, attribDataId(gdp->findPrimitiveAttribute("rgd_isrigid")), nvdata->_indicesVersion);
+			return true;
 		}
-		NvFlexSetParams(consolv->solver(), &nvparams);
+		messageLog(3, "restored nvflex state does not match geometry point count, geometry is taken instead\n");
+		nvdata->_geoChannels = NVFLEXH_CHANNEL_ALL;
+	}
 
-		//NvFlexExtTickContainer(consolv->container(), timestep, substeps, false);
-		messageLog(5, "timestep %f\n", (float)timestep);
-		NvFlexUpdateSolver(consolv->solver(), timestep, substeps, false);
+	//every device channel is tracked by data ids of attributes it is made of
+	int objDirtyChannels = NVFLEXH_CHANNEL_NONE;
+	const bool topologyChanged = ntopdid != nvdata->_lastGdpTId;
+	if (ndid != nvdata->_lastGdpPId || nmdid != nvdata->_lastGdpIMassId)objDirtyChannels |= NVFLEXH_CHANNEL_PARTICLES;
+	if (nrdid != nvdata->_lastGdpRestId)objDirtyChannels |= NVFLEXH_CHANNEL_REST;
+	if (nvdid != nvdata->_lastGdpVId)objDirtyChannels |= NVFLEXH_CHANNEL_VELOCITIES;
+	if (nphsdid != nvdata->_lastGdpPhsId)objDirtyChannels |= NVFLEXH_CHANNEL_PHASES;
+	if (objDirtyChannels == NVFLEXH_CHANNEL_NONE && !topologyChanged)return true;
 
-		NvFlexExtPullFromDevice(consolv->container());
-		if (consolv->getRigidCount() > 0)consolv->pullRigidsFromDevice();
+	NvFlexHPhaseTimer ingestTimer(target.stats, NVFLEXH_PHASE_INGEST);
+	messageLog(5, "found geo, new id !! old P id: %lld. old v id: %lld. old topo id: %lld. dirty channels: %d\n", nvdata->_lastGdpPId, nvdata->_lastGdpVId, nvdata->_lastGdpTId, objDirtyChannels);
 
-		SIM_GeometryCopy *newgeo=SIM_DATA_CREATE(*obj, "Geometry", SIM_GeometryCopy, SIM_DATA_RETURN_EXISTING | SIM_DATA_ADOPT_EXISTING_ON_DELETE);
-		if (newgeo == NULL)continue;//TODO: show error;
-		GU_DetailHandleAutoWriteLock lock(newgeo->getOwnGeometry());
-		if (lock.isValid()) {
-			GU_Detail *gdp = lock.getGdp();
-
-			int* const iindex = nvdata->_indices.get(); //TODO: indices dont change - if we got them before solve - keep them!
-			const int nactives = NvFlexExtGetActiveList(consolv->container(), iindex); //HERE I REEEEALLY HOPE nooe accesses it right now (iindex shared array i mean) 
-			
-			const bool recreateGeo = nactives != gdp->getNumPoints(); //This basically should never happen with current workflow.
-			if (recreateGeo) {
-				messageLog(1, "recreate==true. geo inconsistent. %d vs %lld\n", nactives, gdp->getNumPoints());
-			}
+	//we just search for attribs, not creating them cuz for now we work with RO geometry
 
-			if(recreateGeo)gdp->stashAll();
+	GA_ROHandleV3 phnd(gdp->getP());
+	GA_ROHandleV3 vhnd(gdp->findPointAttribute("v"));
+	GA_ROHandleI ihnd(gdp->findPointAttribute("iid"));
+	GA_ROHandleI phshnd(gdp->findPointAttribute("phs"));
+	GA_ROHandleF mhnd(gdp->findPointAttribute("imass"));
 
-			//GA_RWAttributeRef vatt = gdp->findPointAttribute("v");//
-			GA_RWAttributeRef vatt = gdp->findFloatTuple(GA_ATTRIB_POINT, "v", 3, 3);
-			if (!vatt.isValid()) {
-				vatt = gdp->addFloatTuple(GA_ATTRIB_POINT, "v", 3, GA_Defaults(0));
-				vatt.setTypeInfo(GA_TYPE_VECTOR);
+	int nactives = nvdata->updateActiveIndices(); //refetched only if particles were allocated or freed
+	int* indices = nvdata->_indices.get(); //after the update, it reallocates if container has grown
+
+	if (!(phnd.isValid() && vhnd.isValid() && ihnd.isValid() && phshnd.isValid() && mhnd.isValid()))return true;
+
+	const GA_Size ngdpoints = gdp->getNumPoints();
+	if (ngdpoints > consolv->getRangeSize(std::max(nvdata->_range, 0))) {
+		addError(obj, SIM_BADSUBDATA, nvdata->isGrowable() ? "NvFlex container could not grow to geometry pointcount (insufficient GPU resources?)" : "Geometry pointcount exceeds maximum pointcound allocated by NvData! set it to 0 to grow as needed", UT_ERROR_ABORT);
+		return false;
+	}
+
+	bool reget = false;
+	std::vector<char> newParticles; //by particle id, ones allocated right now
+	if (nactives < ngdpoints) {
+		int nptscount = consolv->allocParticles(ngdpoints - nactives, indices, std::max(nvdata->_range, 0)); //whoa! carefull with that! your luck the mapped buffer is not reallocated during this operation!
+		newParticles.assign(consolv->getMaxParticles(), 0);
+		for (int npi = 0; npi < nptscount; ++npi)newParticles[indices[npi]] = 1;
+		reget = true;
+	}
+	else if (nactives > ngdpoints) {
+		consolv->freeParticles(nactives - ngdpoints, indices);
+		reget = true;
+	}
+	if (reget)nactives = nvdata->updateActiveIndices();
+	int newChannels = NVFLEXH_CHANNEL_NONE;
+	if (reget || topologyChanged) {
+		//particle to point mapping may have changed. geometry has live values only of channels written back last step, those are taken
+		//for every particle. other channels of existing particles stay as device has them, only new particles take them from geometry
+		const int remapped = NVFLEXH_CHANNEL_ALL & ~objDirtyChannels;
+		objDirtyChannels |= remapped & nvdata->_geoChannels;
+		if (!newParticles.empty())newChannels = remapped & ~nvdata->_geoChannels;
+	}
+	if ((objDirtyChannels | newChannels) == NVFLEXH_CHANNEL_NONE)return true;
+
+	NvFlexExtParticleData pdat = consolv->mapParticleData(objDirtyChannels | newChannels);
+
+	auto ingestStart = std::chrono::steady_clock::now();
+	pushGeoToParticles(gdp, pdat, indices, nactives, objDirtyChannels, nvdata->phaseGroupOffset(), newChannels, newParticles.empty() ? NULL : newParticles.data());
+	messageLog(5, "particle ingest of %lld points took %f ms on %d threads\n", ngdpoints, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ingestStart).count(), UT_Thread::getNumProcessors());
+
+	consolv->unmapParticleData();
+	dirtyChannels |= objDirtyChannels | newChannels;
+	return true;
+}
+
+void SIM_NvFlexSolver::updateConstraints(std::vector<NvFlexHSolveTarget> &targets, NvFlexHContainer *consolv) {
+	//every object has its own slice of container's spring, triangle and rigid buffers, in target order
+	//if any object's constraints have to be rebuilt, all slices are written again, cuz their sizes may shift
+	bool rebuild = false;
+	bool restLengthsChanged = false;
+	bool strengthsChanged = false;
+	for (size_t ti = 0; ti < targets.size(); ++ti) {
+		NvFlexHSolveTarget &target = targets[ti];
+		SIM_NvFlexData *nvdata = target.nvdata;
+		const SIM_Geometry *geo = SIM_DATA_GETCONST(*target.obj, "Geometry", SIM_Geometry);
+		if (geo == NULL)continue;
+		GU_DetailHandleAutoReadLock lock(geo->getGeometry());
+		if (!lock.isValid())continue;
+		const GU_Detail *gdp = lock.getGdp();
+		target.hasGeometry = true;
+
+		if (gdp->getNumPrimitives() == 0) {
+			//constraints it had before have to go
+			if (nvdata->_springCount > 0 || nvdata->_triangleCount > 0 || nvdata->_rigidCount > 0)rebuild = true;
+			continue;
+		}
+		target.hasSprings = gdp->findPrimitiveAttribute("restlength") != NULL && gdp->findPrimitiveAttribute("strength") != NULL;
+		target.hasRigids = gdp->findPrimitiveAttribute("rgd_translation") != NULL && gdp->findPrimitiveAttribute("rgd_rotation") != NULL &&
+			gdp->findVertexAttribute("rgd_restP") != NULL && gdp->findVertexAttribute("rgd_restN") != NULL && gdp->findVertexAttribute("rgd_sdf") != NULL &&
+			gdp->findPrimitiveAttribute("rgd_stiffness") != NULL && gdp->findPrimitiveAttribute("rgd_isrigid") != NULL;
+		target.triNormalType = NvFlexHTopologyPlan::triangleNormalType(gdp);
+		const int64 ntopdid = gdp->getTopology().getDataId();
+		const int64 nrgdid = attribDataId(gdp->findPrimitiveAttribute("rgd_isrigid"));
+
+		nvdata->updateActiveIndices();
+
+		const int64 nstrdid = attribDataId(gdp->findPrimitiveAttribute("strength"));
+		const int64 nrldid = attribDataId(gdp->findPrimitiveAttribute("restlength"));
+		target.strengthChanged = nstrdid != nvdata->_lastGdpStrId;
+		target.restLengthChanged = nrldid != nvdata->_lastGdpRlId;
+		const bool topologyChanged = ntopdid != nvdata->_lastGdpTId;
+		const NvFlexHTopologyPlan *topo = nvdata->_topology.get();
+		//when only spring parameters changed and the plan still matches, springs already on device have right indices
+		target.springParamsOnly = target.hasSprings && !topologyChanged && (target.strengthChanged || target.restLengthChanged) &&
+			topo->isValid(ntopdid, nrgdid, nvdata->_indicesVersion) && topo->springCount() == nvdata->_springCount;
+		const bool doSprings = target.hasSprings && !target.springParamsOnly && (target.strengthChanged || target.restLengthChanged || topologyChanged);
+		const bool doTriangles = topologyChanged;
+		const bool doRigids = target.hasRigids && topologyChanged;
+		//plan also goes stale when particle ids move without a topology change (container grown, state restored)
+		//its slices are rewritten then, rigid writeback relies on a valid plan
+		const bool planStale = !topo->isValid(ntopdid, nrgdid, nvdata->_indicesVersion);
+		if (doSprings || doTriangles || doRigids || planStale)rebuild = true;
+		if (target.springParamsOnly) {
+			restLengthsChanged |= target.restLengthChanged;
+			strengthsChanged |= target.strengthChanged;
+		}
+	}
+
+	if (rebuild) {
+		//first pass lays out slices, building plans where needed
+		GA_Size totalspringcount = 0, totaltrianglecount = 0, totalrigidcount = 0, totalrigidindices = 0;
+		std::vector<int> rigidSizes;
+		bool pushNormals = true; //flex takes triangle normals for all triangles or for none
+		bool anyTriangles = false;
+		for (size_t ti = 0; ti < targets.size(); ++ti) {
+			NvFlexHSolveTarget &target = targets[ti];
+			SIM_NvFlexData *nvdata = target.nvdata;
+			nvdata->_springBase = int(totalspringcount);
+			nvdata->_triangleBase = int(totaltrianglecount);
+			nvdata->_rigidBase = int(totalrigidcount);
+			nvdata->_rigidIndexBase = int(totalrigidindices);
+			nvdata->_springCount = nvdata->_triangleCount = nvdata->_rigidCount = 0;
+			if (!target.hasGeometry)continue;
+			const SIM_Geometry *geo = SIM_DATA_GETCONST(*target.obj, "Geometry", SIM_Geometry);
+			GU_DetailHandleAutoReadLock lock(geo->getGeometry());
+			const GU_Detail *gdp = lock.getGdp();
+			if (gdp->getNumPrimitives() == 0)continue;
+
+			NvFlexHTopologyPlan *topo = nvdata->_topology.get();
+			const int64 ntopdid = gdp->getTopology().getDataId();
+			const int64 nrgdid = attribDataId(gdp->findPrimitiveAttribute("rgd_isrigid"));
+			if (!topo->isValid(ntopdid, nrgdid, nvdata->_indicesVersion)) {
+				auto topoStart = std::chrono::steady_clock::now();
+				topo->build(gdp, nvdata->_indices.get(), ntopdid, nrgdid, nvdata->_indicesVersion);
+				messageLog(5, "topology plan of %lld prims took %f ms\n", gdp->getNumPrimitives(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - topoStart).count());
 			}
-			//GA_RWAttributeRef iidatt = gdp->findPointAttribute("iid");
-			GA_RWAttributeRef iidatt = gdp->findIntTuple(GA_ATTRIB_POINT, "iid", 1, 1);
-			if (!iidatt.isValid()) {
-				iidatt = gdp->addIntTuple(GA_ATTRIB_POINT, "iid", 1, GA_Defaults(-1));
+			nvdata->_springCount = target.hasSprings ? int(topo->springCount()) : 0;
+			nvdata->_triangleCount = int(topo->triangleCount());
+			nvdata->_rigidCount = target.hasRigids ? int(topo->rigidCount()) : 0;
+			totalspringcount += nvdata->_springCount;
+			totaltrianglecount += nvdata->_triangleCount;
+			totalrigidcount += nvdata->_rigidCount;
+			if (target.hasRigids) {
+				const std::vector<int> sizes = topo->rigidSizes();
+				rigidSizes.insert(rigidSizes.end(), sizes.begin(), sizes.end());
+				totalrigidindices += topo->rigidIndicesCount();
 			}
-			//GA_RWAttributeRef phsatt = gdp->findPointAttribute("phs");
-			GA_RWAttributeRef phsatt = gdp->findIntTuple(GA_ATTRIB_POINT, "phs", 1, 1);
-			if (!phsatt.isValid()) {
-				phsatt = gdp->addIntTuple(GA_ATTRIB_POINT, "phs", 1, GA_Defaults(0));
+			if (nvdata->_triangleCount > 0) {
+				anyTriangles = true;
+				pushNormals = pushNormals && target.triNormalType > 0;
 			}
-			GA_RWHandleV3 vhd(vatt);
-			GA_RWHandleI iidhd(iidatt);
-			GA_RWHandleI phshd(phsatt);
-
-			
-			NvFlexExtParticleData pdat = NvFlexExtMapParticleData(consolv->container());	//mapping
-			
-			// get indices and go through active indices!
-			if(recreateGeo)GA_Offset off = gdp->appendPointBlock(nactives);
-
-			GA_Offset ostt, oend;
-			for (GA_Iterator oit(gdp->getPointRange()); oit.blockAdvance(ostt, oend);) { //TODO: make it threaded after debugged
-				for (GA_Offset curroff = ostt; curroff < oend; ++curroff) {
-					UT_Vector3 pp;
-					int ii = iindex[gdp->pointIndex(curroff)];
-					pp.assign(pdat.particles[ii * 4 + 0], pdat.particles[ii * 4 + 1], pdat.particles[ii * 4 + 2]);
-					gdp->setPos3(curroff, pp);
-					pp.assign(pdat.velocities[ii * 3 + 0], pdat.velocities[ii * 3 + 1], pdat.velocities[ii * 3 + 2]);
-					vhd.set(curroff, pp);
-					iidhd.set(curroff, ii);
-					phshd.set(curroff, pdat.phases[ii]);
-				}
+		}
+		pushNormals = pushNormals && anyTriangles;
+
+		consolv->resizeSpringData(totalspringcount);
+		consolv->resizeTriangleData(totaltrianglecount);
+		consolv->resizeRigidData(totalrigidcount, rigidSizes);
+		messageLog(5, "total springs count: %lld\n", totalspringcount);
+		messageLog(5, "total triangles count: %lld\n", totaltrianglecount);
+		messageLog(5, "total rigids count: %lld\n", totalrigidcount);
+
+		auto sprdat = consolv->mapSpringData();
+		auto tridat = consolv->mapTriangleData();
+		auto rgddat = consolv->mapRigidData();
+		for (size_t ti = 0; ti < targets.size(); ++ti) {
+			const NvFlexHSolveTarget &target = targets[ti];
+			const SIM_NvFlexData *nvdata = target.nvdata;
+			if (nvdata->_springCount == 0 && nvdata->_triangleCount == 0 && nvdata->_rigidCount == 0)continue;
+			const SIM_Geometry *geo = SIM_DATA_GETCONST(*target.obj, "Geometry", SIM_Geometry);
+			GU_DetailHandleAutoReadLock lock(geo->getGeometry());
+			const GU_Detail *gdp = lock.getGdp();
+			const NvFlexHTopologyPlan *topo = nvdata->_topology.get();
+
+			const int sbase = nvdata->_springBase;
+			const int tbase = nvdata->_triangleBase;
+			const int rbase = nvdata->_rigidBase;
+			const int ibase = nvdata->_rigidIndexBase;
+			if (nvdata->_springCount > 0)topo->writeSprings(gdp, sprdat.springIds + sbase * 2, sprdat.springRls + sbase, sprdat.springSts + sbase);
+			if (nvdata->_triangleCount > 0)topo->writeTriangles(gdp, tridat.triangleIds + tbase * 3, pushNormals ? tridat.triangleNms + tbase * 3 : NULL);
+			if (nvdata->_rigidCount > 0) {
+				topo->writeRigids(gdp, rgddat.offsets + rbase, rgddat.indices + ibase, rgddat.restPositions + ibase * 3, rgddat.restNormals + ibase * 4, rgddat.stiffness + rbase, rgddat.rotations + rbase * 4, rgddat.translations + rbase * 3);
+				//plan offsets start from 0
+				for (int ri = 0; ri <= nvdata->_rigidCount; ++ri)rgddat.offsets[rbase + ri] += ibase;
 			}
-			NvFlexExtUnmapParticleData(consolv->container());//unmapping
+		}
+		consolv->unmapSpringData();
+		consolv->unmapTriangleData();
+		consolv->unmapRigidData();
 
+		consolv->pushSpringsToDevice();
+		consolv->pushTrianglesToDevice(pushNormals);
+		consolv->pushRigidsToDevice();
+	}
+	else if (restLengthsChanged || strengthsChanged) {
+		auto springParamsStart = std::chrono::steady_clock::now();
+		auto sprdat = consolv->mapSpringParams(restLengthsChanged, strengthsChanged);
+		for (size_t ti = 0; ti < targets.size(); ++ti) {
+			const NvFlexHSolveTarget &target = targets[ti];
+			if (!target.springParamsOnly)continue;
+			const SIM_NvFlexData *nvdata = target.nvdata;
+			const SIM_Geometry *geo = SIM_DATA_GETCONST(*target.obj, "Geometry", SIM_Geometry);
+			GU_DetailHandleAutoReadLock lock(geo->getGeometry());
+			const int sbase = nvdata->_springBase;
+			nvdata->_topology->writeSprings(lock.getGdp(), NULL, target.restLengthChanged ? sprdat.springRls + sbase : NULL, target.strengthChanged ? sprdat.springSts + sbase : NULL);
+		}
+		consolv->unmapSpringParams();
+		consolv->pushSpringParamsToDevice(restLengthsChanged, strengthsChanged);
+		messageLog(5, "spring params update of %d springs took %f ms\n", consolv->getSpringsCount(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - springParamsStart).count());
+	}
+}
 
-			//Now update rigids
-			GA_ROHandleI prgdhnd(gdp->findPrimitiveAttribute("rgd_isrigid"));
-			if (prgdhnd.isValid() && consolv->getRigidCount() > 0) {
-				GA_RWAttributeRef ptrsat = gdp->findFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_translation", 3, 3);
-				if (!ptrsat.isValid()) {
-					ptrsat = gdp->addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_translation", 3);
-				}
-				GA_RWAttributeRef protat = gdp->findFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_rotation", 4, 4);
-				if (!protat.isValid()) {
-					protat = gdp->addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_rotation", 3);
-				}
-				GA_RWHandleV3 ptrshnd(ptrsat);
-				GA_RWHandleV4 prothnd(protat);
-
-				auto rgdtransdata = consolv->mapRigidTransData();
-
-				GA_Size rigidNum = 0;
-				for (GA_Iterator pit(gdp->getPrimitiveRange()); !pit.atEnd(); ++pit) {
-					GA_Offset off = *pit;
-					if (prgdhnd.get(off)) {
-						UT_Vector3F trs;
-						UT_Vector4F rot;
-						trs.assign(rgdtransdata.translations[rigidNum * 3 + 0], rgdtransdata.translations[rigidNum * 3 + 1], rgdtransdata.translations[rigidNum * 3 + 2]);
-						rot.assign(rgdtransdata.rotations[rigidNum * 4 + 0], rgdtransdata.rotations[rigidNum * 4 + 1], rgdtransdata.rotations[rigidNum * 4 + 2], rgdtransdata.rotations[rigidNum * 4 + 3]);
-						ptrshnd.set(off, trs);
-						prothnd.set(off, rot);
-						++rigidNum;
-					}
-				}
+void SIM_NvFlexSolver::updateCollisions(const std::vector<NvFlexHSolveTarget> &targets, NvFlexHContainer *consolv) {
+	NvFlexHCollisionData* colldata = consolv->collisionData();
+	colldata->mapall();
+	colldata->beginStep();
+	/*
+	colldata->addSphere("test");
+	colldata->getSphere("test").collgeo->radius = 1.0f;
+	colldata->getSphere("test").position->y = 1.0f;
+	colldata->getSphere("test").prevposition->y = 1.0f;
+	*/
+
+	NvFlexHColliderOptions colliderOptions;
+	colliderOptions.analytic = getAnalyticColliders() != 0;
+	colliderOptions.analyticTolerance = getAnalyticTolerance();
+	colliderOptions.convex = getConvexColliders() != 0;
+	colliderOptions.convexMaxPlanes = getConvexMaxPlanes();
+	colliderOptions.sdfResolution = getSdfResolution();
+	colliderOptions.sdfTriangleThreshold = getSdfTriangleThreshold();
+	getSdfCacheDir(colliderOptions.sdfCacheDir);
+	colliderOptions.sdfCacheMaxBytes = int64(getSdfCacheMaxSize()) << 20;
+
+	//objects of the container collide as particles, so they are not colliders for each other.
+	//a collider shared by several objects is updated once
+	std::unordered_set<int> skip;
+	for (size_t ti = 0; ti < targets.size(); ++ti)skip.insert(targets[ti].obj->getObjectId());
+
+	//find collision relationships and build collisions
+	for (size_t ti = 0; ti < targets.size(); ++ti) {
+		SIM_ConstObjectArray affs;
+		targets[ti].obj->getConstAffectors(affs, "SIM_RelationshipCollide");
+		for (exint afi = 0; afi < affs.entries(); ++afi) {
+			const SIM_Object* aff = affs(afi);
+			if (!skip.insert(aff->getObjectId()).second)continue;
+			const SIM_Geometry*affgeo = SIM_DATA_GETCONST(*aff, SIM_GEOMETRY_DATANAME, SIM_Geometry);
+			if (affgeo == NULL)continue;
+
+			const int64 collkey = aff->getObjectId();
+			GU_DetailHandleAutoReadLock hlk(affgeo->getGeometry());
+			const NvFlexHShapeHandle shape = updateColliderShape(colldata, collkey, hlk.getGdp(), colliderOptions);
+
+			//update aff position
+			const SIM_Position* affpos = aff->getPosition();
+			if (affpos != NULL) {
+				UT_Vector3 pos = affpos->selfToWorld(UT_Vector3()); // not with getpos cuz there is shitty pivot, so its less code just to do like this.
+				UT_Quaternion rot;
+				affpos->getOrientation(rot);
+				colldata->setTransform(shape, Vec4(pos[0], pos[1], pos[2], 1), Quat(rot[0], rot[1], rot[2], rot[3])); //marks shape dirty only if it moved
+			}
+			else colldata->setTransform(shape, Vec4(0, 0, 0, 1), Quat()); //still places analytic shapes at their fitted centers
+			colldata->touch(shape);
 
-				consolv->unmapRigidTransData();
+		}
+	}
 
-			}
-			//END UPDATE RIGIDS
-
-			if(recreateGeo)gdp->destroyStashed();
-			gdp->bumpAllDataIds();
-			//gdp->getAttributes().bumpAllDataIds(GA_ATTRIB_POINT);
-			//gdp->getAttributes().bumpAllDataIds(GA_ATTRIB_PRIMITIVE);
-			nvdata->_lastGdpPId = gdp->getP()->getDataId();			//TODO: potentially there will be a whole bunch of them, so pack them up!
-			nvdata->_lastGdpTId = gdp->getTopology().getDataId();
-			nvdata->_lastGdpVId = vatt.getAttribute()->getDataId();
-			{
-				GA_Attribute *str=gdp->findPrimitiveAttribute("strength");
-				if (str != NULL)nvdata->_lastGdpStrId = str->getDataId();
-			}
+	const int evicted = colldata->collectStale(getColliderGracePeriod());
+	if (evicted > 0)messageLog(5, "evicted %d stale collision shapes, %lld meshes left in cache\n", evicted, NvFlexHTriangleMeshCache::instance().size());
+
+	colldata->unmapall();
+	if (colldata->setCollisionData(consolv->solver()))messageLog(5, "pushed %d collision shapes\n", colldata->size());
+}
 
+void SIM_NvFlexSolver::writebackObject(SIM_Engine &engine, NvFlexHSolveTarget &target, NvFlexHContainer *consolv, int readbackChannels, bool readbackIid, const NvFlexHStepStats &groupStats, bool sharedStats) {
+	SIM_Object *obj = target.obj;
+	SIM_NvFlexData *nvdata = target.nvdata;
+	NvFlexHPhaseTimer writebackTimer(target.stats, NVFLEXH_PHASE_WRITEBACK);
+	SIM_GeometryCopy *newgeo=SIM_DATA_CREATE(*obj, "Geometry", SIM_GeometryCopy, SIM_DATA_RETURN_EXISTING | SIM_DATA_ADOPT_EXISTING_ON_DELETE);
+	if (newgeo == NULL)return;//TODO: show error;
+	GU_DetailHandleAutoWriteLock lock(newgeo->getOwnGeometry());
+	if (!lock.isValid())return;
+	GU_Detail *gdp = lock.getGdp();
+
+	const int nactives = nvdata->updateActiveIndices(); //indices dont change during solve, so this is normally the map we already had before it
+	int* const iindex = nvdata->_indices.get(); //HERE I REEEEALLY HOPE nooe accesses it right now (iindex shared array i mean) 
+
+	//normally ingest has already made point and particle counts equal. if not, points are matched to particles by iid:
+	//dead ones are deleted, new ones appended, everything else keeps its attributes. iindex becomes the new point->particle map
+	bool resynced = false;
+	if (nactives != gdp->getNumPoints()) {
+		const GA_Size oldpts = gdp->getNumPoints();
+		resynced = syncPointsToParticles(gdp, iindex, nactives, consolv->getMaxParticles(), iindex);
+		messageLog(3, "output geometry had %lld points for %d particles, synced incrementally\n", oldpts, nactives);
+	}
+
+	if (resynced) {
+		//new points have nothing at all, and next step pushes them all back, so they need every channel we have
+		const int missing = (NVFLEXH_CHANNEL_PARTICLES | NVFLEXH_CHANNEL_VELOCITIES | NVFLEXH_CHANNEL_PHASES) & ~readbackChannels;
+		if (missing != NVFLEXH_CHANNEL_NONE) {
+			consolv->pullParticlesFromDevice(missing);
+			readbackChannels |= missing;
 		}
+	}
+
+	//GA_RWAttributeRef vatt = gdp->findPointAttribute("v");//
+	GA_RWAttributeRef vatt = gdp->findFloatTuple(GA_ATTRIB_POINT, "v", 3, 3);
+	if (!vatt.isValid()) {
+		vatt = gdp->addFloatTuple(GA_ATTRIB_POINT, "v", 3, GA_Defaults(0));
+		vatt.setTypeInfo(GA_TYPE_VECTOR);
+	}
+	//GA_RWAttributeRef iidatt = gdp->findPointAttribute("iid");
+	GA_RWAttributeRef iidatt = gdp->findIntTuple(GA_ATTRIB_POINT, "iid", 1, 1);
+	if (!iidatt.isValid()) {
+		iidatt = gdp->addIntTuple(GA_ATTRIB_POINT, "iid", 1, GA_Defaults(-1));
+	}
+	//GA_RWAttributeRef phsatt = gdp->findPointAttribute("phs");
+	GA_RWAttributeRef phsatt = gdp->findIntTuple(GA_ATTRIB_POINT, "phs", 1, 1);
+	if (!phsatt.isValid()) {
+		phsatt = gdp->addIntTuple(GA_ATTRIB_POINT, "phs", 1, GA_Defaults(0));
+	}
 
-		
+	//only what is written gets its data id bumped, so downstream and our own change detection see the rest as unchanged
+	std::vector<GA_Attribute*> written;
+	if (readbackChannels & NVFLEXH_CHANNEL_PARTICLES)written.push_back(gdp->getP());
+	if (readbackChannels & NVFLEXH_CHANNEL_VELOCITIES)written.push_back(vatt.getAttribute());
+	if (readbackChannels & NVFLEXH_CHANNEL_PHASES)written.push_back(phsatt.getAttribute());
+	if (readbackIid || resynced)written.push_back(iidatt.getAttribute());
+
+	GA_RWAttributeRef imassatt;
+	if (resynced) {
+		imassatt = gdp->findFloatTuple(GA_ATTRIB_POINT, "imass", 1, 1);
+		if (!imassatt.isValid())imassatt = gdp->addFloatTuple(GA_ATTRIB_POINT, "imass", 1, GA_Defaults(1));
 	}
 
-	return SIM_SOLVER_SUCCESS;
+	//restP is only created when asked for. v, iid and phs are always there cuz ingest needs them
+	GA_RWAttributeRef restatt;
+	if (readbackChannels & NVFLEXH_CHANNEL_REST) {
+		restatt = gdp->findFloatTuple(GA_ATTRIB_POINT, "restP", 3, 3);
+		if (!restatt.isValid()) {
+			restatt = gdp->addFloatTuple(GA_ATTRIB_POINT, "restP", 3, GA_Defaults(0));
+			restatt.setTypeInfo(GA_TYPE_POINT);
+		}
+		written.push_back(restatt.getAttribute());
+	}
+
+	nvdata->_geoChannels = readbackChannels & NVFLEXH_CHANNEL_ALL;
+	NvFlexExtParticleData pdat = consolv->mapParticleData(readbackChannels);	//mapping
+
+	auto writebackStart = std::chrono::steady_clock::now();
+	pullParticlesToGeo(gdp, pdat, iindex, vatt.getAttribute(), (readbackIid || resynced) ? iidatt.getAttribute() : NULL, phsatt.getAttribute(), restatt.getAttribute(), imassatt.getAttribute(), nvdata->phaseGroupOffset());
+	messageLog(5, "particle writeback of %d points took %f ms\n", nactives, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writebackStart).count());
+
+	consolv->unmapParticleData();//unmapping
+
+
+	//Now update rigids
+	//the geometry is the one we read at ingest, so rigid slots of the topology plan map right onto its primitives
+	const NvFlexHTopologyPlan *topo = nvdata->_topology.get();
+	if (!resynced && nvdata->_rigidCount > 0 && topo->isValid(gdp->getTopology().getDataId(), attribDataId(gdp->findPrimitiveAttribute("rgd_isrigid")), nvdata->_indicesVersion) && topo->rigidCount() == nvdata->_rigidCount) {
+		GA_RWAttributeRef ptrsat = gdp->findFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_translation", 3, 3);
+		if (!ptrsat.isValid()) {
+			ptrsat = gdp->addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_translation", 3);
+		}
+		GA_RWAttributeRef protat = gdp->findFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_rotation", 4, 4);
+		if (!protat.isValid()) {
+			protat = gdp->addFloatTuple(GA_ATTRIB_PRIMITIVE, "rgd_rotation", 3);
+		}
+		GA_RWHandleV3 ptrshnd(ptrsat);
+		GA_RWHandleV4 prothnd(protat);
+
+		auto rgdtransdata = consolv->mapRigidTransData();
+		const float *translations = rgdtransdata.translations + nvdata->_rigidBase * 3;
+		const float *rotations = rgdtransdata.rotations + nvdata->_rigidBase * 4;
+
+		UTparallelForLightItems(UT_BlockedRange<GA_Size>(0, topo->rigidCount()), [&](const UT_BlockedRange<GA_Size> &r) {
+			for (GA_Size rigidNum = r.begin(); rigidNum != r.end(); ++rigidNum) {
+				const GA_Offset off = topo->rigidPrims[rigidNum];
+				UT_Vector3F trs;
+				UT_Vector4F rot;
+				trs.assign(translations[rigidNum * 3 + 0], translations[rigidNum * 3 + 1], translations[rigidNum * 3 + 2]);
+				rot.assign(rotations[rigidNum * 4 + 0], rotations[rigidNum * 4 + 1], rotations[rigidNum * 4 + 2], rotations[rigidNum * 4 + 3]);
+				ptrshnd.set(off, trs);
+				prothnd.set(off, rot);
+			}
+		});
+
+		consolv->unmapRigidTransData();
+		written.push_back(ptrsat.getAttribute());
+		written.push_back(protat.getAttribute());
+
+	}
+	//END UPDATE RIGIDS
+
+	if (resynced) {
+		//points were added or removed, so topology and everything on points changed
+		gdp->bumpAllDataIds();
+		nvdata->_topology->invalidate();
+	}
+	else {
+		//topology, prim lists and attributes we did not write keep their ids, so topology plan stays valid as is
+		for (GA_Attribute *attr : written)attr->bumpDataId();
+	}
+	nvdata->_lastGdpPId = gdp->getP()->getDataId();			//TODO: potentially there will be a whole bunch of them, so pack them up!
+	//after a resync constraints on device still refer to killed particles, so next step has to take the whole geometry again
+	nvdata->_lastGdpTId = resynced ? -1 : gdp->getTopology().getDataId();
+	nvdata->_lastGdpVId = vatt.getAttribute()->getDataId();
+	nvdata->_lastGdpPhsId = phsatt.getAttribute()->getDataId();
+	nvdata->_lastGdpIMassId = attribDataId(gdp->findPointAttribute("imass"));
+	nvdata->_lastGdpRestId = attribDataId(gdp->findPointAttribute("restP"));
+	{
+		GA_Attribute *str=gdp->findPrimitiveAttribute("strength");
+		if (str != NULL)nvdata->_lastGdpStrId = str->getDataId();
+		GA_Attribute *rl = gdp->findPrimitiveAttribute("restlength");
+		if (rl != NULL)nvdata->_lastGdpRlId = rl->getDataId();
+	}
+	writebackTimer.stop();
+
+	//an own container's work is all this object's. a shared one's is counted once by solveGroup and only shown here as nvflex_shared_*
+	NvFlexHStepStats stepStats = target.stats;
+	if (!sharedStats)stepStats.add(groupStats);
+	messageLog(5, "step took %f ms (solve %f, pull %f), %lld bytes up, %lld bytes down, %lld buffer reallocations\n", stepStats.totalMs(), stepStats.ms[NVFLEXH_PHASE_SOLVE], stepStats.ms[NVFLEXH_PHASE_PULL], stepStats.bytesUp, stepStats.bytesDown, stepStats.bufferAllocs);
+	if (getPhaseStats() != 0) {
+		stepStats.writeDetailAttribs(gdp);
+		if (sharedStats)groupStats.writeDetailAttribs(gdp, "nvflex_shared");
+	}
+
+	UT_String statsLog;
+	getStatsLogFile(statsLog);
+	if (statsLog.isstring() && !stepStats.appendCsv(statsLog.c_str(), engine.getSimulationTime(), obj->getName(), nactives)) {
+		messageLog(1, "could not write step statistics to %s\n", statsLog.c_str());
+	}
 }
 
 void SIM_NvFlexSolver::initializeSubclass()
@@ -702,6 +850,26 @@ const SIM_DopDescription* SIM_NvFlexSolver::getDescriptionForFucktory() {
 	static PRM_Name collisionDistance_name("collisionDistance", "Collision Distance");
 
 	static PRM_Name shockPropagation_name("shockPropagation", "Shock Propagation");
+
+	static PRM_Name colliderGracePeriod_name("colliderGracePeriod", "Collider Grace Period (steps)");
+	static PRM_Name analyticColliders_name("analyticColliders", "Fit Analytic Colliders");
+	static PRM_Name analyticTolerance_name("analyticTolerance", "Analytic Fit Tolerance");
+	static PRM_Name convexColliders_name("convexColliders", "Convex Colliders");
+	static PRM_Name convexMaxPlanes_name("convexMaxPlanes", "Convex Collider Max Planes");
+	static PRM_Name sdfResolution_name("sdfResolution", "SDF Collider Resolution");
+	static PRM_Name sdfTriangleThreshold_name("sdfTriangleThreshold", "SDF From Meshes Above Triangles");
+	static PRM_Name sdfCacheDir_name("sdfCacheDir", "SDF Bake Cache Directory");
+	static PRM_Name sdfCacheMaxSize_name("sdfCacheMaxSize", "SDF Bake Cache Max Size (MB)");
+
+	static PRM_Name readbackP_name("readbackP", "Read Back P");
+	static PRM_Name readbackV_name("readbackV", "Read Back v");
+	static PRM_Name readbackPhs_name("readbackPhs", "Read Back phs");
+	static PRM_Name readbackIid_name("readbackIid", "Write iid");
+	static PRM_Name readbackRest_name("readbackRest", "Read Back restP");
+
+	static PRM_Name phaseStats_name("phaseStats", "Step Statistics On Geometry");
+	static PRM_Name statsLogFile_name("statsLogFile", "Step Statistics CSV Log");
+	static PRM_Name sharedContainer_name("sharedContainer", "Shared Container For All Objects");
 	
 
 	static PRM_Default radius_default(0.2f);
@@ -726,6 +894,13 @@ const SIM_DopDescription* SIM_NvFlexSolver::getDescriptionForFucktory() {
 	static PRM_Default shapeCollisionMargin_defaults(0.05f);
 	static PRM_Default particleCollisionMargin_defaults(0.0f);
 	static PRM_Default collisionDistance_defaults(0.0275f);
+	static PRM_Default colliderGracePeriod_defaults(10);
+	static PRM_Default analyticTolerance_defaults(0.01f);
+	static PRM_Default convexMaxPlanes_defaults(64);
+	static PRM_Default sdfResolution_defaults(64);
+	static PRM_Default sdfTriangleThreshold_defaults(0);
+	static PRM_Default sdfCacheDir_defaults(0, "$HOUDINI_TEMP_DIR/nvflex_sdf");
+	static PRM_Default sdfCacheMaxSize_defaults(512);
 
 	static PRM_Default zero_defaults(0.0f);
 	static PRM_Default one_defaults(1.0f);
@@ -737,6 +912,11 @@ const SIM_DopDescription* SIM_NvFlexSolver::getDescriptionForFucktory() {
 	static PRM_Range planesCount_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_RESTRICTED, 5);
 
 	static PRM_Range zeroOne_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 1.0f);
+	static PRM_Range colliderGracePeriod_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 100);
+	static PRM_Range convexMaxPlanes_range(PRM_RANGE_RESTRICTED, 26, PRM_RANGE_UI, 256);
+	static PRM_Range sdfResolution_range(PRM_RANGE_RESTRICTED, 8, PRM_RANGE_UI, 256);
+	static PRM_Range sdfTriangleThreshold_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 1000000);
+	static PRM_Range sdfCacheMaxSize_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 8192);
 
 
 	//seps
@@ -779,6 +959,23 @@ const SIM_DopDescription* SIM_NvFlexSolver::getDescriptionForFucktory() {
 		PRM_Template(PRM_FLT, 1, &particleCollisionMargin_name, &particleCollisionMargin_defaults),
 		PRM_Template(PRM_FLT, 1, &collisionDistance_name, &collisionDistance_defaults),
 		PRM_Template(PRM_FLT, 1, &shockPropagation_name, &zero_defaults),
+		PRM_Template(PRM_INT, 1, &colliderGracePeriod_name, &colliderGracePeriod_defaults, 0, &colliderGracePeriod_range),
+		PRM_Template(PRM_TOGGLE, 1, &analyticColliders_name, &zero_defaults),
+		PRM_Template(PRM_FLT, 1, &analyticTolerance_name, &analyticTolerance_defaults, 0, &zeroOne_range),
+		PRM_Template(PRM_TOGGLE, 1, &convexColliders_name, &zero_defaults),
+		PRM_Template(PRM_INT, 1, &convexMaxPlanes_name, &convexMaxPlanes_defaults, 0, &convexMaxPlanes_range),
+		PRM_Template(PRM_INT, 1, &sdfResolution_name, &sdfResolution_defaults, 0, &sdfResolution_range),
+		PRM_Template(PRM_INT, 1, &sdfTriangleThreshold_name, &sdfTriangleThreshold_defaults, 0, &sdfTriangleThreshold_range),
+		PRM_Template(PRM_FILE, 1, &sdfCacheDir_name, &sdfCacheDir_defaults),
+		PRM_Template(PRM_INT, 1, &sdfCacheMaxSize_name, &sdfCacheMaxSize_defaults, 0, &sdfCacheMaxSize_range),
+		PRM_Template(PRM_TOGGLE, 1, &readbackP_name, &one_defaults),
+		PRM_Template(PRM_TOGGLE, 1, &readbackV_name, &one_defaults),
+		PRM_Template(PRM_TOGGLE, 1, &readbackPhs_name, &one_defaults),
+		PRM_Template(PRM_TOGGLE, 1, &readbackIid_name, &one_defaults),
+		PRM_Template(PRM_TOGGLE, 1, &readbackRest_name, &zero_defaults),
+		PRM_Template(PRM_TOGGLE, 1, &phaseStats_name, &zero_defaults),
+		PRM_Template(PRM_FILE, 1, &statsLogFile_name, 0),
+		PRM_Template(PRM_TOGGLE, 1, &sharedContainer_name, &zero_defaults),
 		PRM_Template()
 	};
 
@@ -6,6 +6,13 @@
 #include <NvFlex.h>
 #include <NvFlexExt.h>
 
+#include <vector>
+#include "NvFlexHStepStats.h"
+#include "NvFlexHContext.h"
+
+class SIM_NvFlexData;
+class NvFlexHContainer;
+
 class SIM_NvFlexSolver:public SIM_Solver,public SIM_OptionsUser
 {
 public:
@@ -49,6 +56,27 @@ public:
 
 	GETSET_DATA_FUNCS_V3("wind", Wind);
 
+	GETSET_DATA_FUNCS_I("colliderGracePeriod", ColliderGracePeriod);
+	GETSET_DATA_FUNCS_I("analyticColliders", AnalyticColliders);
+	GETSET_DATA_FUNCS_F("analyticTolerance", AnalyticTolerance);
+	GETSET_DATA_FUNCS_I("convexColliders", ConvexColliders);
+	GETSET_DATA_FUNCS_I("convexMaxPlanes", ConvexMaxPlanes);
+	GETSET_DATA_FUNCS_I("sdfResolution", SdfResolution);
+	GETSET_DATA_FUNCS_I("sdfTriangleThreshold", SdfTriangleThreshold);
+	GETSET_DATA_FUNCS_S("sdfCacheDir", SdfCacheDir);
+	GETSET_DATA_FUNCS_I("sdfCacheMaxSize", SdfCacheMaxSize);
+
+	GETSET_DATA_FUNCS_I("readbackP", ReadbackP);
+	GETSET_DATA_FUNCS_I("readbackV", ReadbackV);
+	GETSET_DATA_FUNCS_I("readbackPhs", ReadbackPhs);
+	GETSET_DATA_FUNCS_I("readbackIid", ReadbackIid);
+	GETSET_DATA_FUNCS_I("readbackRest", ReadbackRest);
+
+	GETSET_DATA_FUNCS_I("phaseStats", PhaseStats);
+	GETSET_DATA_FUNCS_S("statsLogFile", StatsLogFile);
+
+	GETSET_DATA_FUNCS_I("sharedContainer", SharedContainer);
+
 protected:
 	explicit SIM_NvFlexSolver(const SIM_DataFactory*fack);
 	virtual ~SIM_NvFlexSolver();
@@ -60,6 +88,29 @@ protected:
 
 	NvFlexParams nvparams;
 
+	//one object being stepped, with what the step found out about its geometry
+	struct NvFlexHSolveTarget {
+		SIM_Object *obj;
+		SIM_NvFlexData *nvdata;
+		NvFlexHStepStats stats; //ingest and writeback of this object only
+		bool hasGeometry, hasSprings, hasRigids;
+		short triNormalType;
+		bool springParamsOnly, strengthChanged, restLengthChanged;
+		NvFlexHSolveTarget(SIM_Object *o, SIM_NvFlexData *d) :obj(o), nvdata(d), hasGeometry(false), hasSprings(false), hasRigids(false), triNormalType(0), springParamsOnly(false), strengthChanged(false), restLengthChanged(false) {}
+	};
+
+	//puts every target into its own range of one container, making a new one if the layout changed. false if it couldn't
+	bool packSharedContainer(std::vector<NvFlexHSolveTarget> &targets);
+	//grows ranges of growable targets whose geometry doesn't fit anymore, before anything of this step is written to the container
+	void growContainer(std::vector<NvFlexHSolveTarget> &targets, NvFlexHContainer *consolv);
+	//one flex step for targets all living in the same container
+	void solveGroup(SIM_Engine &engine, std::vector<NvFlexHSolveTarget> &targets, const SIM_Time &timestep);
+	//false if the object can't be simulated this step
+	bool ingestParticles(NvFlexHSolveTarget &target, NvFlexHContainer *consolv, int &dirtyChannels);
+	void updateConstraints(std::vector<NvFlexHSolveTarget> &targets, NvFlexHContainer *consolv);
+	void updateCollisions(const std::vector<NvFlexHSolveTarget> &targets, NvFlexHContainer *consolv);
+	void writebackObject(SIM_Engine &engine, NvFlexHSolveTarget &target, NvFlexHContainer *consolv, int readbackChannels, bool readbackIid, const NvFlexHStepStats &groupStats, bool sharedStats);
+
 
 private:
 	static const SIM_DopDescription* getDescriptionForFucktory();
@@ -67,11 +118,3 @@ private:
 	DECLARE_STANDARD_GETCASTTOTYPE();
 	DECLARE_DATAFACTORY(SIM_NvFlexSolver, SIM_Solver, "solver for nvflex sim", getDescriptionForFucktory());
 };
-
-class NvFlexHContextAutoGetter {
-public:
-	explicit NvFlexHContextAutoGetter(NvFlexLibrary*lib):_lib(lib) { NvFlexAcquireContext(lib); }
-	~NvFlexHContextAutoGetter() { NvFlexRestoreContext(_lib); }
-private:
-	NvFlexLibrary* _lib;
-};
\ No newline at end of file
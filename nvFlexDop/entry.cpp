@@ -2,9 +2,11 @@
 
 #include "SIM_NvFlexData.h"
 #include "SIM_NvFlexSolver.h"
+#include "NvFlexHContainerPool.h"
 #include <NvFlexDevice.h>
 #include <stdlib.h>
 #include <climits>
+#include <algorithm>
 #include "utils.h"
 
 
@@ -20,6 +22,11 @@ void initializeSIM(void*) {
 		else errlvl = (short)lerrlvl;
 		setMessageLogLevel(errlvl);
 	}
+	//idle containers kept for sim resets, each holds gpu memory for its maxpts
+	const char* poolvar = std::getenv("NVFLEX_CONTAINER_POOL_SIZE");
+	if (poolvar != NULL) {
+		NvFlexHContainerPool::instance().setCapacity((int)std::max(0L, std::min(strtol(poolvar, NULL, 10), 64L)));
+	}
 	try { //some useless error handling
 		{
 			NvFlexHLibraryHolder tester; // check if shit can initialize and deinitialize properly
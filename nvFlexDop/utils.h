@@ -1,6 +1,22 @@
 #pragma once
+#include <SYS/SYS_Types.h>
+#include <string.h>
 
 void messageLog(unsigned short level, const char* fmt, ...);
 
 void setMessageLogLevel(unsigned short level);
-short getMessageLogLevel();
\ No newline at end of file
+short getMessageLogLevel();
+//word at a time FNV-like mix, good enough to tell colliders apart and fast on big buffers
+inline uint64 hashBytes(uint64 h, const void* data, size_t size) {
+	const uint64 prime = 0x100000001b3ULL;
+	const unsigned char* bytes = (const unsigned char*)data;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64 w;
+		memcpy(&w, bytes + i, 8);
+		h = (h ^ w) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; ++i)h = (h ^ bytes[i]) * prime;
+	return h;
+}